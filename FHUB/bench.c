@@ -0,0 +1,339 @@
+/**
+ * bench.c - microbenchmarks for the server's hot paths. the server is
+ * included whole so every routine is timed exactly as it is built, and
+ * malloc is wrapped at link time so allocations can be counted too
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+// defines
+#define FHUB_BENCH
+#define DEFAULT_ITERATIONS    1000000
+#define BENCH_CHAT            "ANONYMOUS>the quick brown fox jumps over the lazy dog"
+#define BENCH_COMMAND         "copy \"holiday photos/day one.png\" backups/2026/october"
+#define BENCH_MESSAGES        2000000
+#define BENCH_WORDS           20000
+#define BENCH_USERS           50
+#define BENCH_CLIENTS         8
+#define BENCH_BURST           64
+#define BENCH_BURSTS          200
+#define BENCH_GAP             20
+
+// the whole server, minus its main
+#include "server.c"
+
+// a single benchmark. run does the work of the given number of operations
+typedef struct {
+    char*      name;
+    char*      measures;
+    void       (*run)(long long iterations);
+} Benchmark;
+
+// global variables
+long long g_allocations                =   0  ;
+char g_benchDir[]                      = "/tmp/fhub_benchXXXXXX";
+char g_frame[HEADER_SIZE + PACKET_SIZE] = { 0 };
+int  g_frameLength                     =   0  ;
+volatile long long g_sink              =   0  ;
+SearchIndex g_benchIndex;
+int  g_benchPeers[BENCH_CLIENTS];
+int  g_benchPeerCount                  =   0  ;
+
+// function declarations
+void*  __real_malloc(size_t size);
+void*  __real_calloc(size_t count, size_t size);
+void*  __real_realloc(void* pointer, size_t size);
+void*  __wrap_malloc(size_t size);
+void*  __wrap_calloc(size_t count, size_t size);
+void*  __wrap_realloc(void* pointer, size_t size);
+void   makeBenchRoot(void);
+void   removeBenchRoot(void);
+void   benchTokenize(long long iterations);
+void   benchParseFrame(long long iterations);
+void   benchFormatFrame(long long iterations);
+void   benchResolvePath(long long iterations);
+void   benchChangeDirectory(long long iterations);
+void   benchAddChat(long long iterations);
+void   benchSearch(long long iterations);
+void   benchCoalescing(void);
+void   waitFlushed(void);
+void*  drainPeers(void* arg);
+
+// every benchmark, in the order they run
+Benchmark g_benchmarks[] = {
+    { "tokenize",  "splitting an admin command into arguments, as handleInput does", benchTokenize },
+    { "parse",     "pulling a received chat frame out of a client's reader",        benchParseFrame },
+    { "format",    "framing a payload into a pooled packet for the output queues",  benchFormatFrame },
+    { "resolve",   "resolving a path with . and .. steps against a working dir",    benchResolvePath },
+    { "changedir", "changing the admin's working directory and back to root",       benchChangeDirectory },
+    { "addchat",   "decoding a chat into a packet, logging and indexing it",         benchAddChat },
+    { "search",    "a two word query for one user over 2M indexed messages",     benchSearch }
+};
+
+/**
+ * Main function. Usage is bench [iterations] [benchmark]. Every
+ * benchmark is run unless one is named, coalesce included
+*/
+int main(int argc, char *argv[]) {
+    long long iterations = argc > 1 ? atoll(argv[1]) : DEFAULT_ITERATIONS;
+    char* only = argc > 2 ? argv[2] : NULL;
+    if (iterations < 1) iterations = DEFAULT_ITERATIONS;
+
+    initPacketPool(&g_packetPool);
+    initSearchIndex(&g_searchIndex, MAX_LOGS);
+    makeBenchRoot();
+    writeHeader(g_frame, CHAT, strlen(BENCH_CHAT));
+    memcpy(g_frame + HEADER_SIZE, BENCH_CHAT, strlen(BENCH_CHAT));
+    g_frameLength = HEADER_SIZE + strlen(BENCH_CHAT);
+
+    printf("%-10s %14s %12s   %s\n", "BENCHMARK", "NS/OP", "ALLOCS/OP", "MEASURES");
+    for (int i = 0; i < sizeof(g_benchmarks) / sizeof(Benchmark); i++) {
+        Benchmark* benchmark = &g_benchmarks[i];
+        if (only != NULL && strcmp(only, benchmark->name) != 0) continue;
+
+        // warm up caches and pools first so only the steady state is measured
+        benchmark->run(iterations / 10 + 1);
+        long long allocations = __atomic_load_n(&g_allocations, __ATOMIC_RELAXED);
+        long long start = getTimeMicros();
+        benchmark->run(iterations);
+        long long elapsed = getTimeMicros() - start;
+        allocations = __atomic_load_n(&g_allocations, __ATOMIC_RELAXED) - allocations;
+
+        printf("%-10s %14.1f %12.3f   %s\n", benchmark->name, elapsed * 1000.0 / iterations,
+            (double)allocations / iterations, benchmark->measures);
+    }
+
+    // leaves the output thread and fake clients running, so it goes last
+    if (only == NULL || strcmp(only, "coalesce") == 0) benchCoalescing();
+    removeBenchRoot();
+    return 0;
+}
+
+/**
+ * Counts an allocation and hands it on to the real malloc
+*/
+void* __wrap_malloc(size_t size) {
+    __atomic_add_fetch(&g_allocations, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+/**
+ * Counts an allocation and hands it on to the real calloc
+*/
+void* __wrap_calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&g_allocations, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+/**
+ * Counts an allocation and hands it on to the real realloc
+*/
+void* __wrap_realloc(void* pointer, size_t size) {
+    __atomic_add_fetch(&g_allocations, 1, __ATOMIC_RELAXED);
+    return __real_realloc(pointer, size);
+}
+
+/**
+ * Moves into a fresh temporary directory holding a small
+ * root for the path benchmarks to walk around in
+*/
+void makeBenchRoot() {
+    if (mkdtemp(g_benchDir) == NULL || chdir(g_benchDir) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> could not make a directory to benchmark in\n");
+        resetText();
+        exit(1);
+    }
+    makeDirectory(ROOT_DIR);
+    makeDirectory(ROOT_DIR "/photos");
+    makeDirectory(ROOT_DIR "/photos/2026");
+    makeDirectory(ROOT_DIR "/photos/2026/october");
+}
+
+/**
+ * Cleans up the directory made by makeBenchRoot
+*/
+void removeBenchRoot() {
+    if (chdir("/") == 0) removeTree(AT_FDCWD, g_benchDir);
+}
+
+/**
+ * Splits an admin command into its arguments
+*/
+void benchTokenize(long long iterations) {
+    char command[BUFFER_SIZE];
+    char* args[MAX_ARGS];
+    for (long long i = 0; i < iterations; i++) {
+        strcpy(command, BENCH_COMMAND);
+        g_sink += tokenize(command, args, MAX_ARGS);
+    }
+}
+
+/**
+ * Receives a chat frame into a reader and pulls it back out,
+ * the way handleClient does after every recv
+*/
+void benchParseFrame(long long iterations) {
+    static FrameReader reader;
+    char type;
+    char* payload;
+    unsigned int length;
+    for (long long i = 0; i < iterations; i++) {
+        int available;
+        char* space = readerSpace(&reader, &available);
+        memcpy(space, g_frame, g_frameLength);
+        readerCommit(&reader, g_frameLength);
+        while (nextFrame(&reader, &type, &payload, &length) == TRUE) g_sink += length;
+    }
+}
+
+/**
+ * Frames a chat into a pooled packet, the form it takes on the way
+ * out to every client, then hands it back to the pool
+*/
+void benchFormatFrame(long long iterations) {
+    for (long long i = 0; i < iterations; i++) {
+        Packet* packet = makePacket(&g_packetPool, CHAT, BENCH_CHAT, strlen(BENCH_CHAT));
+        g_sink += packet->length;
+        releasePacket(packet);
+    }
+}
+
+/**
+ * Resolves a path that steps out of and back into the working directory
+*/
+void benchResolvePath(long long iterations) {
+    char path[MAX_PATH_SIZE];
+    for (long long i = 0; i < iterations; i++)
+        g_sink += resolvePath("photos/2026", "../2026/./october/../october", path);
+}
+
+/**
+ * Changes the admin's working directory down into the tree and back up to
+ * the root. Each operation is one change, so both directions are averaged
+*/
+void benchChangeDirectory(long long iterations) {
+    for (long long i = 0; i < iterations; i++)
+        g_sink += changeDirectory(NULL, g_adminDir.relative[0] == '\0' ? "photos/2026/october" : "/");
+}
+
+/**
+ * Decodes a chat into a packet and logs it, the way handleFrames does
+ * for every chat that comes in. The log holds on to the packet
+*/
+void benchAddChat(long long iterations) {
+    for (long long i = 0; i < iterations; i++) {
+        Packet* packet = makePacket(&g_packetPool, CHAT, BENCH_CHAT, strlen(BENCH_CHAT));
+        addChat(packet);
+        releasePacket(packet);
+    }
+}
+
+/**
+ * Searches an index far bigger than the chat log keeps, filled the first
+ * time through with chats from a few users picking words at random
+*/
+void benchSearch(long long iterations) {
+    if (g_benchIndex.slots == 0) {
+        initSearchIndex(&g_benchIndex, BENCH_MESSAGES);
+        unsigned int seed = 1;
+        char chat[256];
+        for (long long id = 0; id < BENCH_MESSAGES; id++) {
+            int length = sprintf(chat, "user%d>", (seed = seed * 1103515245 + 12345) % BENCH_USERS);
+            for (int word = 0; word < 8; word++)
+                length += sprintf(chat + length, "word%d ", (seed = seed * 1103515245 + 12345) % BENCH_WORDS);
+            indexMessage(&g_benchIndex, id, chat, length, id / 100);
+        }
+        printf("%-10s %lld messages indexed in %.1f MB\n", "search", g_benchIndex.messages,
+            searchMemory(&g_benchIndex) / 1000000.0);
+    }
+    char* args[] = { "word17", "word42", "user:user7" };
+    SearchQuery query;
+    SearchResult results[MAX_SEARCH_RESULTS];
+    parseQuery(&query, args, 3, 0);
+    for (long long i = 0; i < iterations; i++)
+        g_sink += searchIndex(&g_benchIndex, &query, 0, results, MAX_SEARCH_RESULTS);
+}
+
+/**
+ * Sends bursts of chats to a handful of clients through the real output
+ * thread, first with the coalescing window closed and then at its default,
+ * and reports how many send calls each delivered frame took. chats in a
+ * burst are spaced out a little, the way they come in off the network
+*/
+void benchCoalescing() {
+    for (; g_benchPeerCount < BENCH_CLIENTS; g_benchPeerCount++) {
+        int ends[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, ends) != 0) break;
+        if (addUser(ends[0]) == NULL) {
+            close(ends[0]);
+            close(ends[1]);
+            break;
+        }
+        g_benchPeers[g_benchPeerCount] = ends[1];
+    }
+    pthread_t drainer, flusher;
+    pthread_create(&drainer, NULL, drainPeers, NULL);
+    pthread_create(&flusher, NULL, flushOutput, NULL);
+
+    printf("\n%d bursts of %d chats, %d us apart, to %d clients through the output thread\n",
+        BENCH_BURSTS, BENCH_BURST, BENCH_GAP, g_benchPeerCount);
+    printf("%10s %14s %12s   %s\n", "WINDOW US", "FRAMES", "SEND CALLS", "CALLS/FRAME");
+    long long windows[] = { 0, COALESCE_WINDOW };
+    for (int i = 0; i < sizeof(windows) / sizeof(long long); i++) {
+        pthread_mutex_lock(&g_outputLock);
+        g_coalesceWindow = windows[i];
+        long long frames = g_framesSent;
+        long long calls = g_sendCalls;
+        pthread_mutex_unlock(&g_outputLock);
+
+        for (int burst = 0; burst < BENCH_BURSTS; burst++) {
+            for (int message = 0; message < BENCH_BURST; message++) {
+                Packet* packet = makePacket(&g_packetPool, CHAT, BENCH_CHAT, strlen(BENCH_CHAT));
+                if (packet == NULL) continue;
+                broadcastPacket(packet);
+                releasePacket(packet);
+                sleepMicros(BENCH_GAP);
+            }
+            waitFlushed();
+        }
+
+        pthread_mutex_lock(&g_outputLock);
+        frames = g_framesSent - frames;
+        calls = g_sendCalls - calls;
+        pthread_mutex_unlock(&g_outputLock);
+        printf("%10lld %14lld %12lld   %.3f\n", windows[i], frames, calls, frames > 0 ? (double)calls / frames : 0.0);
+    }
+}
+
+/**
+ * Waits until the output thread has written out everything queued
+*/
+void waitFlushed() {
+    while (TRUE) {
+        pthread_mutex_lock(&g_outputLock);
+        int done = g_pendingFrames == 0;
+        for (int i = 0; i < MAX_USERS && done; i++)
+            if (g_sessions[i].active && (g_sessions[i].output.count > 0 || g_sessions[i].flushing)) done = FALSE;
+        pthread_mutex_unlock(&g_outputLock);
+        if (done) return;
+        sleepMicros(100);
+    }
+}
+
+/**
+ * Reads and throws away everything sent to the fake clients
+*/
+void* drainPeers(void* arg) {
+    struct pollfd fds[BENCH_CLIENTS];
+    char buffer[65536];
+    for (int i = 0; i < g_benchPeerCount; i++) {
+        fds[i].fd = g_benchPeers[i];
+        fds[i].events = POLLIN;
+    }
+    while (poll(fds, g_benchPeerCount, -1) > 0) {
+        for (int i = 0; i < g_benchPeerCount; i++)
+            if (fds[i].revents & POLLIN) g_sink += read(fds[i].fd, buffer, sizeof(buffer));
+    }
+    return NULL;
+}
@@ -0,0 +1,100 @@
+/**
+ * bus.h - messages between the processes of a server running several
+ * workers. each worker has a unix socket to the first process, which
+ * passes messages on between them, and sockets themselves can be sent
+ * along with a message so a client can move from one process to another
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef BUS_H
+#define BUS_H
+
+#ifdef __linux__
+
+// defines
+#define BUS_MESSAGE_SIZE      (96 * 1024)
+
+// includes
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// what a message on the bus is for
+enum BUS_TYPE {
+    BUS_CHAT  = 'c',
+    BUS_DRAIN = 'd',
+    BUS_ADOPT = 'a',
+    BUS_DONE  = 'x'
+};
+
+// function declarations
+int    openBus(int* ends);
+int    sendBus(int bus, char type, const char* data, int length, int passed);
+int    receiveBus(int bus, char* type, char* data, int size, int* passed);
+
+/**
+ * Makes a connected pair of bus sockets. Messages on them keep their
+ * boundaries, so each send is received whole. Returns 0 on success
+*/
+int openBus(int* ends) {
+    return socketpair(AF_UNIX, SOCK_SEQPACKET, 0, ends);
+}
+
+/**
+ * Sends a message as a type byte followed by the data. If passed isn't
+ * -1 that socket goes along with it, and the receiver gets its own copy
+ * of it. Returns 0 on success
+*/
+int sendBus(int bus, char type, const char* data, int length, int passed) {
+    struct iovec vectors[2] = { { &type, 1 }, { (void*)data, length } };
+    struct msghdr message = { 0 };
+    char control[CMSG_SPACE(sizeof(int))];
+    message.msg_iov = vectors;
+    message.msg_iovlen = length > 0 ? 2 : 1;
+    if (passed >= 0) {
+        memset(control, 0, sizeof(control));
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(header), &passed, sizeof(int));
+    }
+    ssize_t sent;
+    do sent = sendmsg(bus, &message, MSG_NOSIGNAL);
+    while (sent < 0 && errno == EINTR);
+    return sent == length + 1 ? 0 : -1;
+}
+
+/**
+ * Receives a message into data, putting its type into type and any socket
+ * sent along with it into passed, which is -1 otherwise. Returns the
+ * length of the data, or -1 once the other end has gone away
+*/
+int receiveBus(int bus, char* type, char* data, int size, int* passed) {
+    struct iovec vectors[2] = { { type, 1 }, { data, size } };
+    struct msghdr message = { 0 };
+    char control[CMSG_SPACE(sizeof(int))];
+    message.msg_iov = vectors;
+    message.msg_iovlen = 2;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    *passed = -1;
+    ssize_t received;
+    do received = recvmsg(bus, &message, MSG_CMSG_CLOEXEC);
+    while (received < 0 && errno == EINTR);
+    if (received <= 0) return -1;
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (header != NULL && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+        memcpy(passed, CMSG_DATA(header), sizeof(int));
+    if (message.msg_flags & MSG_TRUNC) return 0;
+    return (int)received - 1;
+}
+
+#endif
+
+#endif
@@ -1,7 +1,7 @@
 /**
  * chat.c - a program to connect with a server application
  * author: Jason Heflinger
- * last modified: 6-7-2023
+ * last modified: 10-18-2026
 */
 
 // defines
@@ -12,15 +12,27 @@
 #define PACKET_SIZE           4096
 #define BUFFER_SIZE           2048
 #define MAX_LOGS              100000
+#define SYNC_STATE_FILE       ".fhub_sync"
+#define CACHE_FRESHNESS       5
+#define MAX_SHOWN             16384
+#define WORKING_DIR_PREFIX    "SERVER  >> working directory is now R:"
 #define TRUE                  1
 #define FALSE                 0
 
 // standard library includes
-#include <ws2tcpip.h>
 #include <pthread.h>
 
 // custom includes
+#include "platform.h"
 #include "utils.h"
+#include "protocol.h"
+#include "tarstream.h"
+#include "manifest.h"
+#include "locallink.h"
+#include "clientcache.h"
+#ifdef FHUB_ZLIB
+#include <zlib.h>
+#endif
 
 // global variables
 char g_chatLog[MAX_LOGS][PACKET_SIZE]  = { 0 };
@@ -31,11 +43,56 @@ int  g_logIndex                        =   0  ;
 int  g_port                            =   0  ;
 int  g_socket                          =   0  ;
 int  g_initialized                     =   0  ;
+int  g_unpacking                       =   0  ;
+int  g_compressed                      =   0  ;
+long long g_archiveStart               =   0  ;
+int  g_syncState                       =   0  ;
+int* g_syncWanted                      = NULL ;
+int  g_syncWantedCount                 =   0  ;
+int  g_syncNext                        =   0  ;
+int  g_syncBatch                       =   0  ;
+long long g_syncFetched                =   0  ;
+long long g_syncFailed                 =   0  ;
+long long g_syncRemoved                =   0  ;
+long long g_syncBytes                  =   0  ;
+char g_syncLocal[MANIFEST_PATH_SIZE]   = { 0 };
+int  g_local                           =   0  ;
+char g_remoteDir[MANIFEST_PATH_SIZE]   = "/"  ;
+#ifdef __linux__
+pthread_mutex_t g_sendLock             = PTHREAD_MUTEX_INITIALIZER;
+LocalLink g_link;
+#endif
+RemoteCache g_cache;
+Manifest g_synced;
+Manifest g_manifest;
+TarReader g_archive;
+#ifdef FHUB_ZLIB
+z_stream g_inflater;
+#endif
 
 // helper enum to describe packets
 enum PACKET_TYPE {
     CHAT = 'c',
-    SHUTDOWN = 's'
+    SHUTDOWN = 's',
+    COMMAND = 'm',
+    RESPONSE = 'r',
+    ARCHIVE_START = 'b',
+    ARCHIVE = 'a',
+    ARCHIVE_END = 'e',
+    MANIFEST = 'f',
+    MANIFEST_END = 'g',
+    NOTIFY = 'n',
+    CACHED_START = 'v',
+    CACHED = 'd',
+    CACHED_END = 'k',
+    UNCHANGED = 'u'
+};
+
+// where a sync is at
+enum SYNC_STATE {
+    SYNC_IDLE     = 0,
+    SYNC_MANIFEST = 1,
+    SYNC_FETCHING = 2
 };
 
 // function declarations
@@ -47,6 +104,27 @@ void*  updateOutput(void* arg);
 void*  updateInput(void* arg);
 int    compareCommand(char* buffer, char* command, char shortcut);
 void   sendPacket(char* buf, char type);
+void   sendCommand(char* name, char* command);
+int    sendToServer(char type, const char* payload, unsigned int length);
+int    receiveFromServer(char* buffer, int size);
+void   handleFrame(char type, char* buffer, unsigned int length);
+void   unpackArchive(char* data, int length);
+void   printChanges(char* text, unsigned int length);
+void   startSync(char* command);
+void   diffManifest(char* summary, int length);
+void   fetchBatch(void);
+void   finishBatch(void);
+void   finishSync(void);
+int    localMatches(ManifestEntry* entry);
+void   requestCached(char* command, char kind);
+int    remotePath(char* name, char* path);
+void   showCached(char* key, char* how, int async);
+void   printCacheStats(char* command);
+
+/**
+ * prints out non blocking using intermediate input buffer
+*/
+#define ASYNC_PRINT(...) do { for (int i = 0; i < strlen(g_buffer); i++) printf("\b \b"); printf(__VA_ARGS__); printf("%s", g_buffer); } while (0)
 
 /**
  * main function. General high level functionality
@@ -116,6 +194,11 @@ void initialize() {
     getInput(g_username, 512);
     if (g_username[0] == '\0')
         memcpy(g_username, DEFAULT_USERNAME, 10);
+
+    // each server gets a cache of its own
+    char server[64];
+    snprintf(server, sizeof(server), "%s_%d", g_ipAddr, g_port);
+    initRemoteCache(&g_cache, server, CACHE_FRESHNESS);
     
     g_initialized = TRUE;
 }
@@ -133,6 +216,17 @@ void createConnection() {
         exit(3);
     }
 
+#ifdef __linux__
+    // a server on this machine is reached through shared memory if it
+    // takes local clients, skipping the network stack entirely
+    if (strncmp(g_ipAddr, "127.", 4) == 0 && connectLocal(g_port, &g_link) == 0) {
+        printf("Connecting to %s on port %d as user %s through shared memory\n", g_ipAddr, g_port, g_username);
+        g_local = TRUE;
+        g_socket = g_link.socket;
+        return;
+    }
+#endif
+
     // create socket
     printf("Connecting to %s on port %d as user %s\n", g_ipAddr, g_port, g_username);
     int status, valread, client_fd;
@@ -143,7 +237,6 @@ void createConnection() {
         resetText();
         exit(1);
     }
-    ioctlsocket(client_fd, FIONBIO, 1);
 
     // process IP and port information
     serv_addr.sin_family = AF_INET;
@@ -207,34 +300,557 @@ void disconnect() {
  * the user's input
 */
 void* updateOutput(void* arg) {
+    static FrameReader reader = { 0 };
     int open = TRUE;
     while(open) {
-        char buffer[PACKET_SIZE] = { 0 };
-        if (recv(g_socket, buffer, PACKET_SIZE, 0) >= 0) {
+        int available;
+        char* space = readerSpace(&reader, &available);
+        int received = receiveFromServer(space, available);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            // the server went away, so there's nothing left to wait on
+            setTextColor(YELLOW);
+            ASYNC_PRINT("SERVER >> connection to the server was lost\n");
+            resetText();
+            close(g_socket);
+            exit(0);
+        }
+        readerCommit(&reader, received);
+
+        // the server may batch several packets into one write, so
+        // handle every complete one that came in
+        char type;
+        char* buffer;
+        unsigned int length;
+        while (nextFrame(&reader, &type, &buffer, &length) == TRUE)
+            handleFrame(type, buffer, length);
+    }
+
+    pthread_exit(NULL);
+}
+
+/**
+ * handles a single packet received from the server
+*/
+void handleFrame(char type, char* buffer, unsigned int length) {
+    switch (type) {
+        case CHAT: {
+            if (length + 4 >= PACKET_SIZE) break;
+
             // grab packet
             char chat[PACKET_SIZE + 20] = { '\0' }; // 20 is added as arbitrary padding
-            int index = 1;
-            for(index = 1; buffer[index] != '>'; index++);
-            mempcpy(chat, buffer + 1, strlen(buffer) - 1);
+            int index = 0;
+            while (index < length && buffer[index] != '>') index++;
+            if (index == length) break;
 
             // proccess packet for output
             char* syntax = " >> ";
-            memcpy(chat + index - 1, syntax, 4);
-            memcpy(chat + index + 3, buffer + index + 1, strlen(buffer) - index - 1);
+            memcpy(chat, buffer, index);
+            memcpy(chat + index, syntax, 4);
+            memcpy(chat + index + 4, buffer + index + 1, length - index - 1);
 
             // add chat to log
             strcpy(g_chatLog[g_logIndex], chat);
             g_logIndex++;
 
             // prints out latest chat from log
-            for(int i = 0; i < strlen(g_buffer); i++) // deletes written text
-                printf("\b \b");
-            printf("%s\n", g_chatLog[g_logIndex - 1]); // prints our chat from our updated log
-            printf("%s", g_buffer); // prints out our interrupted input
+            ASYNC_PRINT("%s\n", g_chatLog[g_logIndex - 1]);
+            break;
+        }
+        case RESPONSE:
+            if (strncmp(buffer, "ERROR", 5) == 0) setTextColor(RED);
+            ASYNC_PRINT("%.*s\n", (int)length, buffer);
+            resetText();
+
+            // cached paths are kept from the root, so follow where the working directory is
+            int prefix = strlen(WORKING_DIR_PREFIX);
+            if (length >= prefix && length - prefix < MANIFEST_PATH_SIZE && strncmp(buffer, WORKING_DIR_PREFIX, prefix) == 0) {
+                memcpy(g_remoteDir, buffer + prefix, length - prefix);
+                g_remoteDir[length - prefix] = '\0';
+            }
+
+            // the server turned down the manifest, so there's nothing to sync
+            if (g_syncState == SYNC_MANIFEST && strncmp(buffer, "ERROR", 5) == 0) {
+                clearManifest(&g_synced);
+                clearManifest(&g_manifest);
+                g_syncState = SYNC_IDLE;
+            }
+            break;
+        case ARCHIVE_START:
+            if (g_syncState == SYNC_FETCHING) startTarIn(&g_archive, g_syncLocal);
+            else startTar(&g_archive);
+            g_compressed = (length == 6 && strncmp(buffer, "tar.gz", 6) == 0);
+#ifdef FHUB_ZLIB
+            memset(&g_inflater, 0, sizeof(z_stream));
+            if (g_compressed) inflateInit2(&g_inflater, 15 + 16);
+#endif
+            g_unpacking = TRUE;
+            break;
+        case ARCHIVE:
+            if (g_unpacking) unpackArchive(buffer, length);
+            break;
+        case ARCHIVE_END: {
+            closeTar(&g_archive);
+#ifdef FHUB_ZLIB
+            if (g_compressed) inflateEnd(&g_inflater);
+#endif
+            if (g_syncState == SYNC_FETCHING) {
+                g_unpacking = FALSE;
+                finishBatch();
+                break;
+            }
+            double seconds = (getTimeMicros() - g_archiveStart) / 1000000.0;
+            setTextColor(GREEN);
+            ASYNC_PRINT("SERVER >> received %lld files and %lld directories (%lld bytes) in %.3fs\n",
+                g_archive.files, g_archive.directories, g_archive.bytes, seconds);
+            resetText();
+            if (g_archive.skipped > 0 || length > 0 || g_archive.state != TAR_DONE) {
+                setTextColor(YELLOW);
+                ASYNC_PRINT("WARNING: %lld entries were skipped%s%.*s\n", g_archive.skipped,
+                    length > 0 ? ", server says " : "", (int)length, buffer);
+                resetText();
+            }
+            g_unpacking = FALSE;
+            break;
+        }
+        case MANIFEST: {
+            if (g_syncState != SYNC_MANIFEST) break;
+            ManifestEntry entry;
+            char path[MANIFEST_PATH_SIZE];
+            int used;
+            while (length > 0 && (used = getManifestEntry(buffer, length, &entry, path)) > 0) {
+                // a name that would land outside the local folder means the manifest can't be trusted
+                if (!isSafeTarPath(entry.path)) {
+                    setTextColor(RED);
+                    ASYNC_PRINT("ERROR   >> the server sent an unsafe path (%s), so the sync was dropped\n", entry.path);
+                    resetText();
+                    clearManifest(&g_synced);
+                    clearManifest(&g_manifest);
+                    g_syncState = SYNC_IDLE;
+                    break;
+                }
+                addManifestEntry(&g_manifest, &entry);
+                buffer += used;
+                length -= used;
+            }
+            break;
+        }
+        case MANIFEST_END:
+            if (g_syncState == SYNC_MANIFEST) diffManifest(buffer, length);
+            break;
+        case NOTIFY:
+            printChanges(buffer, length);
+            break;
+        case UNCHANGED:
+        case CACHED_START: {
+            // both start with the version and then the key
+            char text[CACHE_KEY_SIZE + CACHE_VERSION_SIZE] = { 0 };
+            memcpy(text, buffer, length < sizeof(text) - 1 ? length : sizeof(text) - 1);
+            char* key = strchr(text, ' ');
+            if (key == NULL) break;
+            *key++ = '\0';
+            if (type == CACHED_START) {
+                beginRemote(&g_cache, key, text);
+                break;
+            }
+            touchRemote(&g_cache, key);
+            g_cache.revalidated++;
+            showCached(key, "not modified", TRUE);
+            break;
         }
+        case CACHED:
+            appendRemote(&g_cache, buffer, length);
+            break;
+        case CACHED_END:
+            if (length > 0) {
+                abandonRemote(&g_cache);
+                setTextColor(RED);
+                ASYNC_PRINT("ERROR   >> %.*s\n", (int)length, buffer);
+                resetText();
+            } else if (finishRemote(&g_cache) != 0) {
+                setTextColor(YELLOW);
+                ASYNC_PRINT("WARNING: %s could not be written to, so it won't be cached\n", CACHE_DIR);
+                resetText();
+            } else {
+                showCached(g_cache.incomingKey, "fetched", TRUE);
+            }
+            break;
     }
+}
 
-    pthread_exit(NULL);
+/**
+ * unpacks the next chunk of a directory being streamed in,
+ * inflating it first if it was compressed
+*/
+void unpackArchive(char* data, int length) {
+    if (!g_compressed) {
+        if (feedTar(&g_archive, data, length) != 0) g_unpacking = FALSE;
+        return;
+    }
+#ifdef FHUB_ZLIB
+    static char inflated[MAX_PAYLOAD_SIZE];
+    g_inflater.next_in = (Bytef*)data;
+    g_inflater.avail_in = length;
+    do {
+        g_inflater.next_out = (Bytef*)inflated;
+        g_inflater.avail_out = MAX_PAYLOAD_SIZE;
+        int result = inflate(&g_inflater, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            g_unpacking = FALSE;
+            return;
+        }
+        int produced = MAX_PAYLOAD_SIZE - g_inflater.avail_out;
+        if (feedTar(&g_archive, inflated, produced) != 0) {
+            g_unpacking = FALSE;
+            return;
+        }
+    } while (g_inflater.avail_out == 0);
+#else
+    g_unpacking = FALSE;
+#endif
+}
+
+/**
+ * prints a notification of changes on the server, which has a line for
+ * each path starting with + if it was created, - if it was removed or ~
+ * if it was changed. a lone * means too much changed to list
+*/
+void printChanges(char* text, unsigned int length) {
+    char* end = text + length;
+    while (text < end) {
+        char* line = text;
+        while (text < end && *text != '\n') text++;
+        int size = text - line;
+        text++;
+        if (size == 0) continue;
+        if (line[0] == '*') {
+            setTextColor(YELLOW);
+            ASYNC_PRINT("WATCH  >> too much changed to list, [/list] to see what's there now\n");
+        } else {
+            setTextColor(line[0] == '+' ? GREEN : line[0] == '-' ? RED : YELLOW);
+            char* verb = line[0] == '+' ? "created" : line[0] == '-' ? "removed" : "changed";
+            ASYNC_PRINT("WATCH  >> %s %.*s\n", verb, size - 1, line + 1);
+        }
+        resetText();
+    }
+}
+
+/**
+ * starts syncing a local folder with a directory on the server by asking
+ * for the directory's manifest. if the folder was synced with the same
+ * directory before, the digest of the manifest it got then goes along,
+ * and the server only sends a new one if anything changed
+*/
+void startSync(char* command) {
+    char remote[MANIFEST_PATH_SIZE] = { 0 };
+    char* args = strchr(command, ' ');
+    if (args == NULL || sscanf(args, " %4095s %4095s", remote, g_syncLocal) != 2) {
+        setTextColor(RED);
+        printf("ERROR   >> Usage is [/sync] <dir> <local>\n");
+        resetText();
+        return;
+    }
+    if (makeTarDirectories(g_syncLocal, 1) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> %s could not be created\n", g_syncLocal);
+        resetText();
+        return;
+    }
+
+    char state[MANIFEST_PATH_SIZE * 2];
+    snprintf(state, sizeof(state), "%s/%s", g_syncLocal, SYNC_STATE_FILE);
+    loadManifest(&g_synced, state);
+    initManifest(&g_manifest);
+    strcpy(g_manifest.remote, remote);
+    unsigned long long digest = strcmp(g_synced.remote, remote) == 0 ? g_synced.digest : 0;
+
+    g_syncFetched = 0;
+    g_syncFailed = 0;
+    g_syncRemoved = 0;
+    g_syncBytes = 0;
+    g_archiveStart = getTimeMicros();
+    g_syncState = SYNC_MANIFEST;
+    char text[MANIFEST_PATH_SIZE + 64];
+    snprintf(text, sizeof(text), "manifest %s %016llx", remote, digest);
+    sendToServer(COMMAND, text, strlen(text));
+}
+
+/**
+ * compares the manifest that just came in with the last one synced and
+ * what's on disk. files gone from the server are removed, unless they've
+ * been changed locally since, and anything new, changed on the server or
+ * changed locally is fetched
+*/
+void diffManifest(char* summary, int length) {
+    char text[128] = { 0 };
+    unsigned long long digest;
+    long long count;
+    int unchanged;
+    memcpy(text, summary, length < 127 ? length : 127);
+    if (sscanf(text, "%llx %lld %d", &digest, &count, &unchanged) != 3) unchanged = FALSE;
+    if (unchanged)
+        for (int i = 0; i < g_synced.count; i++) addManifestEntry(&g_manifest, &g_synced.entries[i]);
+    g_manifest.digest = digest;
+
+    char path[MANIFEST_PATH_SIZE * 2];
+    for (int i = 0; i < g_synced.count; i++) {
+        ManifestEntry* old = &g_synced.entries[i];
+        if (findManifestEntry(&g_manifest, old->path) != NULL || !localMatches(old)) continue;
+        snprintf(path, sizeof(path), "%s/%s", g_syncLocal, old->path);
+        if (remove(path) == 0) g_syncRemoved++;
+    }
+
+    g_syncWanted = malloc((g_manifest.count + 1) * sizeof(int));
+    g_syncWantedCount = 0;
+    g_syncNext = 0;
+    for (int i = 0; i < g_manifest.count; i++) {
+        ManifestEntry* entry = &g_manifest.entries[i];
+        if (strcmp(entry->path, SYNC_STATE_FILE) == 0) continue;
+        ManifestEntry* old = findManifestEntry(&g_synced, entry->path);
+        if (old != NULL && old->hash == entry->hash && old->size == entry->size && localMatches(old)) {
+            entry->localSize = old->localSize;
+            entry->localModified = old->localModified;
+            continue;
+        }
+        g_syncWanted[g_syncWantedCount++] = i;
+    }
+
+    g_syncState = SYNC_FETCHING;
+    if (g_syncWantedCount == 0) finishSync();
+    else fetchBatch();
+}
+
+/**
+ * asks for the next batch of wanted files, as many as fit into one
+ * request. they all come back in a single archive
+*/
+void fetchBatch() {
+    char text[PACKET_SIZE];
+    int length = snprintf(text, PACKET_SIZE, "fetch\n%s", g_manifest.remote);
+    g_syncBatch = g_syncNext;
+    while (g_syncNext < g_syncWantedCount) {
+        ManifestEntry* entry = &g_manifest.entries[g_syncWanted[g_syncNext]];
+        int needed = strlen(entry->path) + 1;
+        if (length + needed < PACKET_SIZE && strchr(entry->path, '\n') == NULL) {
+            text[length++] = '\n';
+            memcpy(text + length, entry->path, needed - 1);
+            length += needed - 1;
+        } else if (g_syncNext > g_syncBatch) {
+            break;
+        } else {
+            // a name that can't be asked for is left out, marked as never having arrived
+            entry->localModified = -1;
+            g_syncFailed++;
+        }
+        g_syncNext++;
+    }
+    if (length == (int)strlen("fetch\n") + (int)strlen(g_manifest.remote)) {
+        if (g_syncNext < g_syncWantedCount) fetchBatch();
+        else finishSync();
+        return;
+    }
+    sendToServer(COMMAND, text, length);
+}
+
+/**
+ * records what the files of the batch that just arrived look like on
+ * disk, then asks for the next batch or wraps up the sync
+*/
+void finishBatch() {
+    for (int i = g_syncBatch; i < g_syncNext; i++) {
+        ManifestEntry* entry = &g_manifest.entries[g_syncWanted[i]];
+        if (entry->localModified == -1) continue;
+        char path[MANIFEST_PATH_SIZE * 2];
+        struct stat info;
+        snprintf(path, sizeof(path), "%s/%s", g_syncLocal, entry->path);
+        if (stat(path, &info) == 0 && (unsigned long long)info.st_size == entry->size) {
+            HashKey key;
+            makeHashKey(&key, &info);
+            entry->localSize = key.size;
+            entry->localModified = key.modified;
+            g_syncFetched++;
+            g_syncBytes += entry->size;
+        } else {
+            entry->localModified = -1;
+            g_syncFailed++;
+        }
+    }
+    if (g_syncNext < g_syncWantedCount) fetchBatch();
+    else finishSync();
+}
+
+/**
+ * saves the manifest along with what every file looks like
+ * locally, so the next sync can skip whatever is unchanged
+*/
+void finishSync() {
+    char state[MANIFEST_PATH_SIZE * 2];
+    snprintf(state, sizeof(state), "%s/%s", g_syncLocal, SYNC_STATE_FILE);
+    int saved = saveManifest(&g_manifest, state) == 0;
+    setTextColor(GREEN);
+    ASYNC_PRINT("SERVER >> synced %s into %s: %lld fetched (%lld bytes), %lld removed, %d up to date in %.3fs\n",
+        g_manifest.remote, g_syncLocal, g_syncFetched, g_syncBytes, g_syncRemoved, g_manifest.count - g_syncWantedCount,
+        (getTimeMicros() - g_archiveStart) / 1000000.0);
+    resetText();
+    if (g_syncFailed > 0 || !saved) {
+        setTextColor(YELLOW);
+        if (g_syncFailed > 0) ASYNC_PRINT("WARNING: %lld files could not be fetched and will be tried again next time\n", g_syncFailed);
+        if (!saved) ASYNC_PRINT("WARNING: %s could not be saved, so the next sync starts over\n", state);
+        resetText();
+    }
+    clearManifest(&g_synced);
+    clearManifest(&g_manifest);
+    free(g_syncWanted);
+    g_syncWanted = NULL;
+    g_syncState = SYNC_IDLE;
+}
+
+/**
+ * checks whether a synced file is still on disk just as it was left
+*/
+int localMatches(ManifestEntry* entry) {
+    char path[MANIFEST_PATH_SIZE * 2];
+    struct stat info;
+    snprintf(path, sizeof(path), "%s/%s", g_syncLocal, entry->path);
+    if (stat(path, &info) != 0) return FALSE;
+    HashKey key;
+    makeHashKey(&key, &info);
+    return key.size == entry->localSize && key.modified == entry->localModified;
+}
+
+/**
+ * shows a directory listing or file from the cache, as long as it was
+ * checked recently enough. otherwise the server is asked whether the
+ * cached version is still current, and either says so or sends a new one
+*/
+void requestCached(char* command, char kind) {
+    char* name = strchr(command, ' ');
+    while (name != NULL && *name == ' ') name++;
+    if ((name == NULL || *name == '\0') && kind == 'f') {
+        setTextColor(RED);
+        printf("ERROR   >> Usage is [/read] <file>\n");
+        resetText();
+        return;
+    }
+    char key[CACHE_KEY_SIZE];
+    key[0] = kind;
+    if (!remotePath(name == NULL ? "" : name, key + 1)) {
+        setTextColor(RED);
+        printf("ERROR   >> paths must stay inside of the root directory\n");
+        resetText();
+        return;
+    }
+
+    char version[CACHE_VERSION_SIZE];
+    long long validated;
+    if (lookupRemote(&g_cache, key, version, &validated) && time(NULL) - validated < g_cache.fresh) {
+        g_cache.hits++;
+        showCached(key, "cached", FALSE);
+        return;
+    }
+    if (strchr(key, '"') != NULL) {
+        setTextColor(RED);
+        printf("ERROR   >> names with quotes in them can't be cached\n");
+        resetText();
+        return;
+    }
+    char text[CACHE_KEY_SIZE + CACHE_VERSION_SIZE + 16];
+    int length = snprintf(text, sizeof(text), "%s \"%s\" %s", kind == 'l' ? "browse" : "read", key + 1,
+        lookupRemote(&g_cache, key, version, &validated) ? version : "-");
+    if (length < PACKET_SIZE) sendToServer(COMMAND, text, length);
+}
+
+/**
+ * works out the path from the root that a name typed in refers to, the
+ * same way the server would. Returns FALSE if it leaves the root
+*/
+int remotePath(char* name, char* path) {
+    int length = 0;
+    path[0] = '\0';
+    for (int pass = (name[0] == '/' || name[0] == '\\') ? 1 : 0; pass < 2; pass++) {
+        char* steps = pass == 0 ? g_remoteDir : name;
+        int start = 0;
+        for (int i = 0; ; i++) {
+            if (steps[i] != '/' && steps[i] != '\\' && steps[i] != '\0') continue;
+            int stepLength = i - start;
+            if (stepLength == 2 && steps[start] == '.' && steps[start + 1] == '.') {
+                if (length == 0) return FALSE;
+                while (path[length - 1] != '/') length--;
+                path[--length] = '\0';
+            } else if (stepLength > 0 && !(stepLength == 1 && steps[start] == '.')) {
+                if (length + stepLength + 2 >= CACHE_KEY_SIZE - 1) return FALSE;
+                path[length++] = '/';
+                memcpy(path + length, steps + start, stepLength);
+                length += stepLength;
+                path[length] = '\0';
+            }
+            if (steps[i] == '\0') break;
+            start = i + 1;
+        }
+    }
+    if (length == 0) strcpy(path, "/");
+    return TRUE;
+}
+
+/**
+ * prints a cached listing or file, saying how it was gotten. only the
+ * start of a big file is shown
+*/
+void showCached(char* key, char* how, int async) {
+    long long length = copyRemote(&g_cache, key, NULL, 0);
+    long long shown = length < MAX_SHOWN || key[0] == 'l' ? length : MAX_SHOWN;
+    char* body = length < 0 ? NULL : malloc(shown + 1);
+    if (body == NULL || copyRemote(&g_cache, key, body, shown) < 0) {
+        setTextColor(RED);
+        if (async) ASYNC_PRINT("ERROR   >> R:%s was lost from the cache, try again\n", key + 1);
+        else printf("ERROR   >> R:%s was lost from the cache, try again\n", key + 1);
+        resetText();
+        free(body);
+        return;
+    }
+    body[shown] = '\0';
+
+    // a listing is indented a name per line, a file is printed as it is
+    int lines = 0;
+    for (long long i = 0; key[0] == 'l' && i < shown; i++) lines += body[i] == '\n';
+    long long size = key[0] == 'l' ? shown + lines : shown;
+    char* text = malloc(size + 256 + strlen(key));
+    if (text == NULL) {
+        free(body);
+        return;
+    }
+    int used = key[0] == 'l' ? sprintf(text, "CACHE  >> R:%s (%d entries, %s)\n", key + 1, lines, how)
+                             : sprintf(text, "CACHE  >> R:%s (%lld bytes, %s)\n", key + 1, length, how);
+    for (long long i = 0; i < shown; i++) {
+        if (key[0] == 'l' && (i == 0 || body[i - 1] == '\n')) text[used++] = '\t';
+        text[used++] = body[i];
+    }
+    text[used] = '\0';
+    if (key[0] == 'f' && shown < length) sprintf(text + used, "\n... %lld more bytes not shown\n", length - shown);
+    else if (used > 0 && text[used - 1] != '\n') strcpy(text + used, "\n");
+    if (async) ASYNC_PRINT("%s", text);
+    else printf("%s", text);
+    free(text);
+    free(body);
+}
+
+/**
+ * shows how much the cache has saved, or sets how many seconds an entry
+ * can go without being checked with the server
+*/
+void printCacheStats(char* command) {
+    char* seconds = strchr(command, ' ');
+    if (seconds != NULL) {
+        g_cache.fresh = atoll(seconds);
+        printf("CACHE  >> entries are now trusted for %lld seconds before being checked\n", g_cache.fresh);
+        return;
+    }
+    pthread_mutex_lock(&g_cache.lock);
+    printf("CACHE  >> %lld served locally, %lld checked and still current, %lld fetched (%lld bytes)\n",
+        g_cache.hits, g_cache.revalidated, g_cache.fetched, g_cache.bytesFetched);
+    printf("CACHE  >> %d entries in memory (%lld bytes), %lld bytes not sent again, trusted for %lld seconds\n",
+        g_cache.count, g_cache.memory, g_cache.bytesSaved, g_cache.fresh);
+    pthread_mutex_unlock(&g_cache.lock);
 }
 
 /**
@@ -255,26 +871,29 @@ void* updateInput(void* arg) {
         char curr = 0;
         int reset = FALSE;
 
-        // gather user input
+        // gather user input, sleeping in getch until each key comes in
         do {
-            if (kbhit()) { // if input is detected
-                // get the next character
-                curr = getch();
-
-                // reset the buffer if this is a new chat
-                if (!reset) {
-                    reset = TRUE;
-                    memset(g_buffer, '\0', BUFFER_SIZE);
-                    memset(packet, '\0', 4096);
-                }
+            curr = getch();
 
-                // update the input buffer and print out the typed input
-                g_buffer[index++] = curr;
-                printf("%c", curr);
-                if (curr == '\b') printf(" \b"); // compensate for backspaces
+            // reset the buffer if this is a new chat
+            if (!reset) {
+                reset = TRUE;
+                memset(g_buffer, '\0', BUFFER_SIZE);
+                memset(packet, '\0', 4096);
             }
+
+            // update the input buffer and print out the typed input
+            g_buffer[index++] = curr;
+            printf("%c", curr);
+            if (curr == '\b') printf(" \b"); // compensate for backspaces
         } while (curr != '\r' && curr != '\n'); //loop until carriage return or newline
 
+        // closing the input is the same as leaving
+        if (g_inputClosed && index == 1) {
+            disconnect();
+            break;
+        }
+
         // replace newline with string end
         for(int i = 0; i < BUFFER_SIZE; i++) {
             if (g_buffer[i] == '\n' || g_buffer[i] == '\r') {
@@ -288,7 +907,7 @@ void* updateInput(void* arg) {
             for (int i = 0; i < strlen(g_buffer); i++) printf(" ");
             printf("\r");
 
-            char command[strlen(g_buffer) - 1];
+            char command[BUFFER_SIZE];
             strcpy(command, g_buffer + 1);
             if (compareCommand(command, "exit", 'e')) { // TODO: add confirmation check
                 disconnect();
@@ -298,8 +917,55 @@ void* updateInput(void* arg) {
                 "COMMANDS: "
                 "\n\t- [/help]    [/h]    prompts help output"
                 "\n\t- [/exit]    [/e]    shuts down the application and disconnects the client"
+                "\n"
+                "\n\t- [/changedir] [/c] <dir>       changes your working directory on the server"
+                "\n\t- [/list]    [/l]                lists your working directory on the server"
+                "\n\t- [/watch]   [/w] [dir]          shows changes below a directory as they happen ([/watch] alone stops)"
+                "\n\t- [/getdir]  [/g] <dir> [-z]    downloads a directory into the current folder (-z to compress)"
+                "\n\t- [/sync]    [/y] <dir> <local>  keeps a local folder in sync with a directory, fetching only what changed"
+                "\n\t- [/search]  [/s] <terms> [user:<name>] [since:<age>]   searches the chat history (ages like 30s, 10m, 2h or 1d)"
+                "\n\t- [/hash]    [/#] <file> [-b]    shows the hash of a file on the server (-b for every 1MB block too)"
+                "\n\t- [/browse]  [/b] [dir]          lists a directory, from the local cache if it's still current"
+                "\n\t- [/read]    [/r] <file>         shows a file, from the local cache if it's still current"
+                "\n\t- [/du]      [/u] [dir]          shows how many bytes and files are below a directory on the server"
+                "\n\t- [/cache]   [/k] [seconds]      shows what the cache saved, or sets how long entries are trusted unchecked"
                 "\n\n"
                 "\nTHANK YOU FOR USING FHUB\n\n\n");
+            } else if (compareCommand(command, "getdir", 'g')) {
+                if (g_unpacking || g_syncState != SYNC_IDLE) {
+                    setTextColor(YELLOW);
+                    printf("SERVER >> a directory is already being downloaded\n");
+                    resetText();
+                } else {
+                    g_archiveStart = getTimeMicros();
+                    sendCommand("getdir", command);
+                }
+            } else if (compareCommand(command, "sync", 'y')) {
+                if (g_unpacking || g_syncState != SYNC_IDLE) {
+                    setTextColor(YELLOW);
+                    printf("SERVER >> a directory is already being downloaded\n");
+                    resetText();
+                } else {
+                    startSync(command);
+                }
+            } else if (compareCommand(command, "changedir", 'c')) {
+                sendCommand("changedir", command);
+            } else if (compareCommand(command, "list", 'l')) {
+                sendCommand("list", command);
+            } else if (compareCommand(command, "watch", 'w')) {
+                sendCommand("watch", command);
+            } else if (compareCommand(command, "search", 's')) {
+                sendCommand("search", command);
+            } else if (compareCommand(command, "hash", '#')) {
+                sendCommand("hash", command);
+            } else if (compareCommand(command, "browse", 'b')) {
+                requestCached(command, 'l');
+            } else if (compareCommand(command, "read", 'r')) {
+                requestCached(command, 'f');
+            } else if (compareCommand(command, "du", 'u')) {
+                sendCommand("du", command);
+            } else if (compareCommand(command, "cache", 'k')) {
+                printCacheStats(command);
             } else {
                 setTextColor(RED);
                 printf("SERVER >> Invalid command\n");
@@ -323,22 +989,63 @@ void* updateInput(void* arg) {
  * compares a given buffer to a command and it's respective shortcut
 */
 int compareCommand(char* buffer, char* command, char shortcut) {
-    int singleton = (strlen(buffer) == 1 || buffer[1] == ' ');
-    return (strcmp(buffer, command) == 0 || (singleton && buffer[0] == shortcut));
+    int length = strcspn(buffer, " ");
+    int singleton = (length == 1);
+    return ((length == strlen(command) && strncmp(buffer, command, length) == 0) || (singleton && buffer[0] == shortcut));
 }
 
+/**
+ * sends a command to be run on the server under its full name,
+ * along with whatever arguments were typed after it
+*/
+void sendCommand(char* name, char* command) {
+    char text[BUFFER_SIZE + 32];
+    char* args = strchr(command, ' ');
+    snprintf(text, sizeof(text), "%s%s", name, args == NULL ? "" : args);
+    sendToServer(COMMAND, text, strlen(text));
+}
+
+/**
+ * sends a single frame to the server over whichever transport the
+ * client connected with. Returns 0 on success
+*/
+int sendToServer(char type, const char* payload, unsigned int length) {
+#ifdef __linux__
+    if (g_local) {
+        // the ring only has room for one writer at a time
+        pthread_mutex_lock(&g_sendLock);
+        int failed = sendLinkFrame(&g_link, type, payload, length);
+        pthread_mutex_unlock(&g_sendLock);
+        return failed;
+    }
+#endif
+    return sendFrame(g_socket, type, payload, length);
+}
+
+/**
+ * receives whatever the server has sent, up to size bytes
+*/
+int receiveFromServer(char* buffer, int size) {
+#ifdef __linux__
+    if (g_local) return readLink(&g_link, buffer, size);
+#endif
+    return recv(g_socket, buffer, size, 0);
+}
+
+/**
+ * builds a packet of the given type into the buffer and
+ * sends it to the server as a single frame
+*/
 void sendPacket(char* buf, char type) {
-    buf[0] = type;
     switch (type) {
         case CHAT:
-            memcpy(buf + 1, g_username, strlen(g_username));
-            buf[strlen(g_username) + 1] = '>';
-            memcpy(buf + strlen(g_username) + 2, g_buffer, strlen(g_buffer));
-            send(g_socket, buf, strlen(buf), 0);
+            memcpy(buf, g_username, strlen(g_username));
+            buf[strlen(g_username)] = '>';
+            memcpy(buf + strlen(g_username) + 1, g_buffer, strlen(g_buffer));
+            sendToServer(CHAT, buf, strlen(buf));
             break;
         case SHUTDOWN:
-            ioctlsocket(g_socket, FIONBIO, 0);
-            send(g_socket, buf, strlen(buf), 0);
+            sendToServer(SHUTDOWN, buf, 0);
             break;
     }
 }
\ No newline at end of file
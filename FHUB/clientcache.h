@@ -0,0 +1,328 @@
+/**
+ * clientcache.h - the client's cache of remote directory listings and
+ * file contents. everything is kept on disk, with the most recently used
+ * entries held in memory in front of it. an entry carries the version the
+ * server gave it, which the server checks to say whether it's still good
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef CLIENTCACHE_H
+#define CLIENTCACHE_H
+
+// defines
+#define CACHE_DIR             ".fhub_cache"
+#define CACHE_MAGIC           "FHCC"
+#define CACHE_ENTRIES         64
+#define CACHE_MEMORY          (8 * 1024 * 1024)
+#define CACHE_ENTRY_MAX       (1024 * 1024)
+#define CACHE_VERSION_SIZE    64
+#define CACHE_KEY_SIZE        4096
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include "hashcache.h"
+
+// a listing or file held in memory. keys are l or f followed by the path
+// from the root, and body is NULL for files too big to keep in memory
+typedef struct {
+    char*      key;
+    char       version[CACHE_VERSION_SIZE];
+    long long  validated;
+    long long  used;
+    char*      body;
+    long long  length;
+} CacheEntry;
+
+// the cache, along with the entry being received from the server
+typedef struct {
+    CacheEntry entries[CACHE_ENTRIES];
+    int        count;
+    long long  memory;
+    long long  clock;
+    long long  fresh;
+    char       dir[512];
+    pthread_mutex_t lock;
+    FILE*      incoming;
+    char       incomingKey[CACHE_KEY_SIZE];
+    char       incomingVersion[CACHE_VERSION_SIZE];
+    char*      incomingBody;
+    long long  incomingLength;
+    long long  hits;
+    long long  revalidated;
+    long long  fetched;
+    long long  bytesFetched;
+    long long  bytesSaved;
+} RemoteCache;
+
+// function declarations
+void   initRemoteCache(RemoteCache* cache, const char* server, long long fresh);
+void   cacheFilePath(RemoteCache* cache, const char* key, char* path);
+CacheEntry* findCached(RemoteCache* cache, const char* key);
+CacheEntry* keepCached(RemoteCache* cache, const char* key, const char* version, long long validated, char* body, long long length);
+int    lookupRemote(RemoteCache* cache, const char* key, char* version, long long* validated);
+void   touchRemote(RemoteCache* cache, const char* key);
+long long copyRemote(RemoteCache* cache, const char* key, char* out, long long max);
+void   beginRemote(RemoteCache* cache, const char* key, const char* version);
+void   appendRemote(RemoteCache* cache, const char* data, int length);
+int    finishRemote(RemoteCache* cache);
+void   abandonRemote(RemoteCache* cache);
+
+/**
+ * Starts an empty cache for a server, kept on disk in a folder of its
+ * own. Entries validated less than fresh seconds ago are used without
+ * asking the server
+*/
+void initRemoteCache(RemoteCache* cache, const char* server, long long fresh) {
+    memset(cache, 0, sizeof(RemoteCache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->fresh = fresh;
+    snprintf(cache->dir, sizeof(cache->dir), "%s/%s", CACHE_DIR, server);
+#ifdef _WIN32
+    _mkdir(CACHE_DIR);
+    _mkdir(cache->dir);
+#else
+    mkdir(CACHE_DIR, 0777);
+    mkdir(cache->dir, 0777);
+#endif
+}
+
+/**
+ * Gets the file an entry is kept in on disk, named by the hash of its key
+*/
+void cacheFilePath(RemoteCache* cache, const char* key, char* path) {
+    snprintf(path, CACHE_KEY_SIZE + 600, "%s/%016llx", cache->dir, hashBytes(key, strlen(key), 0));
+}
+
+/**
+ * Finds an entry held in memory, marking it as the most recently used
+*/
+CacheEntry* findCached(RemoteCache* cache, const char* key) {
+    for (int i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i].key, key) != 0) continue;
+        cache->entries[i].used = ++cache->clock;
+        return &cache->entries[i];
+    }
+    return NULL;
+}
+
+/**
+ * Holds an entry in memory, taking over its body, and lets go of the
+ * least recently used entries until everything fits again
+*/
+CacheEntry* keepCached(RemoteCache* cache, const char* key, const char* version, long long validated, char* body, long long length) {
+    CacheEntry* entry = findCached(cache, key);
+    if (entry == NULL) {
+        if (cache->count == CACHE_ENTRIES) {
+            int oldest = 0;
+            for (int i = 1; i < cache->count; i++)
+                if (cache->entries[i].used < cache->entries[oldest].used) oldest = i;
+            CacheEntry* evicted = &cache->entries[oldest];
+            free(evicted->key);
+            free(evicted->body);
+            if (evicted->body != NULL) cache->memory -= evicted->length;
+            *evicted = cache->entries[--cache->count];
+        }
+        entry = &cache->entries[cache->count++];
+        memset(entry, 0, sizeof(CacheEntry));
+        entry->key = strdup(key);
+        entry->used = ++cache->clock;
+    } else if (entry->body != NULL) {
+        cache->memory -= entry->length;
+        free(entry->body);
+    }
+    snprintf(entry->version, CACHE_VERSION_SIZE, "%s", version);
+    entry->validated = validated;
+    entry->body = body;
+    entry->length = length;
+    if (body != NULL) cache->memory += length;
+
+    // bodies are dropped from the oldest entries first, keeping what
+    // they were so the disk can still answer for them
+    while (cache->memory > CACHE_MEMORY) {
+        CacheEntry* oldest = NULL;
+        for (int i = 0; i < cache->count; i++)
+            if (cache->entries[i].body != NULL && &cache->entries[i] != entry && (oldest == NULL || cache->entries[i].used < oldest->used))
+                oldest = &cache->entries[i];
+        if (oldest == NULL) break;
+        cache->memory -= oldest->length;
+        free(oldest->body);
+        oldest->body = NULL;
+    }
+    return entry;
+}
+
+/**
+ * Looks up the version an entry was cached at and when it was last known
+ * to be current, checking memory before disk. Returns 1 if it's cached
+*/
+int lookupRemote(RemoteCache* cache, const char* key, char* version, long long* validated) {
+    pthread_mutex_lock(&cache->lock);
+    CacheEntry* entry = findCached(cache, key);
+    if (entry == NULL) {
+        // the file starts with its version and key, then holds the body.
+        // its modification time is when it was last validated
+        char path[CACHE_KEY_SIZE + 600];
+        cacheFilePath(cache, key, path);
+        FILE* file = fopen(path, "rb");
+        struct stat info;
+        char header[CACHE_VERSION_SIZE + 8], stored[CACHE_KEY_SIZE + 2];
+        if (file != NULL && fstat(fileno(file), &info) == 0 && fgets(header, sizeof(header), file) != NULL &&
+            fgets(stored, sizeof(stored), file) != NULL && strncmp(header, CACHE_MAGIC " ", 5) == 0) {
+            header[strcspn(header, "\n")] = '\0';
+            stored[strcspn(stored, "\n")] = '\0';
+            if (strcmp(stored, key) == 0) {
+                long long length = info.st_size - ftell(file);
+                char* body = length <= CACHE_ENTRY_MAX ? malloc(length + 1) : NULL;
+                if (body != NULL && fread(body, 1, length, file) != (size_t)length) {
+                    free(body);
+                    body = NULL;
+                }
+                entry = keepCached(cache, key, header + 5, info.st_mtime, body, length);
+            }
+        }
+        if (file != NULL) fclose(file);
+    }
+    if (entry != NULL) {
+        strcpy(version, entry->version);
+        *validated = entry->validated;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return entry != NULL;
+}
+
+/**
+ * Marks an entry as just validated by the server
+*/
+void touchRemote(RemoteCache* cache, const char* key) {
+    pthread_mutex_lock(&cache->lock);
+    CacheEntry* entry = findCached(cache, key);
+    if (entry != NULL) {
+        entry->validated = time(NULL);
+        cache->bytesSaved += entry->length;
+    }
+    char path[CACHE_KEY_SIZE + 600];
+    cacheFilePath(cache, key, path);
+    utime(path, NULL);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Copies up to max bytes of an entry's body into out, from memory if it's
+ * there or else from disk. Returns the full length of the body, or -1 if
+ * it isn't cached
+*/
+long long copyRemote(RemoteCache* cache, const char* key, char* out, long long max) {
+    pthread_mutex_lock(&cache->lock);
+    CacheEntry* entry = findCached(cache, key);
+    long long length = entry == NULL ? -1 : entry->length;
+    long long wanted = length < max ? length : max;
+    if (entry != NULL && entry->body != NULL) {
+        memcpy(out, entry->body, wanted);
+    } else if (entry != NULL) {
+        char path[CACHE_KEY_SIZE + 600], line[CACHE_KEY_SIZE + 2];
+        cacheFilePath(cache, key, path);
+        FILE* file = fopen(path, "rb");
+        if (file == NULL || fgets(line, sizeof(line), file) == NULL || fgets(line, sizeof(line), file) == NULL ||
+            fread(out, 1, wanted, file) != (size_t)wanted) length = -1;
+        if (file != NULL) fclose(file);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return length;
+}
+
+/**
+ * Starts taking in a new version of an entry from the server, writing it
+ * to the side so the old one stays whole until the new one has arrived
+*/
+void beginRemote(RemoteCache* cache, const char* key, const char* version) {
+    pthread_mutex_lock(&cache->lock);
+    if (cache->incoming != NULL) fclose(cache->incoming);
+    free(cache->incomingBody);
+    snprintf(cache->incomingKey, CACHE_KEY_SIZE, "%s", key);
+    snprintf(cache->incomingVersion, CACHE_VERSION_SIZE, "%s", version);
+    cache->incomingBody = NULL;
+    cache->incomingLength = 0;
+    char path[CACHE_KEY_SIZE + 608];
+    cacheFilePath(cache, key, path);
+    strcat(path, ".part");
+    cache->incoming = fopen(path, "wb");
+    if (cache->incoming != NULL) fprintf(cache->incoming, CACHE_MAGIC " %s\n%s\n", version, key);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Adds the next piece of the entry coming in. Small entries are also
+ * gathered in memory so they can be kept there once they're done
+*/
+void appendRemote(RemoteCache* cache, const char* data, int length) {
+    pthread_mutex_lock(&cache->lock);
+    if (cache->incoming != NULL) {
+        fwrite(data, 1, length, cache->incoming);
+        long long total = cache->incomingLength + length;
+        if (total <= CACHE_ENTRY_MAX && (cache->incomingLength == 0 || cache->incomingBody != NULL)) {
+            cache->incomingBody = realloc(cache->incomingBody, total + 1);
+            memcpy(cache->incomingBody + cache->incomingLength, data, length);
+        } else {
+            free(cache->incomingBody);
+            cache->incomingBody = NULL;
+        }
+        cache->incomingLength = total;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Puts the entry that came in in place of the old one. Returns 0 on
+ * success, or -1 if it couldn't be written out
+*/
+int finishRemote(RemoteCache* cache) {
+    pthread_mutex_lock(&cache->lock);
+    int failed = cache->incoming == NULL || ferror(cache->incoming);
+    if (cache->incoming != NULL && fclose(cache->incoming) != 0) failed = 1;
+    cache->incoming = NULL;
+    char path[CACHE_KEY_SIZE + 600], temporary[CACHE_KEY_SIZE + 608];
+    cacheFilePath(cache, cache->incomingKey, path);
+    snprintf(temporary, sizeof(temporary), "%s.part", path);
+    if (!failed) {
+        remove(path);
+        failed = rename(temporary, path) != 0;
+    }
+    if (failed) {
+        remove(temporary);
+        free(cache->incomingBody);
+    } else {
+        keepCached(cache, cache->incomingKey, cache->incomingVersion, time(NULL), cache->incomingBody, cache->incomingLength);
+        cache->fetched++;
+        cache->bytesFetched += cache->incomingLength;
+    }
+    cache->incomingBody = NULL;
+    pthread_mutex_unlock(&cache->lock);
+    return failed ? -1 : 0;
+}
+
+/**
+ * Throws away an entry that didn't fully arrive
+*/
+void abandonRemote(RemoteCache* cache) {
+    pthread_mutex_lock(&cache->lock);
+    if (cache->incoming != NULL) {
+        fclose(cache->incoming);
+        cache->incoming = NULL;
+        char path[CACHE_KEY_SIZE + 608];
+        cacheFilePath(cache, cache->incomingKey, path);
+        strcat(path, ".part");
+        remove(path);
+    }
+    free(cache->incomingBody);
+    cache->incomingBody = NULL;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+#endif
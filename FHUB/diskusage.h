@@ -0,0 +1,350 @@
+/**
+ * diskusage.h - running totals of the bytes and files below every
+ * directory of a tree. the tree is walked once, then kept current by
+ * refreshing whichever paths are reported changed, so asking how much a
+ * directory holds never walks anything. directories can also be given
+ * quotas, which writes are checked against before they happen
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef DISKUSAGE_H
+#define DISKUSAGE_H
+
+// defines
+#define USAGE_BUCKETS         4096
+#define MAX_QUOTAS            64
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "utils.h"
+#include "hashcache.h"
+#include "fileops.h"
+
+// a file or directory in the tree, by its path relative to the root. a
+// directory's totals count everything below it, a file's are its own
+typedef struct UsageNode {
+    struct UsageNode*  next;
+    struct UsageNode*  parent;
+    struct UsageNode*  children;
+    struct UsageNode*  sibling;
+    char*              path;
+    int                directory;
+    long long          bytes;
+    long long          files;
+} UsageNode;
+
+// a limit on what a directory can hold. zero means no limit
+typedef struct {
+    char*              path;
+    long long          bytes;
+    long long          files;
+} Quota;
+
+// every tracked path, indexed by path, along with the quotas. quotas are
+// kept apart from the nodes so they outlast the directory being rescanned
+typedef struct {
+    UsageNode*         buckets[USAGE_BUCKETS];
+    UsageNode*         root;
+    char*              rootPath;
+    int                count;
+    Quota              quotas[MAX_QUOTAS];
+    int                quotaCount;
+    long long          refreshes;
+    long long          refused;
+    pthread_mutex_t    lock;
+} UsageTree;
+
+// function declarations
+void   initUsage(UsageTree* tree, const char* root);
+void   refreshUsage(UsageTree* tree, const char* path, int rescan);
+int    getUsage(UsageTree* tree, const char* path, long long* bytes, long long* files);
+int    setQuota(UsageTree* tree, const char* path, long long bytes, long long files);
+int    checkQuota(UsageTree* tree, const char* path, const char* from, long long bytes, long long files, char* over);
+long long parseSize(const char* text);
+UsageNode* findUsage(UsageTree* tree, const char* path);
+UsageNode* addUsage(UsageTree* tree, UsageNode* parent, const char* path, int directory);
+void   dropUsage(UsageTree* tree, UsageNode* node);
+void   scanUsage(UsageTree* tree, UsageNode* node);
+void   applyUsage(UsageNode* node, long long bytes, long long files);
+
+/**
+ * Starts an empty tree for the directory at root. Nothing is counted
+ * until the root is refreshed, which walks it
+*/
+void initUsage(UsageTree* tree, const char* root) {
+    memset(tree, 0, sizeof(UsageTree));
+    pthread_mutex_init(&tree->lock, NULL);
+    tree->rootPath = strdup(root);
+}
+
+/**
+ * Brings the totals for a path up to date with what's on disk. A file
+ * takes its new size, a new directory is walked, and a path that's gone
+ * is dropped, with the difference carried up to every directory above.
+ * A directory that's still a directory is only walked again if rescan is
+ * set, since a change to the directory itself, like its times or
+ * permissions, leaves what's below it alone. Refreshing a path that
+ * hasn't changed changes nothing, so the same change can be reported
+ * more than once
+*/
+void refreshUsage(UsageTree* tree, const char* path, int rescan) {
+    pthread_mutex_lock(&tree->lock);
+    tree->refreshes++;
+    UsageNode* node = findUsage(tree, path);
+    long long oldBytes = node == NULL ? 0 : node->bytes;
+    long long oldFiles = node == NULL ? 0 : node->files;
+    UsageNode* parent = node == NULL ? NULL : node->parent;
+
+    struct stat info;
+    char* full = path[0] == '\0' ? strdup(tree->rootPath) : joinPath(tree->rootPath, path);
+#ifdef _WIN32
+    int exists = full != NULL && stat(full, &info) == 0 && (S_ISREG(info.st_mode) || S_ISDIR(info.st_mode));
+#else
+    int exists = full != NULL && lstat(full, &info) == 0 && (S_ISREG(info.st_mode) || S_ISDIR(info.st_mode));
+#endif
+    free(full);
+    if (!rescan && node != NULL && node->directory && exists && S_ISDIR(info.st_mode)) {
+        pthread_mutex_unlock(&tree->lock);
+        return;
+    }
+
+    // a new path needs its parent tracked first. if it isn't, walking
+    // the parent picks this path up along with it
+    if (exists && node == NULL && path[0] != '\0') {
+        char* parentPath = strdup(path);
+        char* last = parentPath == NULL ? NULL : strrchr(parentPath, '/');
+        if (last != NULL) *last = '\0';
+        else if (parentPath != NULL) parentPath[0] = '\0';
+        parent = parentPath == NULL ? NULL : findUsage(tree, parentPath);
+        if (parent == NULL || !parent->directory) {
+            pthread_mutex_unlock(&tree->lock);
+            if (parentPath != NULL && strcmp(parentPath, path) != 0) refreshUsage(tree, parentPath, rescan);
+            free(parentPath);
+            return;
+        }
+        free(parentPath);
+    }
+
+    // anything that was here before is taken out, except a file that's
+    // still a file, which only needs its size changed
+    if (node != NULL && (!exists || node->directory || S_ISDIR(info.st_mode))) {
+        dropUsage(tree, node);
+        node = NULL;
+    }
+    if (exists && node == NULL) {
+        node = addUsage(tree, parent, path, S_ISDIR(info.st_mode));
+        if (node != NULL && node->directory) scanUsage(tree, node);
+    }
+    if (node != NULL && !node->directory) {
+        node->bytes = info.st_size;
+        node->files = 1;
+    }
+    if (path[0] == '\0') tree->root = node;
+
+    long long newBytes = node == NULL ? 0 : node->bytes;
+    long long newFiles = node == NULL ? 0 : node->files;
+    if (parent != NULL) applyUsage(parent, newBytes - oldBytes, newFiles - oldFiles);
+    pthread_mutex_unlock(&tree->lock);
+}
+
+/**
+ * Gets the bytes and files below a path. Returns 0 if the path
+ * isn't tracked, 1 otherwise
+*/
+int getUsage(UsageTree* tree, const char* path, long long* bytes, long long* files) {
+    pthread_mutex_lock(&tree->lock);
+    UsageNode* node = findUsage(tree, path);
+    if (node != NULL) {
+        *bytes = node->bytes;
+        *files = node->files;
+    }
+    pthread_mutex_unlock(&tree->lock);
+    return node != NULL;
+}
+
+/**
+ * Sets the quota on a directory, replacing any it had. Zero for both
+ * limits takes the quota away. Returns 0 on success, or -1 if there
+ * are already as many quotas as there can be
+*/
+int setQuota(UsageTree* tree, const char* path, long long bytes, long long files) {
+    pthread_mutex_lock(&tree->lock);
+    int index = 0;
+    while (index < tree->quotaCount && strcmp(tree->quotas[index].path, path) != 0) index++;
+    int failed = 0;
+    if (bytes == 0 && files == 0) {
+        if (index < tree->quotaCount) {
+            free(tree->quotas[index].path);
+            tree->quotas[index] = tree->quotas[--tree->quotaCount];
+        }
+    } else if (index == tree->quotaCount && tree->quotaCount == MAX_QUOTAS) {
+        failed = 1;
+    } else {
+        if (index == tree->quotaCount) {
+            tree->quotas[index].path = strdup(path);
+            tree->quotaCount++;
+        }
+        tree->quotas[index].bytes = bytes;
+        tree->quotas[index].files = files;
+    }
+    pthread_mutex_unlock(&tree->lock);
+    return failed ? -1 : 0;
+}
+
+/**
+ * Checks whether bytes and files can be added at path without going over
+ * the quota of any directory it's in. A move passes where the item comes
+ * from, since quotas holding both ends don't change. Returns 1 if they
+ * fit, otherwise 0 with the directory whose quota they break put in over
+*/
+int checkQuota(UsageTree* tree, const char* path, const char* from, long long bytes, long long files, char* over) {
+    int fits = 1;
+    pthread_mutex_lock(&tree->lock);
+    for (int i = 0; i < tree->quotaCount && fits; i++) {
+        Quota* quota = &tree->quotas[i];
+        if (!isUnder(path, quota->path) || (from != NULL && isUnder(from, quota->path))) continue;
+        UsageNode* node = findUsage(tree, quota->path);
+        long long usedBytes = node == NULL ? 0 : node->bytes;
+        long long usedFiles = node == NULL ? 0 : node->files;
+        if ((quota->bytes > 0 && usedBytes + bytes > quota->bytes) || (quota->files > 0 && usedFiles + files > quota->files)) {
+            strcpy(over, quota->path);
+            fits = 0;
+        }
+    }
+    if (!fits) tree->refused++;
+    pthread_mutex_unlock(&tree->lock);
+    return fits;
+}
+
+/**
+ * Reads a size like 512, 64k, 10M or 2G. Returns -1 if it isn't one
+*/
+long long parseSize(const char* text) {
+    char* end;
+    long long size = strtoll(text, &end, 10);
+    if (end == text || size < 0) return -1;
+    switch (tolower((unsigned char)*end)) {
+        case 'k': size <<= 10; end++; break;
+        case 'm': size <<= 20; end++; break;
+        case 'g': size <<= 30; end++; break;
+        case 't': size <<= 40; end++; break;
+    }
+    return *end == '\0' ? size : -1;
+}
+
+/**
+ * Finds the node for a path. The tree must be locked
+*/
+UsageNode* findUsage(UsageTree* tree, const char* path) {
+    UsageNode* node = tree->buckets[hashBytes(path, strlen(path), 0) % USAGE_BUCKETS];
+    while (node != NULL && strcmp(node->path, path) != 0) node = node->next;
+    return node;
+}
+
+/**
+ * Adds an empty node for a path below parent. The tree must be locked
+*/
+UsageNode* addUsage(UsageTree* tree, UsageNode* parent, const char* path, int directory) {
+    UsageNode* node = calloc(1, sizeof(UsageNode));
+    if (node == NULL || (node->path = strdup(path)) == NULL) {
+        free(node);
+        return NULL;
+    }
+    node->directory = directory;
+    node->parent = parent;
+    if (parent != NULL) {
+        node->sibling = parent->children;
+        parent->children = node;
+    }
+    UsageNode** bucket = &tree->buckets[hashBytes(path, strlen(path), 0) % USAGE_BUCKETS];
+    node->next = *bucket;
+    *bucket = node;
+    tree->count++;
+    return node;
+}
+
+/**
+ * Takes a node and everything below it out of the tree without touching
+ * the totals above it. The tree must be locked
+*/
+void dropUsage(UsageTree* tree, UsageNode* node) {
+    while (node->children != NULL) {
+        UsageNode* child = node->children;
+        node->children = child->sibling;
+        child->parent = NULL;
+        dropUsage(tree, child);
+    }
+    if (node->parent != NULL) {
+        UsageNode** link = &node->parent->children;
+        while (*link != node) link = &(*link)->sibling;
+        *link = node->sibling;
+    }
+    UsageNode** link = &tree->buckets[hashBytes(node->path, strlen(node->path), 0) % USAGE_BUCKETS];
+    while (*link != node) link = &(*link)->next;
+    *link = node->next;
+    if (tree->root == node) tree->root = NULL;
+    tree->count--;
+    free(node->path);
+    free(node);
+}
+
+/**
+ * Walks a directory that was just added, adding everything below it and
+ * totalling it up. The tree must be locked
+*/
+void scanUsage(UsageTree* tree, UsageNode* node) {
+    char* full = node->path[0] == '\0' ? strdup(tree->rootPath) : joinPath(tree->rootPath, node->path);
+    DIR* directory = full == NULL ? NULL : opendir(full);
+    if (directory == NULL) {
+        free(full);
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        struct stat info;
+        char* childFull = joinPath(full, entry->d_name);
+        char* childPath = node->path[0] == '\0' ? strdup(entry->d_name) : joinPath(node->path, entry->d_name);
+#ifdef _WIN32
+        int found = childFull != NULL && childPath != NULL && stat(childFull, &info) == 0;
+#else
+        int found = childFull != NULL && childPath != NULL && lstat(childFull, &info) == 0;
+#endif
+        UsageNode* child = NULL;
+        if (found && (S_ISREG(info.st_mode) || S_ISDIR(info.st_mode)) && findUsage(tree, childPath) == NULL)
+            child = addUsage(tree, node, childPath, S_ISDIR(info.st_mode));
+        if (child != NULL && child->directory) {
+            scanUsage(tree, child);
+        } else if (child != NULL) {
+            child->bytes = info.st_size;
+            child->files = 1;
+        }
+        if (child != NULL) {
+            node->bytes += child->bytes;
+            node->files += child->files;
+        }
+        free(childFull);
+        free(childPath);
+    }
+    closedir(directory);
+    free(full);
+}
+
+/**
+ * Adds to the totals of a directory and every directory above it
+*/
+void applyUsage(UsageNode* node, long long bytes, long long files) {
+    for (; node != NULL; node = node->parent) {
+        node->bytes += bytes;
+        node->files += files;
+    }
+}
+
+#endif
@@ -0,0 +1,484 @@
+/**
+ * fileops.h - copying and moving files and directory trees on the server
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef FILEOPS_H
+#define FILEOPS_H
+
+// defines
+#define COPY_WORKERS          4
+#define COPY_CHUNK_SIZE       (64 * 1024 * 1024)
+#define COPY_BUFFER_SIZE      (128 * 1024)
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+#include "workdir.h"
+
+// not every set of kernel headers has these
+#if defined(__linux__) && !defined(FICLONE)
+#define FICLONE               _IOW(0x94, 9, int)
+#endif
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE      (1 << 0)
+#endif
+
+// totals collected while copying a file or tree
+typedef struct {
+    long long files;
+    long long directories;
+    long long bytes;
+    long long cloned;
+    long long failed;
+} CopyStats;
+
+// a single file waiting for a copy worker. the paths are below the
+// tops of the two trees, or whole paths on windows
+typedef struct CopyJob {
+    struct CopyJob* next;
+    char*           from;
+    char*           to;
+} CopyJob;
+
+// work shared between the tree walker and the copy workers. from and
+// to are handles to the tops of the two trees, unused on windows
+typedef struct {
+    CopyJob*        head;
+    CopyJob*        tail;
+    int             done;
+    int             from;
+    int             to;
+    CopyStats       stats;
+    pthread_mutex_t lock;
+    pthread_cond_t  ready;
+} CopyQueue;
+
+// function declarations. items are named by a directory handle and a
+// name inside of it, except on windows where the name is the whole path
+// and the handle is ignored
+int    copyFile(int fromDir, const char* from, int toDir, const char* to, CopyStats* stats);
+int    copyTree(int fromDir, const char* from, int toDir, const char* to, CopyStats* stats);
+int    copyLink(int fromDir, const char* from, int toDir, const char* to);
+int    movePath(int fromDir, const char* from, int toDir, const char* to);
+int    removeTree(int dir, const char* name);
+int    statAt(int dir, const char* name, struct stat* info);
+int    makeDirectory(const char* path);
+DIR*   makeCopyDir(int fromDir, const char* from, int toDir, const char* to, int* out);
+void   walkCopy(CopyQueue* queue, DIR* directory, int out, const char* from, const char* to);
+void*  copyWorker(void* arg);
+char*  joinPath(const char* base, const char* name);
+
+/**
+ * Creates a single directory
+*/
+int makeDirectory(const char* path) {
+#ifdef _WIN32
+    return _mkdir(path);
+#else
+    return mkdir(path, 0777);
+#endif
+}
+
+/**
+ * Joins a directory and a name into a newly allocated path
+*/
+char* joinPath(const char* base, const char* name) {
+    char* path = malloc(strlen(base) + strlen(name) + 2);
+    if (path == NULL) return NULL;
+    sprintf(path, "%s/%s", base, name);
+    return path;
+}
+
+/**
+ * Looks at an item without following it if it's a symlink.
+ * Returns 0 on success
+*/
+int statAt(int dir, const char* name, struct stat* info) {
+#ifdef _WIN32
+    return stat(name, info);
+#else
+    return fstatat(dir, name, info, AT_SYMLINK_NOFOLLOW);
+#endif
+}
+
+/**
+ * Copies a single file without overwriting anything. Neither side is
+ * followed out of its directory or through a symlink. On linux the copy
+ * never passes through userspace: it tries a reflink first, which shares
+ * the blocks on filesystems that support it, then copy_file_range, then
+ * sendfile, and only reads and writes the data itself as a last resort.
+ * Returns 0 on success and -1 on failure
+*/
+int copyFile(int fromDir, const char* from, int toDir, const char* to, CopyStats* stats) {
+#ifdef _WIN32
+    struct stat info;
+    if (stat(from, &info) != 0 || !CopyFileA(from, to, TRUE)) return -1;
+    stats->files++;
+    stats->bytes += info.st_size;
+    return 0;
+#else
+    int in = openBeneath(fromDir, from, O_RDONLY | O_NOFOLLOW | O_NONBLOCK, 0);
+    if (in < 0) return -1;
+    struct stat info;
+    if (fstat(in, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(in);
+        return -1;
+    }
+    int out = openBeneath(toDir, to, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, info.st_mode & 0777);
+    if (out < 0) {
+        close(in);
+        return -1;
+    }
+
+    int result = 0;
+    if (ioctl(out, FICLONE, in) == 0) {
+        stats->cloned++;
+    } else {
+        // let the kernel copy it, falling back as far as we have to
+        off_t remaining = info.st_size;
+        int method = 0;
+        while (remaining > 0) {
+            size_t chunk = remaining > COPY_CHUNK_SIZE ? COPY_CHUNK_SIZE : (size_t)remaining;
+            ssize_t copied;
+            if (method == 0) copied = syscall(SYS_copy_file_range, in, NULL, out, NULL, chunk, 0);
+            else if (method == 1) copied = sendfile(out, in, NULL, chunk);
+            else {
+                static __thread char buffer[COPY_BUFFER_SIZE];
+                copied = read(in, buffer, chunk < COPY_BUFFER_SIZE ? chunk : COPY_BUFFER_SIZE);
+                if (copied > 0 && write(out, buffer, copied) != copied) copied = -1;
+            }
+            if (copied < 0) {
+                if (errno == EINTR) continue;
+                if (method < 2 && remaining == info.st_size &&
+                    (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+                    method++;
+                    continue;
+                }
+                result = -1;
+                break;
+            }
+            if (copied == 0) break; // the file shrank while we were copying it
+            remaining -= copied;
+        }
+    }
+    close(in);
+    if (close(out) != 0) result = -1;
+    if (result != 0) {
+        unlinkat(toDir, to, 0);
+        return -1;
+    }
+    stats->files++;
+    stats->bytes += info.st_size;
+    return 0;
+#endif
+}
+
+/**
+ * Recreates a symlink rather than following it, so nothing outside
+ * of the tree gets pulled in. Returns 0 on success
+*/
+int copyLink(int fromDir, const char* from, int toDir, const char* to) {
+#ifdef _WIN32
+    return -1;
+#else
+    char link[4096];
+    ssize_t length = readlinkat(fromDir, from, link, sizeof(link) - 1);
+    if (length < 0) return -1;
+    link[length] = '\0';
+    return symlinkat(link, toDir, to);
+#endif
+}
+
+/**
+ * Copies a file or a whole directory tree to a path that doesn't exist yet.
+ * The directory structure is created as the tree is walked while a pool of
+ * workers copies the files in parallel. Returns 0 if everything copied
+*/
+int copyTree(int fromDir, const char* from, int toDir, const char* to, CopyStats* stats) {
+    struct stat info;
+    if (statAt(fromDir, from, &info) != 0) return -1;
+#ifndef _WIN32
+    if (S_ISLNK(info.st_mode)) {
+        if (copyLink(fromDir, from, toDir, to) != 0) {
+            stats->failed++;
+            return -1;
+        }
+        stats->files++;
+        return 0;
+    }
+#endif
+    if (!S_ISDIR(info.st_mode)) {
+        if (copyFile(fromDir, from, toDir, to, stats) != 0) {
+            stats->failed++;
+            return -1;
+        }
+        return 0;
+    }
+
+    int out;
+    DIR* directory = makeCopyDir(fromDir, from, toDir, to, &out);
+    if (directory == NULL) {
+        stats->failed++;
+        return -1;
+    }
+    CopyQueue queue = { 0 };
+    queue.stats.directories = 1;
+#ifndef _WIN32
+    queue.from = dirfd(directory);
+    queue.to = out;
+#endif
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.ready, NULL);
+    pthread_t workers[COPY_WORKERS];
+    int numWorkers = 0;
+    for (; numWorkers < COPY_WORKERS; numWorkers++)
+        if (pthread_create(&workers[numWorkers], NULL, copyWorker, &queue) != 0)
+            break;
+
+#ifdef _WIN32
+    walkCopy(&queue, directory, out, from, to);
+#else
+    walkCopy(&queue, directory, out, ".", ".");
+#endif
+
+    // let the workers drain the queue and finish
+    pthread_mutex_lock(&queue.lock);
+    queue.done = 1;
+    pthread_cond_broadcast(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+    if (numWorkers == 0) copyWorker(&queue);
+    for (int i = 0; i < numWorkers; i++)
+        pthread_join(workers[i], NULL);
+    closedir(directory);
+#ifndef _WIN32
+    close(out);
+#endif
+
+    pthread_mutex_destroy(&queue.lock);
+    pthread_cond_destroy(&queue.ready);
+    stats->files       += queue.stats.files;
+    stats->directories += queue.stats.directories;
+    stats->bytes       += queue.stats.bytes;
+    stats->cloned      += queue.stats.cloned;
+    stats->failed      += queue.stats.failed;
+    return queue.stats.failed == 0 ? 0 : -1;
+}
+
+/**
+ * Creates to as a new, empty directory for the directory at from to be
+ * copied into, putting a handle to it in out on everything but windows.
+ * Returns the directory at from opened for reading, or NULL on failure
+*/
+DIR* makeCopyDir(int fromDir, const char* from, int toDir, const char* to, int* out) {
+    *out = -1;
+#ifdef _WIN32
+    if (makeDirectory(to) != 0) return NULL;
+    return opendir(from);
+#else
+    DIR* directory = openDirAt(fromDir, from);
+    if (directory == NULL) return NULL;
+    if (mkdirat(toDir, to, 0777) == 0) *out = openBeneath(toDir, to, O_RDONLY | O_DIRECTORY | O_NOFOLLOW, 0);
+    if (*out < 0) {
+        closedir(directory);
+        return NULL;
+    }
+    return directory;
+#endif
+}
+
+/**
+ * Copies everything inside of an open directory into the one opened as
+ * out, making subdirectories and links as it goes and handing every file
+ * to the copy workers. from and to are where the two directories are below
+ * the tops of their trees, or their whole paths on windows
+*/
+void walkCopy(CopyQueue* queue, DIR* directory, int out, const char* from, const char* to) {
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        char* source = joinPath(from, entry->d_name);
+        char* destination = joinPath(to, entry->d_name);
+        struct stat info;
+#ifdef _WIN32
+        int at = -1;
+        const char* name = source;
+        const char* made = destination;
+#else
+        int at = dirfd(directory);
+        const char* name = entry->d_name;
+        const char* made = entry->d_name;
+#endif
+        int copied = source != NULL && destination != NULL && statAt(at, name, &info) == 0;
+
+        if (copied && S_ISDIR(info.st_mode)) {
+            int childOut;
+            DIR* child = makeCopyDir(at, name, out, made, &childOut);
+            copied = child != NULL;
+            if (copied) {
+                pthread_mutex_lock(&queue->lock);
+                queue->stats.directories++;
+                pthread_mutex_unlock(&queue->lock);
+                walkCopy(queue, child, childOut, source, destination);
+                closedir(child);
+#ifndef _WIN32
+                close(childOut);
+#endif
+            }
+            free(source);
+            free(destination);
+#ifndef _WIN32
+        } else if (copied && S_ISLNK(info.st_mode)) {
+            // links are recreated rather than followed so nothing outside gets pulled in
+            copied = copyLink(at, name, out, made) == 0;
+            if (copied) {
+                pthread_mutex_lock(&queue->lock);
+                queue->stats.files++;
+                pthread_mutex_unlock(&queue->lock);
+            }
+            free(source);
+            free(destination);
+#endif
+        } else if (copied) {
+            CopyJob* job = malloc(sizeof(CopyJob));
+            if (job == NULL) {
+                free(source);
+                free(destination);
+                continue;
+            }
+            job->next = NULL;
+            job->from = source;
+            job->to = destination;
+            pthread_mutex_lock(&queue->lock);
+            if (queue->tail != NULL) queue->tail->next = job;
+            else queue->head = job;
+            queue->tail = job;
+            pthread_cond_signal(&queue->ready);
+            pthread_mutex_unlock(&queue->lock);
+        } else {
+            free(source);
+            free(destination);
+        }
+
+        if (!copied) {
+            pthread_mutex_lock(&queue->lock);
+            queue->stats.failed++;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+}
+
+/**
+ * Copy worker thread. Copies files off the queue until
+ * the walker is finished and the queue is empty
+*/
+void* copyWorker(void* arg) {
+    CopyQueue* queue = arg;
+    pthread_mutex_lock(&queue->lock);
+    while (1) {
+        while (queue->head == NULL && !queue->done)
+            pthread_cond_wait(&queue->ready, &queue->lock);
+        if (queue->head == NULL) break;
+        CopyJob* job = queue->head;
+        queue->head = job->next;
+        if (queue->head == NULL) queue->tail = NULL;
+        pthread_mutex_unlock(&queue->lock);
+
+        CopyStats stats = { 0 };
+        int result = copyFile(queue->from, job->from, queue->to, job->to, &stats);
+        free(job->from);
+        free(job->to);
+        free(job);
+
+        pthread_mutex_lock(&queue->lock);
+        if (result != 0) queue->stats.failed++;
+        queue->stats.files  += stats.files;
+        queue->stats.bytes  += stats.bytes;
+        queue->stats.cloned += stats.cloned;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+/**
+ * Moves or renames a file or directory without overwriting anything.
+ * Within one filesystem this is a single rename no matter how big the
+ * tree is. Moves across filesystems fall back to a copy and delete.
+ * Returns 0 on success and -1 on failure
+*/
+int movePath(int fromDir, const char* from, int toDir, const char* to) {
+#ifdef _WIN32
+    if (MoveFileExA(from, to, 0)) return 0;
+    if (GetLastError() != ERROR_NOT_SAME_DEVICE) return -1;
+#else
+    if (syscall(SYS_renameat2, fromDir, from, toDir, to, RENAME_NOREPLACE) == 0) return 0;
+    if (errno == ENOSYS || errno == EINVAL) {
+        // the filesystem can't refuse to overwrite for us, so check first
+        struct stat info;
+        if (fstatat(toDir, to, &info, AT_SYMLINK_NOFOLLOW) == 0) {
+            errno = EEXIST;
+            return -1;
+        }
+        if (renameat(fromDir, from, toDir, to) == 0) return 0;
+    }
+    if (errno != EXDEV) return -1;
+#endif
+    CopyStats stats = { 0 };
+    if (copyTree(fromDir, from, toDir, to, &stats) != 0) {
+        removeTree(toDir, to);
+        return -1;
+    }
+    return removeTree(fromDir, from);
+}
+
+/**
+ * Deletes a file or a directory and everything inside of it,
+ * removing symlinks themselves rather than what they point at
+*/
+int removeTree(int dir, const char* name) {
+    struct stat info;
+    if (statAt(dir, name, &info) != 0) return -1;
+#ifdef _WIN32
+    if (!S_ISDIR(info.st_mode)) return remove(name);
+    DIR* directory = opendir(name);
+#else
+    if (!S_ISDIR(info.st_mode)) return unlinkat(dir, name, 0);
+    DIR* directory = openDirAt(dir, name);
+#endif
+    if (directory == NULL) return -1;
+
+    int result = 0;
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+#ifdef _WIN32
+        char* child = joinPath(name, entry->d_name);
+        if (child == NULL || removeTree(-1, child) != 0) result = -1;
+        free(child);
+#else
+        if (removeTree(dirfd(directory), entry->d_name) != 0) result = -1;
+#endif
+    }
+    closedir(directory);
+#ifdef _WIN32
+    if (_rmdir(name) != 0) result = -1;
+#else
+    if (unlinkat(dir, name, AT_REMOVEDIR) != 0) result = -1;
+#endif
+    return result;
+}
+
+#endif
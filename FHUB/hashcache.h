@@ -0,0 +1,661 @@
+/**
+ * hashcache.h - a cache of content hashes for hosted files. files are
+ * hashed with XXH64, whose four independent lanes keep a core busy, by
+ * background workers the first time they're asked for. results are keyed
+ * by device, inode, size and modification time, kept in memory and
+ * appended to a sidecar file so they outlive the server
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef HASHCACHE_H
+#define HASHCACHE_H
+
+// defines
+#define HASH_BLOCK_SIZE       (1024 * 1024)
+#define HASH_BUCKETS          4096
+#define HASH_MAX_WORKERS      8
+#define HASH_MAX_BUSY         32
+#define HASH_CACHE_MAGIC      "FHHC"
+#define HASH_CACHE_VERSION    1
+#define HASH_PRIME_1          0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2          0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3          0x165667B19E3779F9ULL
+#define HASH_PRIME_4          0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME_5          0x27D4EB2F165667C5ULL
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include "utils.h"
+
+// the running state of an XXH64 hash
+typedef struct {
+    unsigned long long lanes[4];
+    unsigned long long total;
+    unsigned long long seed;
+    unsigned char      stripe[32];
+    int                buffered;
+} HashState;
+
+// what identifies a version of a file. a file that is written to
+// gets a new modification time, so its old hash stops matching
+typedef struct {
+    unsigned long long device;
+    unsigned long long inode;
+    unsigned long long size;
+    long long          modified;
+} HashKey;
+
+// a cached hash. files bigger than a block also keep a hash of every
+// block so that changed parts can be found without comparing it all
+typedef struct HashEntry {
+    struct HashEntry*  next;
+    struct HashEntry*  pathNext;
+    HashKey            key;
+    unsigned long long hash;
+    int                blocks;
+    unsigned long long* blockHashes;
+    char*              path;
+} HashEntry;
+
+// the answer to a hash request. blockHashes is only filled in when the
+// request asked for it, and belongs to whoever gets the result
+typedef struct {
+    unsigned long long hash;
+    unsigned long long size;
+    int                blocks;
+    unsigned long long* blockHashes;
+    int                cached;
+    int                error;
+} HashResult;
+
+// a file waiting for a worker. fd is already open on it and is closed
+// by the worker, owner and ownerId say who to give the result to
+typedef struct HashRequest {
+    struct HashRequest* next;
+    int                fd;
+    char*              path;
+    int                wantBlocks;
+    int                owner;
+    unsigned long long ownerId;
+} HashRequest;
+
+// called by a worker once a requested hash is known
+typedef void (*HashFinished)(HashRequest* request, HashResult* result);
+
+// every cached hash, indexed both by inode and by path, the queue of
+// requests and the workers taking them. busy holds the files being hashed,
+// by the workers or by anyone else, so that two requests for one file
+// don't both read it
+typedef struct {
+    HashEntry*         byInode[HASH_BUCKETS];
+    HashEntry*         byPath[HASH_BUCKETS];
+    int                count;
+    HashRequest*       head;
+    HashRequest*       tail;
+    HashKey            busy[HASH_MAX_BUSY];
+    int                busyCount;
+    pthread_t          workers[HASH_MAX_WORKERS];
+    int                workerCount;
+    FILE*              sidecar;
+    HashFinished       finished;
+    long long          hits;
+    long long          misses;
+    long long          hashed;
+    long long          invalidated;
+    pthread_mutex_t    lock;
+    pthread_cond_t     ready;
+    pthread_cond_t     done;
+} HashCache;
+
+// function declarations
+void   initHash(HashState* state, unsigned long long seed);
+void   updateHash(HashState* state, const void* data, size_t length);
+unsigned long long finishHash(HashState* state);
+unsigned long long hashBytes(const void* data, size_t length, unsigned long long seed);
+int    initHashCache(HashCache* cache, const char* sidecar, int workers, HashFinished finished);
+void   makeHashKey(HashKey* key, struct stat* info);
+int    lookupHash(HashCache* cache, HashKey* key, int wantBlocks, HashResult* result);
+void   requestHash(HashCache* cache, HashRequest* request);
+void   invalidateHashes(HashCache* cache, const char* path, int tree);
+int    cacheFile(HashCache* cache, int fd, const char* path, HashKey* key, int wantBlocks, HashResult* result);
+int    hashFile(int fd, unsigned long long size, unsigned long long* hash, unsigned long long* blockHashes);
+void*  hashWorker(void* arg);
+HashEntry* findHash(HashCache* cache, HashKey* key);
+void   storeHash(HashCache* cache, HashEntry* entry);
+void   unlinkHash(HashCache* cache, HashEntry* entry);
+void   writeHashRecord(FILE* file, HashEntry* entry);
+int    readHashRecord(FILE* file, HashEntry* entry);
+void   loadHashCache(HashCache* cache, const char* sidecar);
+unsigned int hashPathBucket(const char* path);
+
+/**
+ * Rotates a 64 bit value left
+*/
+static inline unsigned long long rotateLeft(unsigned long long value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * Mixes 8 bytes of input into a lane
+*/
+static inline unsigned long long hashRound(unsigned long long lane, unsigned long long input) {
+    lane += input * HASH_PRIME_2;
+    lane = rotateLeft(lane, 31);
+    return lane * HASH_PRIME_1;
+}
+
+/**
+ * Folds a finished lane into the hash
+*/
+static inline unsigned long long mergeLane(unsigned long long hash, unsigned long long lane) {
+    hash ^= hashRound(0, lane);
+    return hash * HASH_PRIME_1 + HASH_PRIME_4;
+}
+
+/**
+ * Reads 8 little endian bytes. Hosts are assumed to be little endian
+*/
+static inline unsigned long long read64(const unsigned char* data) {
+    unsigned long long value;
+    memcpy(&value, data, 8);
+    return value;
+}
+
+/**
+ * Starts an XXH64 hash with the given seed
+*/
+void initHash(HashState* state, unsigned long long seed) {
+    memset(state, 0, sizeof(HashState));
+    state->seed = seed;
+    state->lanes[0] = seed + HASH_PRIME_1 + HASH_PRIME_2;
+    state->lanes[1] = seed + HASH_PRIME_2;
+    state->lanes[2] = seed;
+    state->lanes[3] = seed - HASH_PRIME_1;
+}
+
+/**
+ * Feeds data into a hash. Input is taken 32 bytes at a time, 8 to
+ * each lane, and the lanes don't depend on each other so they run side by side
+*/
+void updateHash(HashState* state, const void* data, size_t length) {
+    const unsigned char* input = data;
+    const unsigned char* end = input + length;
+    state->total += length;
+
+    // finish off a stripe left over from last time
+    if (state->buffered > 0) {
+        int take = 32 - state->buffered;
+        if ((size_t)take > length) take = (int)length;
+        memcpy(state->stripe + state->buffered, input, take);
+        state->buffered += take;
+        input += take;
+        if (state->buffered < 32) return;
+        for (int i = 0; i < 4; i++) state->lanes[i] = hashRound(state->lanes[i], read64(state->stripe + i * 8));
+        state->buffered = 0;
+    }
+
+    unsigned long long lane0 = state->lanes[0], lane1 = state->lanes[1];
+    unsigned long long lane2 = state->lanes[2], lane3 = state->lanes[3];
+    while (end - input >= 32) {
+        lane0 = hashRound(lane0, read64(input));
+        lane1 = hashRound(lane1, read64(input + 8));
+        lane2 = hashRound(lane2, read64(input + 16));
+        lane3 = hashRound(lane3, read64(input + 24));
+        input += 32;
+    }
+    state->lanes[0] = lane0;
+    state->lanes[1] = lane1;
+    state->lanes[2] = lane2;
+    state->lanes[3] = lane3;
+
+    memcpy(state->stripe, input, end - input);
+    state->buffered = (int)(end - input);
+}
+
+/**
+ * Finishes a hash and returns it
+*/
+unsigned long long finishHash(HashState* state) {
+    unsigned long long hash;
+    if (state->total >= 32) {
+        hash = rotateLeft(state->lanes[0], 1) + rotateLeft(state->lanes[1], 7) +
+            rotateLeft(state->lanes[2], 12) + rotateLeft(state->lanes[3], 18);
+        for (int i = 0; i < 4; i++) hash = mergeLane(hash, state->lanes[i]);
+    } else {
+        hash = state->seed + HASH_PRIME_5;
+    }
+    hash += state->total;
+
+    const unsigned char* input = state->stripe;
+    int left = state->buffered;
+    for (; left >= 8; left -= 8, input += 8) {
+        hash ^= hashRound(0, read64(input));
+        hash = rotateLeft(hash, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+    }
+    if (left >= 4) {
+        unsigned int word;
+        memcpy(&word, input, 4);
+        hash ^= (unsigned long long)word * HASH_PRIME_1;
+        hash = rotateLeft(hash, 23) * HASH_PRIME_2 + HASH_PRIME_3;
+        input += 4;
+        left -= 4;
+    }
+    for (; left > 0; left--, input++) {
+        hash ^= *input * HASH_PRIME_5;
+        hash = rotateLeft(hash, 11) * HASH_PRIME_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * Hashes a buffer in one go
+*/
+unsigned long long hashBytes(const void* data, size_t length, unsigned long long seed) {
+    HashState state;
+    initHash(&state, seed);
+    updateHash(&state, data, length);
+    return finishHash(&state);
+}
+
+/**
+ * Fills in the key for a file from its stat
+*/
+void makeHashKey(HashKey* key, struct stat* info) {
+    memset(key, 0, sizeof(HashKey));
+    key->device = info->st_dev;
+    key->inode = info->st_ino;
+    key->size = info->st_size;
+#ifdef _WIN32
+    key->modified = (long long)info->st_mtime * 1000000000LL;
+#else
+    key->modified = (long long)info->st_mtim.tv_sec * 1000000000LL + info->st_mtim.tv_nsec;
+#endif
+}
+
+/**
+ * Picks the bucket a path is kept in
+*/
+unsigned int hashPathBucket(const char* path) {
+    return (unsigned int)hashBytes(path, strlen(path), 0) % HASH_BUCKETS;
+}
+
+/**
+ * Finds the cached hash for a file's inode, whether or not it still
+ * matches the file. The cache must be locked
+*/
+HashEntry* findHash(HashCache* cache, HashKey* key) {
+    HashEntry* entry = cache->byInode[(key->inode ^ key->device) % HASH_BUCKETS];
+    while (entry != NULL && (entry->key.inode != key->inode || entry->key.device != key->device)) entry = entry->next;
+    return entry;
+}
+
+/**
+ * Takes an entry out of both indexes and frees it. The cache must be locked
+*/
+void unlinkHash(HashCache* cache, HashEntry* entry) {
+    HashEntry** link = &cache->byInode[(entry->key.inode ^ entry->key.device) % HASH_BUCKETS];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    link = &cache->byPath[hashPathBucket(entry->path)];
+    while (*link != entry) link = &(*link)->pathNext;
+    *link = entry->pathNext;
+    cache->count--;
+    free(entry->blockHashes);
+    free(entry->path);
+    free(entry);
+}
+
+/**
+ * Adds an entry to both indexes, replacing whatever was cached for the
+ * same inode. The cache must be locked
+*/
+void storeHash(HashCache* cache, HashEntry* entry) {
+    HashEntry* old = findHash(cache, &entry->key);
+    if (old != NULL) unlinkHash(cache, old);
+    unsigned int bucket = (entry->key.inode ^ entry->key.device) % HASH_BUCKETS;
+    entry->next = cache->byInode[bucket];
+    cache->byInode[bucket] = entry;
+    bucket = hashPathBucket(entry->path);
+    entry->pathNext = cache->byPath[bucket];
+    cache->byPath[bucket] = entry;
+    cache->count++;
+}
+
+/**
+ * Appends an entry to a sidecar file. Each record is the key and block
+ * count as varints, the hashes as 8 raw bytes each, then the path
+*/
+void writeHashRecord(FILE* file, HashEntry* entry) {
+    char record[64];
+    int used = 0;
+    used += putVarint(record + used, entry->key.device);
+    used += putVarint(record + used, entry->key.inode);
+    used += putVarint(record + used, entry->key.size);
+    used += putVarint(record + used, (unsigned long long)entry->key.modified);
+    used += putVarint(record + used, entry->blocks);
+    fwrite(record, 1, used, file);
+    fwrite(&entry->hash, sizeof(unsigned long long), 1, file);
+    if (entry->blocks > 0) fwrite(entry->blockHashes, sizeof(unsigned long long), entry->blocks, file);
+    int length = strlen(entry->path);
+    used = putVarint(record, length);
+    fwrite(record, 1, used, file);
+    fwrite(entry->path, 1, length, file);
+}
+
+/**
+ * Reads an entry back out of a sidecar file. Returns 1 if one was
+ * read, 0 at the end of the file and -1 if the record is cut short
+*/
+int readHashRecord(FILE* file, HashEntry* entry) {
+    unsigned long long modified, blocks, length;
+    memset(entry, 0, sizeof(HashEntry));
+    if (readVarint(file, &entry->key.device) != 0) return 0;
+    if (readVarint(file, &entry->key.inode) != 0 || readVarint(file, &entry->key.size) != 0 ||
+        readVarint(file, &modified) != 0 || readVarint(file, &blocks) != 0) return -1;
+    entry->key.modified = (long long)modified;
+    if (blocks != (entry->key.size + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE && blocks != 0) return -1;
+    entry->blocks = (int)blocks;
+    if (fread(&entry->hash, sizeof(unsigned long long), 1, file) != 1) return -1;
+    if (blocks > 0) {
+        entry->blockHashes = malloc(blocks * sizeof(unsigned long long));
+        if (fread(entry->blockHashes, sizeof(unsigned long long), blocks, file) != blocks) {
+            free(entry->blockHashes);
+            return -1;
+        }
+    }
+    if (readVarint(file, &length) != 0 || length > 65536) {
+        free(entry->blockHashes);
+        return -1;
+    }
+    entry->path = malloc(length + 1);
+    if (fread(entry->path, 1, length, file) != length) {
+        free(entry->blockHashes);
+        free(entry->path);
+        return -1;
+    }
+    entry->path[length] = '\0';
+    return 1;
+}
+
+/**
+ * Loads what was cached last time and writes it back out without the
+ * records that were replaced since, leaving the sidecar open for appending
+*/
+void loadHashCache(HashCache* cache, const char* sidecar) {
+    FILE* file = fopen(sidecar, "rb");
+    if (file != NULL) {
+        char header[5];
+        if (fread(header, 1, sizeof(header), file) == sizeof(header) &&
+            memcmp(header, HASH_CACHE_MAGIC, 4) == 0 && header[4] == HASH_CACHE_VERSION) {
+            HashEntry record;
+            while (readHashRecord(file, &record) == 1) {
+                HashEntry* entry = malloc(sizeof(HashEntry));
+                *entry = record;
+                storeHash(cache, entry);
+            }
+        }
+        fclose(file);
+    }
+
+    cache->sidecar = fopen(sidecar, "wb");
+    if (cache->sidecar == NULL) return;
+    char header[5] = HASH_CACHE_MAGIC;
+    header[4] = HASH_CACHE_VERSION;
+    fwrite(header, 1, sizeof(header), cache->sidecar);
+    for (int i = 0; i < HASH_BUCKETS; i++)
+        for (HashEntry* entry = cache->byInode[i]; entry != NULL; entry = entry->next)
+            writeHashRecord(cache->sidecar, entry);
+    fflush(cache->sidecar);
+}
+
+/**
+ * Loads the sidecar and starts the given number of workers, which hand
+ * every result to finished. Returns 0 on success
+*/
+int initHashCache(HashCache* cache, const char* sidecar, int workers, HashFinished finished) {
+    memset(cache, 0, sizeof(HashCache));
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->ready, NULL);
+    pthread_cond_init(&cache->done, NULL);
+    cache->finished = finished;
+    loadHashCache(cache, sidecar);
+    if (workers > HASH_MAX_WORKERS) workers = HASH_MAX_WORKERS;
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&cache->workers[i], NULL, hashWorker, cache) != 0) return -1;
+        cache->workerCount++;
+    }
+    return 0;
+}
+
+/**
+ * Looks up a file's hash. Returns 1 and fills in the result if a hash for
+ * exactly this version of the file is cached, or 0 if it needs hashing
+*/
+int lookupHash(HashCache* cache, HashKey* key, int wantBlocks, HashResult* result) {
+    memset(result, 0, sizeof(HashResult));
+    pthread_mutex_lock(&cache->lock);
+    HashEntry* entry = findHash(cache, key);
+    if (entry == NULL || memcmp(&entry->key, key, sizeof(HashKey)) != 0) {
+        cache->misses++;
+        pthread_mutex_unlock(&cache->lock);
+        return 0;
+    }
+    cache->hits++;
+    result->hash = entry->hash;
+    result->size = entry->key.size;
+    result->cached = 1;
+    if (wantBlocks && entry->blocks > 0) {
+        result->blocks = entry->blocks;
+        result->blockHashes = malloc(entry->blocks * sizeof(unsigned long long));
+        memcpy(result->blockHashes, entry->blockHashes, entry->blocks * sizeof(unsigned long long));
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return 1;
+}
+
+/**
+ * Queues a file to be hashed by a worker. The cache takes the request
+*/
+void requestHash(HashCache* cache, HashRequest* request) {
+    request->next = NULL;
+    pthread_mutex_lock(&cache->lock);
+    if (cache->tail != NULL) cache->tail->next = request;
+    else cache->head = request;
+    cache->tail = request;
+    pthread_cond_signal(&cache->ready);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Drops the cached hashes for a path, or for everything at or below it
+ * when tree is set. An empty path with tree set drops everything
+*/
+void invalidateHashes(HashCache* cache, const char* path, int tree) {
+    int length = strlen(path);
+    pthread_mutex_lock(&cache->lock);
+    if (!tree) {
+        HashEntry* entry = cache->byPath[hashPathBucket(path)];
+        while (entry != NULL && strcmp(entry->path, path) != 0) entry = entry->pathNext;
+        if (entry != NULL) {
+            unlinkHash(cache, entry);
+            cache->invalidated++;
+        }
+    } else {
+        for (int i = 0; i < HASH_BUCKETS; i++) {
+            HashEntry* entry = cache->byInode[i];
+            while (entry != NULL) {
+                HashEntry* next = entry->next;
+                if (length == 0 || (strncmp(entry->path, path, length) == 0 &&
+                    (entry->path[length] == '\0' || entry->path[length] == '/'))) {
+                    unlinkHash(cache, entry);
+                    cache->invalidated++;
+                }
+                entry = next;
+            }
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Reads a whole file through the hash, a block at a time, hashing
+ * each block on its own too when blockHashes isn't NULL. Returns 0 on success
+*/
+int hashFile(int fd, unsigned long long size, unsigned long long* hash, unsigned long long* blockHashes) {
+    char* buffer = malloc(HASH_BLOCK_SIZE);
+    if (buffer == NULL) return -1;
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    HashState state;
+    initHash(&state, 0);
+    unsigned long long offset = 0;
+    int block = 0;
+    while (offset < size) {
+        // fill a whole block so block hashes always line up with block boundaries
+        int filled = 0;
+        int want = size - offset < HASH_BLOCK_SIZE ? (int)(size - offset) : HASH_BLOCK_SIZE;
+        while (filled < want) {
+#ifdef _WIN32
+            int got = read(fd, buffer + filled, want - filled);
+#else
+            int got = pread(fd, buffer + filled, want - filled, offset + filled);
+#endif
+            if (got <= 0) {
+                free(buffer);
+                return -1;
+            }
+            filled += got;
+        }
+        updateHash(&state, buffer, filled);
+        if (blockHashes != NULL) blockHashes[block] = hashBytes(buffer, filled, 0);
+        block++;
+        offset += filled;
+    }
+    free(buffer);
+    *hash = finishHash(&state);
+    return 0;
+}
+
+/**
+ * Gets the hash of an open file, reading it only if no hash of this
+ * version of it is cached. If another thread is already hashing the same
+ * file, its result is waited for instead. The hash is cached and appended
+ * to the sidecar. Returns 0 on success
+*/
+int cacheFile(HashCache* cache, int fd, const char* path, HashKey* key, int wantBlocks, HashResult* result) {
+    memset(result, 0, sizeof(HashResult));
+    pthread_mutex_lock(&cache->lock);
+    int busy = 1;
+    while (busy) {
+        busy = 0;
+        for (int i = 0; i < cache->busyCount; i++)
+            if (memcmp(&cache->busy[i], key, sizeof(HashKey)) == 0) busy = 1;
+        if (busy) pthread_cond_wait(&cache->done, &cache->lock);
+    }
+    HashEntry* cached = findHash(cache, key);
+    int hit = cached != NULL && memcmp(&cached->key, key, sizeof(HashKey)) == 0;
+    if (hit || cache->busyCount == HASH_MAX_BUSY) {
+        // if too many files are being hashed at once to keep track of
+        // another, or the hash was dropped just now, it's hashed uncached
+        pthread_mutex_unlock(&cache->lock);
+        if (hit && lookupHash(cache, key, wantBlocks, result)) return 0;
+        result->size = key->size;
+        return hashFile(fd, key->size, &result->hash, NULL);
+    }
+    cache->busy[cache->busyCount++] = *key;
+    pthread_mutex_unlock(&cache->lock);
+
+    HashEntry* entry = calloc(1, sizeof(HashEntry));
+    entry->key = *key;
+    entry->path = strdup(path);
+    entry->blocks = key->size > HASH_BLOCK_SIZE ? (int)((key->size + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE) : 0;
+    if (entry->blocks > 0) entry->blockHashes = malloc(entry->blocks * sizeof(unsigned long long));
+    int failed = hashFile(fd, key->size, &entry->hash, entry->blockHashes);
+
+    // a file that changed while it was read can't be trusted
+    struct stat after;
+    HashKey check;
+    if (!failed && fstat(fd, &after) == 0) {
+        makeHashKey(&check, &after);
+        failed = memcmp(&check, key, sizeof(HashKey)) != 0;
+    }
+
+    result->hash = entry->hash;
+    result->size = key->size;
+    if (!failed && wantBlocks && entry->blocks > 0) {
+        result->blocks = entry->blocks;
+        result->blockHashes = malloc(entry->blocks * sizeof(unsigned long long));
+        memcpy(result->blockHashes, entry->blockHashes, entry->blocks * sizeof(unsigned long long));
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    for (int i = 0; i < cache->busyCount; i++) {
+        if (memcmp(&cache->busy[i], key, sizeof(HashKey)) != 0) continue;
+        cache->busy[i] = cache->busy[--cache->busyCount];
+        break;
+    }
+    if (!failed) {
+        storeHash(cache, entry);
+        cache->hashed += key->size;
+        if (cache->sidecar != NULL) {
+            writeHashRecord(cache->sidecar, entry);
+            fflush(cache->sidecar);
+        }
+    }
+    pthread_cond_broadcast(&cache->done);
+    pthread_mutex_unlock(&cache->lock);
+    if (failed) {
+        free(entry->blockHashes);
+        free(entry->path);
+        free(entry);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Worker thread. Takes requests off the queue and hands back
+ * the hash of each of their files
+*/
+void* hashWorker(void* arg) {
+    HashCache* cache = arg;
+    while (1) {
+        pthread_mutex_lock(&cache->lock);
+        while (cache->head == NULL) pthread_cond_wait(&cache->ready, &cache->lock);
+        HashRequest* request = cache->head;
+        cache->head = request->next;
+        if (cache->head == NULL) cache->tail = NULL;
+        pthread_mutex_unlock(&cache->lock);
+
+        HashResult result;
+        struct stat info;
+        HashKey key;
+        if (fstat(request->fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            memset(&result, 0, sizeof(HashResult));
+            result.error = 1;
+        } else {
+            makeHashKey(&key, &info);
+            result.error = cacheFile(cache, request->fd, request->path, &key, request->wantBlocks, &result) != 0;
+        }
+        cache->finished(request, &result);
+    }
+    return NULL;
+}
+
+#endif
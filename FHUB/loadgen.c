@@ -0,0 +1,258 @@
+/**
+ * loadgen.c - drives a server with many clients at once to measure how
+ * much traffic it can push through. chat mode floods the server with chat
+ * messages and counts the broadcasts coming back. getdir mode has every
+ * client download a directory over and over. --local connects every
+ * client through shared memory instead of tcp
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+// defines
+#define DEFAULT_CLIENTS       8
+#define DEFAULT_SECONDS       5
+#define MAX_CLIENTS           64
+#define CHAT_TEXT             "loadgen>the quick brown fox jumps over the lazy dog"
+#define TRUE                  1
+#define FALSE                 0
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// custom includes
+#include "utils.h"
+#include "protocol.h"
+#include "locallink.h"
+
+// one connection to the server and what has gone over it
+typedef struct {
+    int        socket;
+    pthread_t  sender;
+    pthread_t  receiver;
+    long long  framesSent;
+    long long  framesReceived;
+    long long  bytesReceived;
+    long long  archives;
+#ifdef __linux__
+    LocalLink  link;
+#endif
+} Client;
+
+// global variables
+Client g_loadClients[MAX_CLIENTS]      = { 0 };
+char   g_directory[256]                = { 0 };
+int    g_getdir                        =   0  ;
+int    g_stop                          =   0  ;
+int    g_local                         =   0  ;
+
+// function declarations
+int    connectClient(const char* host, int port);
+void*  sendChats(void* arg);
+void*  receiveFrames(void* arg);
+void*  fetchDirectories(void* arg);
+int    sendTo(Client* client, char type, const char* payload, unsigned int length);
+int    receiveFrom(Client* client, char* buffer, int size);
+
+/**
+ * Main function that handles program flow. Usage is
+ * loadgen [--local] <port> [clients] [seconds] [chat | getdir <dir>]
+*/
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--local") == 0) {
+        g_local = TRUE;
+        argv++;
+        argc--;
+    }
+    if (argc < 2) {
+        printf("usage: loadgen [--local] <port> [clients] [seconds] [chat | getdir <dir>]\n");
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int clients = argc > 2 ? atoi(argv[2]) : DEFAULT_CLIENTS;
+    int seconds = argc > 3 ? atoi(argv[3]) : DEFAULT_SECONDS;
+    if (clients < 1) clients = 1;
+    if (clients > MAX_CLIENTS) clients = MAX_CLIENTS;
+    if (argc > 5 && strcmp(argv[4], "getdir") == 0) {
+        g_getdir = TRUE;
+        snprintf(g_directory, sizeof(g_directory), "%s", argv[5]);
+    }
+
+    for (int i = 0; i < clients; i++) {
+#ifdef __linux__
+        if (g_local) g_loadClients[i].socket = connectLocal(port, &g_loadClients[i].link) == 0 ? g_loadClients[i].link.socket : -1;
+        else
+#endif
+        g_loadClients[i].socket = connectClient("127.0.0.1", port);
+        if (g_loadClients[i].socket < 0) {
+            setTextColor(RED);
+            printf("ERROR   >> could not connect client %d\n", i);
+            resetText();
+            return 2;
+        }
+    }
+
+    long long start = getTimeMicros();
+    for (int i = 0; i < clients; i++) {
+        if (g_getdir) pthread_create(&g_loadClients[i].sender, NULL, fetchDirectories, &g_loadClients[i]);
+        else {
+            pthread_create(&g_loadClients[i].sender, NULL, sendChats, &g_loadClients[i]);
+            pthread_create(&g_loadClients[i].receiver, NULL, receiveFrames, &g_loadClients[i]);
+        }
+    }
+    sleepMicros(seconds * 1000000LL);
+    __atomic_store_n(&g_stop, TRUE, __ATOMIC_RELEASE);
+    for (int i = 0; i < clients; i++) {
+        pthread_join(g_loadClients[i].sender, NULL);
+        if (!g_getdir) {
+            shutdown(g_loadClients[i].socket, SHUT_RD);
+            pthread_join(g_loadClients[i].receiver, NULL);
+        }
+    }
+    double elapsed = (getTimeMicros() - start) / 1000000.0;
+
+    long long sent = 0, received = 0, bytes = 0, archives = 0;
+    for (int i = 0; i < clients; i++) {
+        sent     += g_loadClients[i].framesSent;
+        received += g_loadClients[i].framesReceived;
+        bytes    += g_loadClients[i].bytesReceived;
+        archives += g_loadClients[i].archives;
+    }
+    printf("clients: %d\n", clients);
+    printf("seconds: %.3f\n", elapsed);
+    printf("frames sent: %lld (%.0f per second)\n", sent, sent / elapsed);
+    printf("frames received: %lld (%.0f per second)\n", received, received / elapsed);
+    printf("bytes received: %lld (%.2f MB/s)\n", bytes, bytes / elapsed / 1000000.0);
+    if (g_getdir) printf("directories fetched: %lld\n", archives);
+
+    // results are in, but the connections stay up until we're told to go
+    // so the server's counters can be read while the clients still exist
+    printf("done\n");
+    fflush(stdout);
+    char line[16];
+    if (fgets(line, sizeof(line), stdin) == NULL) {}
+    for (int i = 0; i < clients; i++) close(g_loadClients[i].socket);
+    return 0;
+}
+
+/**
+ * Opens a connection to the server. Returns the socket or -1
+*/
+int connectClient(const char* host, int port) {
+    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (socket_fd < 0) return -1;
+    struct sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, host, &address.sin_addr);
+    if (connect(socket_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(socket_fd);
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    return socket_fd;
+}
+
+/**
+ * Sender thread for chat mode. Sends chat messages as fast as the
+ * socket will take them
+*/
+void* sendChats(void* arg) {
+    Client* client = arg;
+    while (!__atomic_load_n(&g_stop, __ATOMIC_ACQUIRE)) {
+        if (sendTo(client, 'c', CHAT_TEXT, strlen(CHAT_TEXT)) != 0) break;
+        client->framesSent++;
+    }
+    return NULL;
+}
+
+/**
+ * Receiver thread for chat mode. Counts every frame broadcast back
+*/
+void* receiveFrames(void* arg) {
+    Client* client = arg;
+    FrameReader* reader = calloc(1, sizeof(FrameReader));
+    while (1) {
+        int available;
+        char* space = readerSpace(reader, &available);
+        int received = receiveFrom(client, space, available);
+        if (received <= 0) break;
+        readerCommit(reader, received);
+        client->bytesReceived += received;
+        char type;
+        char* payload;
+        unsigned int length;
+        while (nextFrame(reader, &type, &payload, &length) == TRUE)
+            client->framesReceived++;
+    }
+    free(reader);
+    return NULL;
+}
+
+/**
+ * Client thread for getdir mode. Asks for the directory and reads the whole
+ * archive back before asking again
+*/
+void* fetchDirectories(void* arg) {
+    Client* client = arg;
+    FrameReader* reader = calloc(1, sizeof(FrameReader));
+    char command[300];
+    snprintf(command, sizeof(command), "getdir %s", g_directory);
+    while (!__atomic_load_n(&g_stop, __ATOMIC_ACQUIRE)) {
+        if (sendTo(client, 'm', command, strlen(command)) != 0) break;
+        client->framesSent++;
+        int finished = FALSE;
+        while (!finished) {
+            int available;
+            char* space = readerSpace(reader, &available);
+            int received = receiveFrom(client, space, available);
+            if (received <= 0) {
+                free(reader);
+                return NULL;
+            }
+            readerCommit(reader, received);
+            client->bytesReceived += received;
+            char type;
+            char* payload;
+            unsigned int length;
+            while (nextFrame(reader, &type, &payload, &length) == TRUE) {
+                client->framesReceived++;
+                if (type == 'e' || type == 'r') finished = TRUE;
+            }
+        }
+        client->archives++;
+    }
+    free(reader);
+    return NULL;
+}
+
+/**
+ * Sends a frame over whichever transport the client is using.
+ * Returns 0 on success
+*/
+int sendTo(Client* client, char type, const char* payload, unsigned int length) {
+#ifdef __linux__
+    if (g_local) return sendLinkFrame(&client->link, type, payload, length);
+#endif
+    return sendFrame(client->socket, type, payload, length);
+}
+
+/**
+ * Receives up to size bytes over whichever transport the client is
+ * using. Returns the number of bytes, or 0 or less once it's closed
+*/
+int receiveFrom(Client* client, char* buffer, int size) {
+#ifdef __linux__
+    if (g_local) return readLink(&client->link, buffer, size);
+#endif
+    return recv(client->socket, buffer, size, 0);
+}
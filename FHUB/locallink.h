@@ -0,0 +1,387 @@
+/**
+ * locallink.h - a transport for clients on the same machine as the server.
+ * the client connects over a unix socket, and gets back shared memory
+ * holding a ring for each direction along with eventfds to wake whoever is
+ * waiting on one. frames then go through the rings exactly as they would
+ * over tcp, and the unix socket is only kept to notice the other side leave
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef LOCALLINK_H
+#define LOCALLINK_H
+
+#ifdef __linux__
+
+// defines
+#define LINK_RING_SIZE        (1 << 20)
+#define LINK_MAGIC            0x4C484846
+#define LINK_NAME             "fhub.%d"
+#define LINK_HANDLES          5
+
+// includes
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include "protocol.h"
+#include "outqueue.h"
+
+// one direction of a link. only the writer moves tail and only the reader
+// moves head, and each says when it's asleep so the other knows to wake it
+typedef struct {
+    unsigned long long head;
+    char               headPadding[56];
+    unsigned long long tail;
+    char               tailPadding[56];
+    int                readerWaiting;
+    int                writerWaiting;
+    char               waitPadding[56];
+    char               data[LINK_RING_SIZE];
+} LinkRing;
+
+// the memory shared by both ends of a link
+typedef struct {
+    unsigned int       magic;
+    unsigned int       size;
+    LinkRing           toServer;
+    LinkRing           toClient;
+} LinkShared;
+
+// one end of a link. arrived is signalled when data lands in the ring
+// coming in and freed when room opens up in the ring going out, and the
+// other end's versions of the two are signalled to wake it
+typedef struct {
+    int                socket;
+    LinkShared*        shared;
+    LinkRing*          in;
+    LinkRing*          out;
+    int                arrived;
+    int                freed;
+    int                wakeReader;
+    int                wakeWriter;
+    long long          wakeups;
+} LocalLink;
+
+// function declarations
+int        listenLocal(int port);
+int        acceptLocal(int listener, LocalLink* link);
+int        connectLocal(int port, LocalLink* link);
+void       closeLink(LocalLink* link);
+void       attachLink(LocalLink* link, int* handles, int server);
+int        nameLocal(int port, struct sockaddr_un* address);
+int        waitLink(LocalLink* link, int handle);
+void       wakeLink(LocalLink* link, int handle);
+int        readLink(LocalLink* link, char* buffer, int size);
+long long  writeLink(LocalLink* link, IoVector* vectors, int count);
+int        sendLinkFrame(LocalLink* link, char type, const char* payload, unsigned int length);
+int        flushLink(OutQueue* queue, LocalLink* link, long long* calls);
+
+/**
+ * Fills in the address a server on the given port takes local clients
+ * on. It's in the abstract namespace, so nothing is left on disk.
+ * Returns the length of the address
+*/
+int nameLocal(int port, struct sockaddr_un* address) {
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    int length = snprintf(address->sun_path + 1, sizeof(address->sun_path) - 1, LINK_NAME, port);
+    return (int)(offsetof(struct sockaddr_un, sun_path) + 1 + length);
+}
+
+/**
+ * Starts listening for local clients of a server on the given port.
+ * Returns the listening socket, or -1 if it couldn't be made
+*/
+int listenLocal(int port) {
+    struct sockaddr_un address;
+    int length = nameLocal(port, &address);
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) return -1;
+    if (bind(listener, (struct sockaddr*)&address, length) != 0 || listen(listener, 16) != 0) {
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+/**
+ * Points an end of a link at its half of the shared memory and the
+ * eventfds, which are the memory and then arrived and freed for the
+ * ring to the server followed by the same for the ring to the client
+*/
+void attachLink(LocalLink* link, int* handles, int server) {
+    link->in = server ? &link->shared->toServer : &link->shared->toClient;
+    link->out = server ? &link->shared->toClient : &link->shared->toServer;
+    link->arrived = handles[server ? 1 : 3];
+    link->freed = handles[server ? 4 : 2];
+    link->wakeReader = handles[server ? 3 : 1];
+    link->wakeWriter = handles[server ? 2 : 4];
+    link->wakeups = 0;
+}
+
+/**
+ * Accepts a local client and sets up a link to it, sending it the shared
+ * memory and eventfds over the unix socket. Returns 0 on success
+*/
+int acceptLocal(int listener, LocalLink* link) {
+    memset(link, 0, sizeof(LocalLink));
+    link->socket = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+    if (link->socket < 0) return -1;
+
+    int handles[LINK_HANDLES] = { -1, -1, -1, -1, -1 };
+    int failed = (handles[0] = memfd_create("fhub-link", MFD_CLOEXEC)) < 0 ||
+        ftruncate(handles[0], sizeof(LinkShared)) != 0;
+    for (int i = 1; i < LINK_HANDLES && !failed; i++)
+        failed = (handles[i] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0;
+    if (!failed) {
+        link->shared = mmap(NULL, sizeof(LinkShared), PROT_READ | PROT_WRITE, MAP_SHARED, handles[0], 0);
+        failed = link->shared == MAP_FAILED;
+        if (failed) link->shared = NULL;
+    }
+    if (!failed) {
+        link->shared->magic = LINK_MAGIC;
+        link->shared->size = LINK_RING_SIZE;
+
+        // the handles go out as ancillary data on a single byte
+        char byte = 0;
+        struct iovec vector = { &byte, 1 };
+        struct msghdr message = { 0 };
+        char control[CMSG_SPACE(sizeof(handles))];
+        memset(control, 0, sizeof(control));
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(handles));
+        memcpy(CMSG_DATA(header), handles, sizeof(handles));
+        failed = sendmsg(link->socket, &message, MSG_NOSIGNAL) != 1;
+    }
+
+    // the memory stays mapped without its handle
+    if (handles[0] >= 0) close(handles[0]);
+    if (failed) {
+        for (int i = 1; i < LINK_HANDLES; i++)
+            if (handles[i] >= 0) close(handles[i]);
+        if (link->shared != NULL) munmap(link->shared, sizeof(LinkShared));
+        close(link->socket);
+        memset(link, 0, sizeof(LocalLink));
+        return -1;
+    }
+    attachLink(link, handles, 1);
+    return 0;
+}
+
+/**
+ * Connects to a server on this machine and sets up a link to it. Returns
+ * 0 on success, or -1 if there's no server taking local clients on the port
+*/
+int connectLocal(int port, LocalLink* link) {
+    memset(link, 0, sizeof(LocalLink));
+    struct sockaddr_un address;
+    int length = nameLocal(port, &address);
+    link->socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (link->socket < 0) return -1;
+    if (connect(link->socket, (struct sockaddr*)&address, length) != 0) {
+        close(link->socket);
+        return -1;
+    }
+
+    int handles[LINK_HANDLES];
+    char byte;
+    struct iovec vector = { &byte, 1 };
+    struct msghdr message = { 0 };
+    char control[CMSG_SPACE(sizeof(handles))];
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t received;
+    do received = recvmsg(link->socket, &message, MSG_CMSG_CLOEXEC);
+    while (received < 0 && errno == EINTR);
+    struct cmsghdr* header = received == 1 ? CMSG_FIRSTHDR(&message) : NULL;
+    if (header == NULL || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(handles))) {
+        close(link->socket);
+        return -1;
+    }
+    memcpy(handles, CMSG_DATA(header), sizeof(handles));
+    link->shared = mmap(NULL, sizeof(LinkShared), PROT_READ | PROT_WRITE, MAP_SHARED, handles[0], 0);
+    close(handles[0]);
+    if (link->shared == MAP_FAILED || link->shared->magic != LINK_MAGIC || link->shared->size != LINK_RING_SIZE) {
+        if (link->shared != MAP_FAILED) munmap(link->shared, sizeof(LinkShared));
+        for (int i = 1; i < LINK_HANDLES; i++) close(handles[i]);
+        close(link->socket);
+        memset(link, 0, sizeof(LocalLink));
+        return -1;
+    }
+    attachLink(link, handles, 0);
+    return 0;
+}
+
+/**
+ * Lets go of the shared memory and eventfds. The unix socket is left to
+ * whoever owns the link, since the server knows the client by it
+*/
+void closeLink(LocalLink* link) {
+    if (link->shared == NULL) return;
+    munmap(link->shared, sizeof(LinkShared));
+    link->shared = NULL;
+    close(link->arrived);
+    close(link->freed);
+    close(link->wakeReader);
+    close(link->wakeWriter);
+}
+
+/**
+ * Sleeps until the given eventfd is signalled. Nothing is ever sent on
+ * the unix socket once the link is up, so it only turns readable when the
+ * other end goes away. Returns 1 when woken, 0 once the other end is
+ * gone, or -1 if a signal interrupted the wait
+*/
+int waitLink(LocalLink* link, int handle) {
+    struct pollfd polled[2] = { { handle, POLLIN, 0 }, { link->socket, POLLIN, 0 } };
+    if (poll(polled, 2, -1) < 0) return errno == EINTR ? -1 : 0;
+    if (polled[0].revents & POLLIN) {
+        unsigned long long count;
+        if (read(handle, &count, sizeof(count))) {}
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Signals an eventfd to wake the other end of the link
+*/
+void wakeLink(LocalLink* link, int handle) {
+    unsigned long long one = 1;
+    if (write(handle, &one, sizeof(one))) {}
+    link->wakeups++;
+}
+
+/**
+ * Reads whatever has arrived, up to size bytes, sleeping until something
+ * does. Returns the number of bytes read, 0 once the other end is gone
+ * and everything it sent has been read, or -1 if a signal interrupted it
+*/
+int readLink(LocalLink* link, char* buffer, int size) {
+    LinkRing* ring = link->in;
+    unsigned long long head = ring->head;
+    while (1) {
+        unsigned long long tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (tail != head) {
+            int length = tail - head < (unsigned long long)size ? (int)(tail - head) : size;
+            int offset = head % LINK_RING_SIZE;
+            int first = LINK_RING_SIZE - offset < length ? LINK_RING_SIZE - offset : length;
+            memcpy(buffer, ring->data + offset, first);
+            memcpy(buffer + first, ring->data, length - first);
+            __atomic_store_n(&ring->head, head + length, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&ring->writerWaiting, __ATOMIC_SEQ_CST)) wakeLink(link, link->wakeWriter);
+            return length;
+        }
+
+        // say we're going to sleep, then look once more so a write that
+        // landed in between isn't slept through
+        __atomic_store_n(&ring->readerWaiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == head) {
+            int woken = waitLink(link, link->arrived);
+            if (woken <= 0 && __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+                __atomic_store_n(&ring->readerWaiting, 0, __ATOMIC_SEQ_CST);
+                return woken;
+            }
+        }
+        __atomic_store_n(&ring->readerWaiting, 0, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * Writes all of the given buffers into the ring going out, sleeping
+ * whenever it fills up until the other end makes room. The other end
+ * is only woken if it's asleep. Returns the number of bytes written,
+ * or -1 once the other end is gone
+*/
+long long writeLink(LocalLink* link, IoVector* vectors, int count) {
+    LinkRing* ring = link->out;
+    unsigned long long tail = ring->tail;
+    long long total = 0;
+    for (int i = 0; i < count; i++) {
+        const char* data = vectors[i].iov_base;
+        long long left = vectors[i].iov_len;
+        while (left > 0) {
+            unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            long long room = LINK_RING_SIZE - (long long)(tail - head);
+            if (room > 0) {
+                int length = left < room ? (int)left : (int)room;
+                int offset = tail % LINK_RING_SIZE;
+                int first = LINK_RING_SIZE - offset < length ? LINK_RING_SIZE - offset : length;
+                memcpy(ring->data + offset, data, first);
+                memcpy(ring->data, data + first, length - first);
+                tail += length;
+                data += length;
+                left -= length;
+                total += length;
+                __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+                continue;
+            }
+
+            // the ring is full, so let the reader at what's there and
+            // sleep until it makes room
+            __atomic_store_n(&ring->writerWaiting, 1, __ATOMIC_SEQ_CST);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&ring->readerWaiting, __ATOMIC_SEQ_CST)) wakeLink(link, link->wakeReader);
+            if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == head && waitLink(link, link->freed) == 0) {
+                __atomic_store_n(&ring->writerWaiting, 0, __ATOMIC_SEQ_CST);
+                return -1;
+            }
+            __atomic_store_n(&ring->writerWaiting, 0, __ATOMIC_SEQ_CST);
+        }
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->readerWaiting, __ATOMIC_SEQ_CST)) wakeLink(link, link->wakeReader);
+    return total;
+}
+
+/**
+ * Writes a single frame into the link. Returns 0 on success
+*/
+int sendLinkFrame(LocalLink* link, char type, const char* payload, unsigned int length) {
+    char header[HEADER_SIZE];
+    writeHeader(header, type, length);
+    IoVector vectors[2] = { { header, HEADER_SIZE }, { (char*)payload, length } };
+    return writeLink(link, vectors, length > 0 ? 2 : 1) < 0 ? -1 : 0;
+}
+
+/**
+ * Writes every queued packet into the link, like flushQueue does for a
+ * socket. The only calls made are wakeups, which are added to calls
+*/
+int flushLink(OutQueue* queue, LocalLink* link, long long* calls) {
+    int sent = 0;
+    long long wakeups = link->wakeups;
+    while (queue->count > 0) {
+        IoVector vectors[FLUSH_VECTORS];
+        int count = fillVectors(queue, vectors, FLUSH_VECTORS);
+        if (link->shared == NULL || writeLink(link, vectors, count) < 0) {
+            clearQueue(queue);
+            sent = -1;
+            break;
+        }
+        dropSent(queue, count);
+        sent += count;
+    }
+    queue->head = 0;
+    *calls += link->wakeups - wakeups;
+    return sent;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,263 @@
+/**
+ * manifest.h - manifests of hosted directories, used to keep a mirror of
+ * one in sync. an entry is a file's path, size, modification time and
+ * content hash, and the client keeps the last manifest it synced against
+ * along with what each file looked like locally once it arrived
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+// defines
+#define MANIFEST_MAGIC        "FHSY"
+#define MANIFEST_VERSION      1
+#define MANIFEST_PATH_SIZE    4096
+#define MANIFEST_RECORD_MAX   (48 + MANIFEST_PATH_SIZE)
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "hashcache.h"
+#include "tarstream.h"
+
+// a file in a manifest. the local fields are only used by the client and
+// hold what the file looked like on disk after it was last synced
+typedef struct {
+    char*              path;
+    unsigned long long size;
+    long long          modified;
+    unsigned long long hash;
+    unsigned long long localSize;
+    long long          localModified;
+} ManifestEntry;
+
+// every file in a directory, with a table for finding them by path. the
+// digest is a hash of the entries as they were sent, which changes
+// whenever any file is added, removed or changed
+typedef struct {
+    ManifestEntry*     entries;
+    int                count;
+    int                size;
+    int*               table;
+    int                tableSize;
+    unsigned long long digest;
+    char               remote[MANIFEST_PATH_SIZE];
+} Manifest;
+
+// function declarations
+int    putManifestEntry(char* out, const char* path, unsigned long long size, long long modified, unsigned long long hash);
+int    getManifestEntry(const char* in, int length, ManifestEntry* entry, char* path);
+int    getBoundedVarint(const char* in, int length, unsigned long long* value);
+void   initManifest(Manifest* manifest);
+void   clearManifest(Manifest* manifest);
+ManifestEntry* addManifestEntry(Manifest* manifest, ManifestEntry* entry);
+void   placeManifestEntry(Manifest* manifest, int index);
+ManifestEntry* findManifestEntry(Manifest* manifest, const char* path);
+int    loadManifest(Manifest* manifest, const char* file);
+int    saveManifest(Manifest* manifest, const char* file);
+
+/**
+ * Encodes an entry as the size, modification time and path length as
+ * varints, the hash as 8 raw bytes and then the path. Returns the number
+ * of bytes written, which is never more than MANIFEST_RECORD_MAX
+*/
+int putManifestEntry(char* out, const char* path, unsigned long long size, long long modified, unsigned long long hash) {
+    int length = strlen(path);
+    if (length >= MANIFEST_PATH_SIZE) return 0;
+    int used = 0;
+    used += putVarint(out + used, size);
+    used += putVarint(out + used, (unsigned long long)modified);
+    memcpy(out + used, &hash, sizeof(unsigned long long));
+    used += sizeof(unsigned long long);
+    used += putVarint(out + used, length);
+    memcpy(out + used, path, length);
+    return used + length;
+}
+
+/**
+ * Reads a varint that has to end before the given length. Returns
+ * the number of bytes read, or -1 if it runs past the end
+*/
+int getBoundedVarint(const char* in, int length, unsigned long long* value) {
+    int end = 0;
+    while (end < length && end < 10 && (in[end] & 0x80)) end++;
+    if (end >= length || end == 10) return -1;
+    return getVarint(in, value);
+}
+
+/**
+ * Decodes an entry written by putManifestEntry, with its path copied into
+ * path. Returns the number of bytes read, or -1 if the entry is cut short
+*/
+int getManifestEntry(const char* in, int length, ManifestEntry* entry, char* path) {
+    unsigned long long modified, pathLength;
+    int used = 0, read;
+    memset(entry, 0, sizeof(ManifestEntry));
+    if ((read = getBoundedVarint(in, length, &entry->size)) < 0) return -1;
+    used += read;
+    if ((read = getBoundedVarint(in + used, length - used, &modified)) < 0) return -1;
+    used += read;
+    entry->modified = (long long)modified;
+    if (used + (int)sizeof(unsigned long long) > length) return -1;
+    memcpy(&entry->hash, in + used, sizeof(unsigned long long));
+    used += sizeof(unsigned long long);
+    if ((read = getBoundedVarint(in + used, length - used, &pathLength)) < 0) return -1;
+    used += read;
+    if (pathLength == 0 || pathLength >= MANIFEST_PATH_SIZE || pathLength > (unsigned long long)(length - used)) return -1;
+    memcpy(path, in + used, pathLength);
+    path[pathLength] = '\0';
+    entry->path = path;
+    return used + (int)pathLength;
+}
+
+/**
+ * Starts an empty manifest
+*/
+void initManifest(Manifest* manifest) {
+    memset(manifest, 0, sizeof(Manifest));
+}
+
+/**
+ * Frees every entry and empties the manifest
+*/
+void clearManifest(Manifest* manifest) {
+    for (int i = 0; i < manifest->count; i++) free(manifest->entries[i].path);
+    free(manifest->entries);
+    free(manifest->table);
+    initManifest(manifest);
+}
+
+/**
+ * Finds the entry for a path, or NULL if there is none
+*/
+ManifestEntry* findManifestEntry(Manifest* manifest, const char* path) {
+    if (manifest->tableSize == 0) return NULL;
+    unsigned int mask = manifest->tableSize - 1;
+    unsigned int slot = (unsigned int)hashBytes(path, strlen(path), 0) & mask;
+    while (manifest->table[slot] >= 0) {
+        ManifestEntry* entry = &manifest->entries[manifest->table[slot]];
+        if (strcmp(entry->path, path) == 0) return entry;
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+/**
+ * Puts an entry into the first free slot of the table after its path's
+*/
+void placeManifestEntry(Manifest* manifest, int index) {
+    char* path = manifest->entries[index].path;
+    unsigned int mask = manifest->tableSize - 1;
+    unsigned int slot = (unsigned int)hashBytes(path, strlen(path), 0) & mask;
+    while (manifest->table[slot] >= 0) slot = (slot + 1) & mask;
+    manifest->table[slot] = index;
+}
+
+/**
+ * Adds a copy of an entry, keeping the table at most half full
+*/
+ManifestEntry* addManifestEntry(Manifest* manifest, ManifestEntry* entry) {
+    if (manifest->count == manifest->size) {
+        manifest->size = manifest->size == 0 ? 256 : manifest->size * 2;
+        manifest->entries = realloc(manifest->entries, manifest->size * sizeof(ManifestEntry));
+    }
+    ManifestEntry* added = &manifest->entries[manifest->count];
+    *added = *entry;
+    added->path = strdup(entry->path);
+    manifest->count++;
+
+    if (manifest->count * 2 <= manifest->tableSize) {
+        placeManifestEntry(manifest, manifest->count - 1);
+        return added;
+    }
+
+    // the table is too full, so double it and put everything back in
+    free(manifest->table);
+    manifest->tableSize = manifest->tableSize == 0 ? 512 : manifest->tableSize * 2;
+    manifest->table = malloc(manifest->tableSize * sizeof(int));
+    memset(manifest->table, 0xFF, manifest->tableSize * sizeof(int));
+    for (int i = 0; i < manifest->count; i++) placeManifestEntry(manifest, i);
+    return added;
+}
+
+/**
+ * Loads a manifest saved by saveManifest. Returns 0 on success and -1 if
+ * the file doesn't exist, isn't whole or names a path that would land
+ * outside the folder it's synced into, leaving the manifest empty
+*/
+int loadManifest(Manifest* manifest, const char* file) {
+    initManifest(manifest);
+    FILE* in = fopen(file, "rb");
+    if (in == NULL) return -1;
+    char header[5];
+    unsigned long long length, count = 0;
+    int failed = fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        memcmp(header, MANIFEST_MAGIC, 4) != 0 || header[4] != MANIFEST_VERSION ||
+        fread(&manifest->digest, sizeof(unsigned long long), 1, in) != 1 ||
+        readVarint(in, &length) != 0 || length >= MANIFEST_PATH_SIZE ||
+        fread(manifest->remote, 1, length, in) != length || readVarint(in, &count) != 0;
+    manifest->remote[failed ? 0 : length] = '\0';
+
+    char path[MANIFEST_PATH_SIZE];
+    for (unsigned long long i = 0; i < count && !failed; i++) {
+        ManifestEntry entry = { 0 };
+        unsigned long long modified, localSize, localModified;
+        failed = readVarint(in, &entry.size) != 0 || readVarint(in, &modified) != 0 ||
+            fread(&entry.hash, sizeof(unsigned long long), 1, in) != 1 || readVarint(in, &length) != 0 ||
+            length == 0 || length >= MANIFEST_PATH_SIZE || fread(path, 1, length, in) != length ||
+            readVarint(in, &localSize) != 0 || readVarint(in, &localModified) != 0;
+        if (failed) break;
+        path[length] = '\0';
+        if ((failed = !isSafeTarPath(path))) break;
+        entry.path = path;
+        entry.modified = (long long)modified;
+        entry.localSize = localSize;
+        entry.localModified = (long long)localModified;
+        addManifestEntry(manifest, &entry);
+    }
+    fclose(in);
+    if (failed) clearManifest(manifest);
+    return failed ? -1 : 0;
+}
+
+/**
+ * Saves a manifest along with the local state of its files, writing it
+ * to the side first so a sync cut short never leaves half of one behind
+*/
+int saveManifest(Manifest* manifest, const char* file) {
+    char temporary[MANIFEST_PATH_SIZE + 8];
+    snprintf(temporary, sizeof(temporary), "%s.part", file);
+    FILE* out = fopen(temporary, "wb");
+    if (out == NULL) return -1;
+    char header[5] = MANIFEST_MAGIC;
+    header[4] = MANIFEST_VERSION;
+    char record[MANIFEST_RECORD_MAX + 20];
+    fwrite(header, 1, sizeof(header), out);
+    fwrite(&manifest->digest, sizeof(unsigned long long), 1, out);
+    int length = strlen(manifest->remote);
+    int used = putVarint(record, length);
+    fwrite(record, 1, used, out);
+    fwrite(manifest->remote, 1, length, out);
+    used = putVarint(record, manifest->count);
+    fwrite(record, 1, used, out);
+    for (int i = 0; i < manifest->count; i++) {
+        ManifestEntry* entry = &manifest->entries[i];
+        used = putManifestEntry(record, entry->path, entry->size, entry->modified, entry->hash);
+        used += putVarint(record + used, entry->localSize);
+        used += putVarint(record + used, (unsigned long long)entry->localModified);
+        fwrite(record, 1, used, out);
+    }
+    int failed = ferror(out);
+    if (fclose(out) != 0 || failed) {
+        remove(temporary);
+        return -1;
+    }
+    remove(file);
+    return rename(temporary, file);
+}
+
+#endif
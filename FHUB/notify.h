@@ -0,0 +1,121 @@
+/**
+ * notify.h - gathers up changes to a watched tree so a burst of them can
+ * be pushed out to clients at once. repeated changes to one path are
+ * folded into one, and changes that cancel out are dropped
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+#ifdef __linux__
+
+// defines
+#define NOTIFY_MAX_CHANGES    512
+
+// includes
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "watch.h"
+
+// the latest state of a changed path
+typedef struct {
+    char*      path;
+    int        change;
+    int        directory;
+} PendingChange;
+
+// the changes gathered since they were last pushed. once too many have
+// piled up, or some were missed, only the fact that something changed is kept
+typedef struct {
+    PendingChange changes[NOTIFY_MAX_CHANGES];
+    int        count;
+    int        overflowed;
+    long long  events;
+    long long  since;
+} ChangeSet;
+
+// function declarations
+void   addChange(ChangeSet* set, int change, const char* path, int directory);
+void   dropChange(ChangeSet* set, int index);
+void   clearChanges(ChangeSet* set);
+int    formatChange(PendingChange* change, const char* under, char* out, int room);
+
+/**
+ * Takes a change out of the set
+*/
+void dropChange(ChangeSet* set, int index) {
+    free(set->changes[index].path);
+    set->changes[index] = set->changes[--set->count];
+}
+
+/**
+ * Folds a change into the set. Something created and then removed never
+ * happened as far as anyone watching is concerned, and something removed
+ * and then created again was just changed. Removing a directory makes any
+ * change below it moot. An empty path means changes were missed
+*/
+void addChange(ChangeSet* set, int change, const char* path, int directory) {
+    set->events++;
+    if (set->overflowed) return;
+    if (path[0] == '\0') {
+        clearChanges(set);
+        set->overflowed = 1;
+        return;
+    }
+
+    if (change == WATCH_REMOVED && directory) {
+        for (int i = 0; i < set->count; i++)
+            if (isUnder(set->changes[i].path, path) && strcmp(set->changes[i].path, path) != 0) dropChange(set, i--);
+    }
+    for (int i = 0; i < set->count; i++) {
+        PendingChange* pending = &set->changes[i];
+        if (strcmp(pending->path, path) != 0) continue;
+        if (pending->change == WATCH_CREATED && change == WATCH_REMOVED) dropChange(set, i);
+        else if (pending->change == WATCH_REMOVED && change == WATCH_CREATED) pending->change = WATCH_CHANGED;
+        else if (pending->change != WATCH_CREATED) pending->change = change;
+        pending->directory = directory;
+        return;
+    }
+
+    if (set->count == NOTIFY_MAX_CHANGES) {
+        clearChanges(set);
+        set->overflowed = 1;
+        return;
+    }
+    PendingChange* added = &set->changes[set->count++];
+    added->path = strdup(path);
+    added->change = change;
+    added->directory = directory;
+}
+
+/**
+ * Empties the set once its changes have been pushed
+*/
+void clearChanges(ChangeSet* set) {
+    while (set->count > 0) dropChange(set, set->count - 1);
+    set->overflowed = 0;
+    set->since = 0;
+}
+
+/**
+ * Writes a change as a line of a notification, a + for created, - for
+ * removed or ~ for changed followed by the path relative to under, with a
+ * trailing slash for directories. Returns the length of the line, or 0 if
+ * the change isn't below under or the line doesn't fit
+*/
+int formatChange(PendingChange* change, const char* under, char* out, int room) {
+    if (!isUnder(change->path, under)) return 0;
+    const char* relative = change->path + strlen(under);
+    if (*relative == '/') relative++;
+    if (*relative == '\0') relative = ".";
+    char kind = change->change == WATCH_CREATED ? '+' : change->change == WATCH_REMOVED ? '-' : '~';
+    int length = snprintf(out, room, "%c%s%s\n", kind, relative, change->directory ? "/" : "");
+    return length < room ? length : 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * outqueue.h - per client queues of outgoing frames that are flushed
+ * together with a single gather write
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef OUTQUEUE_H
+#define OUTQUEUE_H
+
+// defines
+#define MAX_PENDING           256
+#define FLUSH_VECTORS         64
+
+// includes
+#include <stdlib.h>
+#include "packetpool.h"
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+// gather write entries are WSABUFs on windows and iovecs everywhere else
+#ifdef _WIN32
+typedef WSABUF IoVector;
+#else
+typedef struct iovec IoVector;
+#endif
+
+// a ring of shared packets waiting to be written to one client. the
+// queue holds its own reference to each packet until it is sent
+typedef struct {
+    Packet*   packets[MAX_PENDING];
+    int       head;
+    int       count;
+    long long bytes;
+} OutQueue;
+
+// function declarations
+int        queuePacket(OutQueue* queue, Packet* packet);
+void       clearQueue(OutQueue* queue);
+int        flushQueue(OutQueue* queue, int socket_fd, long long* calls);
+int        fillVectors(OutQueue* queue, IoVector* vectors, int max);
+void       dropSent(OutQueue* queue, int count);
+long long  gatherWrite(int socket_fd, IoVector* vectors, int count, long long* calls);
+
+/**
+ * Appends a packet to the end of the queue, taking a reference
+ * to it. Returns 0 without queueing it if the queue is full
+*/
+int queuePacket(OutQueue* queue, Packet* packet) {
+    if (queue->count >= MAX_PENDING) return 0;
+    int index = (queue->head + queue->count) % MAX_PENDING;
+    retainPacket(packet);
+    queue->packets[index] = packet;
+    queue->count++;
+    queue->bytes += packet->length;
+    return 1;
+}
+
+/**
+ * Releases every packet still sitting in the queue
+*/
+void clearQueue(OutQueue* queue) {
+    while (queue->count > 0) {
+        releasePacket(queue->packets[queue->head]);
+        queue->head = (queue->head + 1) % MAX_PENDING;
+        queue->count--;
+    }
+    queue->head = 0;
+    queue->bytes = 0;
+}
+
+/**
+ * Writes every queued packet to the socket, batching up to FLUSH_VECTORS
+ * packets per call. Returns the number of frames sent, or -1 if the socket
+ * failed, in which case the rest of the queue is thrown away. The number
+ * of send calls made is added to calls
+*/
+int flushQueue(OutQueue* queue, int socket_fd, long long* calls) {
+    int sent = 0;
+    while (queue->count > 0) {
+        IoVector vectors[FLUSH_VECTORS];
+        int count = fillVectors(queue, vectors, FLUSH_VECTORS);
+        if (gatherWrite(socket_fd, vectors, count, calls) < 0) {
+            clearQueue(queue);
+            return -1;
+        }
+        dropSent(queue, count);
+        sent += count;
+    }
+    queue->head = 0;
+    return sent;
+}
+
+/**
+ * Points up to max gather write entries at the packets at the
+ * front of the queue and returns how many were filled in
+*/
+int fillVectors(OutQueue* queue, IoVector* vectors, int max) {
+    int count = 0;
+    for (; count < queue->count && count < max; count++) {
+        Packet* packet = queue->packets[(queue->head + count) % MAX_PENDING];
+#ifdef _WIN32
+        vectors[count].buf = packet->data;
+        vectors[count].len = packet->length;
+#else
+        vectors[count].iov_base = packet->data;
+        vectors[count].iov_len = packet->length;
+#endif
+    }
+    return count;
+}
+
+/**
+ * Releases the given number of packets off the front of
+ * the queue once they have been written
+*/
+void dropSent(OutQueue* queue, int count) {
+    for (int i = 0; i < count; i++) {
+        queue->bytes -= queue->packets[queue->head]->length;
+        releasePacket(queue->packets[queue->head]);
+        queue->head = (queue->head + 1) % MAX_PENDING;
+        queue->count--;
+    }
+}
+
+/**
+ * Writes all of the given buffers to the socket in as few calls as
+ * possible, picking back up after partial writes. Returns the number
+ * of bytes written or -1 if the socket failed
+*/
+long long gatherWrite(int socket_fd, IoVector* vectors, int count, long long* calls) {
+    long long total = 0;
+#ifdef _WIN32
+    DWORD written = 0;
+    (*calls)++;
+    if (WSASend(socket_fd, vectors, count, &written, 0, NULL, NULL) != 0) return -1;
+    total = written;
+#else
+    int index = 0;
+    while (index < count) {
+        struct msghdr message = { 0 };
+        message.msg_iov = vectors + index;
+        message.msg_iovlen = count - index;
+        ssize_t written = sendmsg(socket_fd, &message, MSG_NOSIGNAL);
+        (*calls)++;
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        total += written;
+
+        // skip past whatever was fully written and trim a partial one
+        while (index < count && written >= (ssize_t)vectors[index].iov_len) {
+            written -= vectors[index].iov_len;
+            index++;
+        }
+        if (index < count) {
+            vectors[index].iov_base = (char*)vectors[index].iov_base + written;
+            vectors[index].iov_len -= written;
+        }
+    }
+#endif
+    return total;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * packetpool.h - pooled, reference counted packet buffers that can be shared
+ * between the chat log, the console and every client's output queue
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef PACKETPOOL_H
+#define PACKETPOOL_H
+
+// defines
+#define POOL_PAYLOAD_SIZE     4096
+#define POOL_SLAB_SIZE        64
+
+// includes
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "protocol.h"
+
+struct PacketPool;
+
+// a complete frame (header and payload) along with a reference count.
+// the payload is always followed by a '\0' so it can be printed as is
+typedef struct Packet {
+    struct Packet*     next;
+    struct PacketPool* pool;
+    int                refs;
+    int                length;
+    char               data[HEADER_SIZE + POOL_PAYLOAD_SIZE + 1];
+} Packet;
+
+// free list of packets. packets are carved out of slabs that are
+// never given back, so once warmed up the pool stops allocating
+typedef struct PacketPool {
+    Packet*         free;
+    pthread_mutex_t lock;
+    long long       created;
+    long long       inUse;
+    long long       slabs;
+} PacketPool;
+
+// function declarations
+void     initPacketPool(PacketPool* pool);
+Packet*  acquirePacket(PacketPool* pool);
+Packet*  makePacket(PacketPool* pool, char type, const char* payload, int length);
+void     retainPacket(Packet* packet);
+void     releasePacket(Packet* packet);
+char     packetType(Packet* packet);
+char*    packetPayload(Packet* packet);
+int      payloadLength(Packet* packet);
+
+/**
+ * Sets up an empty pool
+*/
+void initPacketPool(PacketPool* pool) {
+    pool->free    = NULL;
+    pool->created = 0;
+    pool->inUse   = 0;
+    pool->slabs   = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+}
+
+/**
+ * Takes a packet out of the pool with a single reference, growing
+ * the pool by a slab if it has run dry. Returns NULL if out of memory
+*/
+Packet* acquirePacket(PacketPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->free == NULL) {
+        Packet* slab = malloc(sizeof(Packet) * POOL_SLAB_SIZE);
+        if (slab == NULL) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        for (int i = 0; i < POOL_SLAB_SIZE; i++) {
+            slab[i].pool = pool;
+            slab[i].next = pool->free;
+            pool->free = &slab[i];
+        }
+        pool->created += POOL_SLAB_SIZE;
+        pool->slabs++;
+    }
+    Packet* packet = pool->free;
+    pool->free = packet->next;
+    pool->inUse++;
+    pthread_mutex_unlock(&pool->lock);
+
+    packet->next = NULL;
+    packet->refs = 1;
+    packet->length = HEADER_SIZE;
+    return packet;
+}
+
+/**
+ * Acquires a packet and fills it with a framed copy of the payload.
+ * Returns NULL if out of memory or the payload doesn't fit in a packet
+*/
+Packet* makePacket(PacketPool* pool, char type, const char* payload, int length) {
+    if (length < 0 || length > POOL_PAYLOAD_SIZE) return NULL;
+    Packet* packet = acquirePacket(pool);
+    if (packet == NULL) return NULL;
+    writeHeader(packet->data, type, length);
+    memcpy(packet->data + HEADER_SIZE, payload, length);
+    packet->data[HEADER_SIZE + length] = '\0';
+    packet->length = HEADER_SIZE + length;
+    return packet;
+}
+
+/**
+ * Adds a reference to a packet that is being shared
+*/
+void retainPacket(Packet* packet) {
+    __atomic_add_fetch(&packet->refs, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Drops a reference to a packet, handing it back to its
+ * pool once nobody is holding it anymore
+*/
+void releasePacket(Packet* packet) {
+    if (__atomic_sub_fetch(&packet->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    PacketPool* pool = packet->pool;
+    pthread_mutex_lock(&pool->lock);
+    packet->next = pool->free;
+    pool->free = packet;
+    pool->inUse--;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Gets the packet type out of the frame header
+*/
+char packetType(Packet* packet) {
+    return packet->data[0];
+}
+
+/**
+ * Gets the '\0' terminated payload of the packet
+*/
+char* packetPayload(Packet* packet) {
+    return packet->data + HEADER_SIZE;
+}
+
+/**
+ * Gets the length of the payload of the packet
+*/
+int payloadLength(Packet* packet) {
+    return packet->length - HEADER_SIZE;
+}
+
+#endif
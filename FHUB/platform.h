@@ -0,0 +1,138 @@
+/**
+ * platform.h - pulls in the socket and console headers for the platform
+ * being built on. windows gets winsock and conio, everything else gets the
+ * posix equivalents along with stand-ins for the few windows calls used
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#ifdef _WIN32
+
+// includes
+#include <ws2tcpip.h>
+#include <direct.h>
+#include <conio.h>
+
+// console input on windows comes through conio, which never sees it close
+int  g_inputClosed                     =   0  ;
+
+#else
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+// winsock needs to be started and stopped, sockets here don't
+#define MAKEWORD(low, high)   ((unsigned short)(((low) & 0xFF) | (((high) & 0xFF) << 8)))
+#define LOBYTE(word)          ((word) & 0xFF)
+#define HIBYTE(word)          (((word) >> 8) & 0xFF)
+
+typedef struct {
+    unsigned short wVersion;
+} WSADATA;
+
+// console state
+struct termios g_savedTerminal;
+int  g_rawTerminal                     =   0  ;
+int  g_inputClosed                     =   0  ;
+
+// function declarations
+int    WSAStartup(unsigned short version, WSADATA* data);
+int    WSACleanup(void);
+void   unbufferInput(void) __attribute__((constructor));
+void   restoreTerminal(void);
+void   rawTerminal(void);
+int    kbhit(void);
+int    getch(void);
+
+/**
+ * Stands in for winsock's startup. There is nothing to start, but a
+ * client hanging up mid send would otherwise kill the whole program
+ * with SIGPIPE, so that gets ignored here
+*/
+int WSAStartup(unsigned short version, WSADATA* data) {
+    signal(SIGPIPE, SIG_IGN);
+    data->wVersion = version;
+    return 0;
+}
+
+/**
+ * Stands in for winsock's cleanup, which has nothing to do here
+*/
+int WSACleanup() {
+    return 0;
+}
+
+/**
+ * Runs before main. Lines read with fgets would otherwise pull keys
+ * meant for getch into stdio's buffer, where kbhit can't see them
+*/
+void unbufferInput() {
+    setvbuf(stdin, NULL, _IONBF, 0);
+}
+
+/**
+ * Puts the terminal back the way it was found
+*/
+void restoreTerminal() {
+    if (g_rawTerminal) tcsetattr(STDIN_FILENO, TCSANOW, &g_savedTerminal);
+}
+
+/**
+ * Turns off line buffering and echo on the terminal, the way conio
+ * reads keys. Does nothing if input isn't coming from a terminal
+*/
+void rawTerminal() {
+    if (g_rawTerminal || !isatty(STDIN_FILENO)) return;
+    if (tcgetattr(STDIN_FILENO, &g_savedTerminal) != 0) return;
+    struct termios raw = g_savedTerminal;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) != 0) return;
+    g_rawTerminal = 1;
+    atexit(restoreTerminal);
+}
+
+/**
+ * Checks if a key is waiting to be read without blocking. Once the
+ * input has been closed there is never anything waiting again
+*/
+int kbhit() {
+    if (g_inputClosed) return 0;
+    rawTerminal();
+    fflush(stdout);
+    struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&input, 1, 0) > 0;
+}
+
+/**
+ * Waits for a single key and reads it without echoing it. The delete key
+ * comes back as a backspace, and closed input ends the line it was on
+*/
+int getch() {
+    rawTerminal();
+    fflush(stdout);
+    unsigned char key;
+    if (read(STDIN_FILENO, &key, 1) != 1) {
+        g_inputClosed = 1;
+        return '\n';
+    }
+    return key == 0x7F ? '\b' : key;
+}
+
+#endif
+
+#endif
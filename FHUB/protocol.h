@@ -0,0 +1,129 @@
+/**
+ * protocol.h - framing helpers for packets sent between the server and its clients
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// every frame on the wire is a 1 byte packet type followed by a 4 byte
+// big endian payload length and then the payload itself. this lets
+// several frames share one write without running into each other
+#define HEADER_SIZE           5
+#define MAX_PAYLOAD_SIZE      65536
+#define READER_SIZE           (HEADER_SIZE + MAX_PAYLOAD_SIZE)
+#define FRAME_ERROR           -1
+
+// includes
+#include <string.h>
+
+// buffers received bytes until whole frames can be pulled out of them
+typedef struct {
+    char data[READER_SIZE];
+    int  start;
+    int  end;
+} FrameReader;
+
+// function declarations
+void          writeHeader(char* frame, char type, unsigned int length);
+unsigned int  readLength(const char* frame);
+char*         readerSpace(FrameReader* reader, int* available);
+void          readerCommit(FrameReader* reader, int received);
+int           nextFrame(FrameReader* reader, char* type, char** payload, unsigned int* length);
+int           sendAll(int socket_fd, const char* buf, int length);
+int           sendFrame(int socket_fd, char type, const char* payload, unsigned int length);
+
+/**
+ * Writes a frame header for the given type and
+ * payload length into the start of the frame
+*/
+void writeHeader(char* frame, char type, unsigned int length) {
+    frame[0] = type;
+    frame[1] = (char)((length >> 24) & 0xFF);
+    frame[2] = (char)((length >> 16) & 0xFF);
+    frame[3] = (char)((length >> 8) & 0xFF);
+    frame[4] = (char)(length & 0xFF);
+}
+
+/**
+ * Reads the payload length out of a frame header
+*/
+unsigned int readLength(const char* frame) {
+    const unsigned char* header = (const unsigned char*)frame;
+    return ((unsigned int)header[1] << 24) | ((unsigned int)header[2] << 16) |
+           ((unsigned int)header[3] << 8)  |  (unsigned int)header[4];
+}
+
+/**
+ * Gets the free space at the end of the reader to receive into,
+ * shifting any partially received frame to the front first
+*/
+char* readerSpace(FrameReader* reader, int* available) {
+    if (reader->start > 0) {
+        memmove(reader->data, reader->data + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+    *available = READER_SIZE - reader->end;
+    return reader->data + reader->end;
+}
+
+/**
+ * Marks the given number of bytes as received into
+ * the space handed out by readerSpace
+*/
+void readerCommit(FrameReader* reader, int received) {
+    if (received > 0) reader->end += received;
+}
+
+/**
+ * Pulls the next complete frame out of the reader. Returns 1 and points
+ * payload into the reader's buffer if there was one, 0 if more bytes are
+ * needed, or FRAME_ERROR if the peer sent something that isn't a frame.
+ * The payload is only valid until the next call to readerSpace
+*/
+int nextFrame(FrameReader* reader, char* type, char** payload, unsigned int* length) {
+    int buffered = reader->end - reader->start;
+    if (buffered < HEADER_SIZE) return 0;
+    char* frame = reader->data + reader->start;
+    unsigned int size = readLength(frame);
+    if (size > MAX_PAYLOAD_SIZE) return FRAME_ERROR;
+    if ((unsigned int)buffered < HEADER_SIZE + size) return 0;
+    *type = frame[0];
+    *payload = frame + HEADER_SIZE;
+    *length = size;
+    reader->start += HEADER_SIZE + size;
+    return 1;
+}
+
+/**
+ * Sends the whole buffer, retrying after partial sends.
+ * Returns 0 on success and -1 if the socket failed
+*/
+int sendAll(int socket_fd, const char* buf, int length) {
+    while (length > 0) {
+        int sent = send(socket_fd, buf, length, 0);
+        if (sent <= 0) return -1;
+        buf += sent;
+        length -= sent;
+    }
+    return 0;
+}
+
+/**
+ * Frames the payload with the given type and sends it. Small
+ * frames are sent with a single call
+*/
+int sendFrame(int socket_fd, char type, const char* payload, unsigned int length) {
+    char frame[HEADER_SIZE + 4096];
+    writeHeader(frame, type, length);
+    if (length <= 4096) {
+        memcpy(frame + HEADER_SIZE, payload, length);
+        return sendAll(socket_fd, frame, HEADER_SIZE + length);
+    }
+    if (sendAll(socket_fd, frame, HEADER_SIZE) != 0) return -1;
+    return sendAll(socket_fd, payload, length);
+}
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * ratelimit.h - token bucket helpers for throttling client traffic
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+// a bucket that refills at a steady rate and can hold up to
+// capacity tokens. a rate of 0 means the bucket is unlimited
+typedef struct {
+    double    tokens;
+    double    rate;
+    double    capacity;
+    long long updated;
+} TokenBucket;
+
+// function declarations
+void      initBucket(TokenBucket* bucket, double rate, double capacity, long long now);
+void      refillBucket(TokenBucket* bucket, long long now);
+long long bucketDelay(TokenBucket* bucket, double cost, long long now);
+void      takeTokens(TokenBucket* bucket, double cost);
+
+/**
+ * Sets up a bucket with the given refill rate (tokens per second)
+ * and capacity. The bucket starts out full
+*/
+void initBucket(TokenBucket* bucket, double rate, double capacity, long long now) {
+    bucket->rate     = rate;
+    bucket->capacity = capacity;
+    bucket->tokens   = capacity;
+    bucket->updated  = now;
+}
+
+/**
+ * Adds the tokens earned since the last refill, capped
+ * at the bucket capacity
+*/
+void refillBucket(TokenBucket* bucket, long long now) {
+    if (now <= bucket->updated) return;
+    bucket->tokens += (now - bucket->updated) * bucket->rate / 1000000.0;
+    if (bucket->tokens > bucket->capacity)
+        bucket->tokens = bucket->capacity;
+    bucket->updated = now;
+}
+
+/**
+ * Returns how many microseconds need to pass before the bucket
+ * can pay for the given cost, or 0 if it can pay right now.
+ * Costs larger than the capacity are clamped so that they can
+ * still eventually be paid for
+*/
+long long bucketDelay(TokenBucket* bucket, double cost, long long now) {
+    if (bucket->rate <= 0) return 0;
+    refillBucket(bucket, now);
+    if (cost > bucket->capacity) cost = bucket->capacity;
+    if (bucket->tokens >= cost) return 0;
+    return (long long)((cost - bucket->tokens) * 1000000.0 / bucket->rate) + 1;
+}
+
+/**
+ * Removes the given cost from the bucket. Should only be
+ * called once bucketDelay has said the cost can be paid
+*/
+void takeTokens(TokenBucket* bucket, double cost) {
+    if (bucket->rate <= 0) return;
+    if (cost > bucket->capacity) cost = bucket->capacity;
+    bucket->tokens -= cost;
+    if (bucket->tokens < 0) bucket->tokens = 0;
+}
+
+#endif
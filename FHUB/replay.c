@@ -0,0 +1,196 @@
+/**
+ * replay.c - plays a recorded trace back against a server. every recorded
+ * connection gets a connection of its own and its packets are sent either
+ * with their original timing or as fast as the server will take them
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+// defines
+#define DEFAULT_HOST          "127.0.0.1"
+#define MAX_CONNECTIONS       64
+#define SLEEP_SLACK           1000
+#define TRUE                  1
+#define FALSE                 0
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// custom includes
+#include "utils.h"
+#include "protocol.h"
+#include "trace.h"
+
+// a recorded connection being played back
+typedef struct {
+    unsigned long long id;
+    int                socket;
+    int                open;
+    pthread_t          drainer;
+    long long          received;
+} Connection;
+
+// global variables
+Connection g_connections[MAX_CONNECTIONS] = { 0 };
+int    g_port                          =   0  ;
+double g_speed                         =   1  ;
+
+// function declarations
+Connection* findConnection(unsigned long long id);
+int    openConnection(unsigned long long id);
+void   closeConnection(Connection* connection);
+void*  drainConnection(void* arg);
+
+/**
+ * Main function that handles program flow. Usage is
+ * replay <trace> <port> [--fast | --speed <factor>]
+*/
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("usage: replay <trace> <port> [--fast | --speed <factor>]\n");
+        return 1;
+    }
+    g_port = atoi(argv[2]);
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--fast") == 0) g_speed = 0;
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) g_speed = atof(argv[++i]);
+    }
+
+    TraceReader reader;
+    if (openTraceReader(&reader, argv[1]) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> %s could not be opened or is not a trace\n", argv[1]);
+        resetText();
+        return 2;
+    }
+
+    TraceRecord record;
+    long long frames = 0, bytes = 0, skipped = 0, connections = 0;
+    long long start = getTimeMicros();
+    long long traceLength = 0;
+    int status;
+    while ((status = nextTraceRecord(&reader, &record)) == TRUE) {
+        traceLength = record.time;
+
+        // hold each record back until its time comes up, scaled by the speed.
+        // waits too short to sleep through accurately are skipped instead
+        if (g_speed > 0) {
+            long long due = start + (long long)(record.time / g_speed);
+            long long now = getTimeMicros();
+            if (due - now > SLEEP_SLACK) sleepMicros(due - now);
+        }
+
+        Connection* connection = findConnection(record.connection);
+        if (record.kind == TRACE_OPEN) {
+            if (connection == NULL && openConnection(record.connection) == 0) connections++;
+        } else if (record.kind == TRACE_CLOSE) {
+            if (connection != NULL) closeConnection(connection);
+        } else if (connection == NULL || sendFrame(connection->socket, record.type, record.payload, record.length) != 0) {
+            skipped++;
+        } else {
+            frames++;
+            bytes += HEADER_SIZE + record.length;
+        }
+    }
+    double elapsed = (getTimeMicros() - start) / 1000000.0;
+    if (status < 0) {
+        setTextColor(YELLOW);
+        printf("WARNING: the trace ends with a corrupt record\n");
+        resetText();
+    }
+
+    long long received = 0;
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (g_connections[i].open) closeConnection(&g_connections[i]);
+        received += g_connections[i].received;
+    }
+    closeTraceReader(&reader);
+
+    printf("connections: %lld\n", connections);
+    printf("frames sent: %lld (%lld skipped)\n", frames, skipped);
+    printf("bytes sent: %lld, bytes received: %lld\n", bytes, received);
+    printf("trace length: %.3fs, replayed in: %.3fs\n", traceLength / 1000000.0, elapsed);
+    if (elapsed > 0) printf("throughput: %.0f frames/s, %.2f MB/s\n", frames / elapsed, bytes / elapsed / 1000000.0);
+    return 0;
+}
+
+/**
+ * Finds the open connection playing back the recorded connection
+ * with the given id, or NULL if there isn't one
+*/
+Connection* findConnection(unsigned long long id) {
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+        if (g_connections[i].open && g_connections[i].id == id)
+            return &g_connections[i];
+    return NULL;
+}
+
+/**
+ * Connects to the server for a recorded connection and starts draining
+ * whatever the server sends back to it. Returns 0 on success
+*/
+int openConnection(unsigned long long id) {
+    Connection* connection = NULL;
+    for (int i = 0; i < MAX_CONNECTIONS && connection == NULL; i++)
+        if (!g_connections[i].open) connection = &g_connections[i];
+    if (connection == NULL) return -1;
+
+    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (socket_fd < 0) return -1;
+    struct sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(g_port);
+    inet_pton(AF_INET, DEFAULT_HOST, &address.sin_addr);
+    if (connect(socket_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(socket_fd);
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    long long received = connection->received;
+    memset(connection, 0, sizeof(Connection));
+    connection->id = id;
+    connection->socket = socket_fd;
+    connection->received = received;
+    if (pthread_create(&connection->drainer, NULL, drainConnection, connection) != 0) {
+        close(socket_fd);
+        return -1;
+    }
+    connection->open = TRUE;
+    return 0;
+}
+
+/**
+ * Hangs up a connection. Anything already sent on it still reaches
+ * the server, but nothing more is read back
+*/
+void closeConnection(Connection* connection) {
+    shutdown(connection->socket, SHUT_RDWR);
+    pthread_join(connection->drainer, NULL);
+    close(connection->socket);
+    connection->open = FALSE;
+}
+
+/**
+ * Drainer thread. Reads and throws away everything the server sends so
+ * it never blocks on a full socket, until the connection is closed
+*/
+void* drainConnection(void* arg) {
+    Connection* connection = arg;
+    char buffer[65536];
+    while (1) {
+        int received = recv(connection->socket, buffer, sizeof(buffer), 0);
+        if (received <= 0) break;
+        connection->received += received;
+    }
+    return NULL;
+}
@@ -0,0 +1,493 @@
+/**
+ * search.h - an inverted index over the chat log. messages are indexed in
+ * segments as they come in. once a segment fills up its postings are sealed
+ * into delta encoded varints, and whole segments are let go as the log
+ * forgets the messages in them, so memory stays bounded by the log's size
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+// defines
+#define SEARCH_SEGMENT_SIZE   65536
+#define SEARCH_TERM_SIZE      32
+#define SEARCH_MAX_TERMS      8
+#define SEARCH_TABLE_SIZE     256
+
+// includes
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "utils.h"
+
+// a term within a segment. while the segment is open its postings are a
+// chain of hits starting at head, newest first. once sealed they are a run
+// of varint gaps between message numbers at offset in the postings blob,
+// running up to where the next term's postings start
+typedef struct {
+    unsigned int   hash;
+    unsigned int   text;
+    unsigned int   count;
+    unsigned int   last;
+    unsigned int   head;
+    unsigned int   offset;
+} SearchTerm;
+
+// a term appearing in one message of an open segment, linked
+// to the hit before it for the same term
+typedef struct {
+    unsigned int   term;
+    unsigned int   message;
+    unsigned int   previous;
+} SearchHit;
+
+// the index of SEARCH_SEGMENT_SIZE consecutive messages. table maps term
+// hashes to term numbers, and terms are kept in the order first seen
+typedef struct {
+    long long      first;
+    int            messages;
+    int            sealed;
+    unsigned int   times[SEARCH_SEGMENT_SIZE];
+    int*           table;
+    int            tableSize;
+    SearchTerm*    terms;
+    int            termCount;
+    int            termSize;
+    char*          text;
+    int            textUsed;
+    int            textSize;
+    SearchHit*     hits;
+    int            hitCount;
+    int            hitSize;
+    char*          postings;
+    int            postingBytes;
+} SearchSegment;
+
+// every segment that can still hold messages the log remembers, kept in a
+// ring by segment number. the rest is scratch space for queries. marks are
+// stamped so they never need clearing between segments
+typedef struct {
+    SearchSegment** segments;
+    int            slots;
+    long long      messages;
+    unsigned int   stamp;
+    unsigned int   marks[SEARCH_SEGMENT_SIZE];
+    unsigned short candidates[SEARCH_SEGMENT_SIZE];
+    unsigned short postings[SEARCH_SEGMENT_SIZE];
+} SearchIndex;
+
+// a parsed query. terms must all appear in a message, and a user filter
+// is just one more term. since is a time in seconds, or 0 for any time
+typedef struct {
+    char           terms[SEARCH_MAX_TERMS][SEARCH_TERM_SIZE + 2];
+    int            count;
+    long long      since;
+} SearchQuery;
+
+// a message that matched a query
+typedef struct {
+    long long      id;
+    long long      time;
+} SearchResult;
+
+// function declarations
+void   initSearchIndex(SearchIndex* index, long long capacity);
+void   indexMessage(SearchIndex* index, long long id, const char* text, int length, long long time);
+long long searchIndex(SearchIndex* index, SearchQuery* query, long long oldest, SearchResult* results, int max);
+long long searchMemory(SearchIndex* index);
+int    parseQuery(SearchQuery* query, char** args, int numargs, long long now);
+int    nextTerm(const char** text, const char* end, char* term);
+void   addQueryTerm(SearchQuery* query, char prefix, const char* text, int length);
+unsigned int hashTerm(const char* term, int length);
+int    findTerm(SearchSegment* segment, const char* term, int length, unsigned int hash);
+void   addTerm(SearchSegment* segment, const char* term, int length, int message);
+void   growTable(SearchSegment* segment);
+void   sealSegment(SearchSegment* segment);
+void   freeSegment(SearchIndex* index, SearchSegment* segment);
+int    termMessages(SearchSegment* segment, int number, unsigned short* messages);
+int    matchSegment(SearchIndex* index, SearchSegment* segment, SearchQuery* query);
+
+/**
+ * Sets up an index with room for the given number of most recent messages
+*/
+void initSearchIndex(SearchIndex* index, long long capacity) {
+    memset(index, 0, sizeof(SearchIndex));
+    index->slots = (int)((capacity + SEARCH_SEGMENT_SIZE - 1) / SEARCH_SEGMENT_SIZE) + 1;
+    index->segments = calloc(index->slots, sizeof(SearchSegment*));
+}
+
+/**
+ * Pulls the next term out of some text, lowercased and cut down to
+ * SEARCH_TERM_SIZE bytes. Terms are runs of letters, digits and any
+ * non ascii bytes. Returns the term's length, or 0 when there are none left
+*/
+int nextTerm(const char** text, const char* end, char* term) {
+    const char* read = *text;
+    while (read < end && !isalnum((unsigned char)*read) && !((unsigned char)*read & 0x80)) read++;
+    int length = 0;
+    while (read < end && (isalnum((unsigned char)*read) || ((unsigned char)*read & 0x80))) {
+        if (length < SEARCH_TERM_SIZE) term[length++] = (char)tolower((unsigned char)*read);
+        read++;
+    }
+    *text = read;
+    return length;
+}
+
+/**
+ * Hashes a term with FNV-1a
+*/
+unsigned int hashTerm(const char* term, int length) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)term[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Looks a term up in a segment. Returns its number or -1 if the segment
+ * has never seen it
+*/
+int findTerm(SearchSegment* segment, const char* term, int length, unsigned int hash) {
+    if (segment->tableSize == 0) return -1;
+    int mask = segment->tableSize - 1;
+    for (int slot = hash & mask; segment->table[slot] >= 0; slot = (slot + 1) & mask) {
+        SearchTerm* entry = &segment->terms[segment->table[slot]];
+        if (entry->hash == hash && strncmp(segment->text + entry->text, term, length) == 0 &&
+            segment->text[entry->text + length] == '\0')
+            return segment->table[slot];
+    }
+    return -1;
+}
+
+/**
+ * Doubles a segment's hash table, keeping it at most half full
+*/
+void growTable(SearchSegment* segment) {
+    int size = segment->tableSize == 0 ? SEARCH_TABLE_SIZE : segment->tableSize * 2;
+    int* table = malloc(size * sizeof(int));
+    for (int i = 0; i < size; i++) table[i] = -1;
+    for (int i = 0; i < segment->termCount; i++) {
+        int slot = segment->terms[i].hash & (size - 1);
+        while (table[slot] >= 0) slot = (slot + 1) & (size - 1);
+        table[slot] = i;
+    }
+    free(segment->table);
+    segment->table = table;
+    segment->tableSize = size;
+}
+
+/**
+ * Records that a term appears in one of a segment's messages.
+ * Repeats of a term within the same message are only counted once
+*/
+void addTerm(SearchSegment* segment, const char* term, int length, int message) {
+    unsigned int hash = hashTerm(term, length);
+    int number = findTerm(segment, term, length, hash);
+    if (number < 0) {
+        if ((segment->termCount + 1) * 2 > segment->tableSize) growTable(segment);
+        if (segment->termCount == segment->termSize) {
+            segment->termSize = segment->termSize == 0 ? SEARCH_TABLE_SIZE : segment->termSize * 2;
+            segment->terms = realloc(segment->terms, segment->termSize * sizeof(SearchTerm));
+        }
+        if (segment->textUsed + length + 1 > segment->textSize) {
+            while (segment->textUsed + length + 1 > segment->textSize)
+                segment->textSize = segment->textSize == 0 ? SEARCH_TABLE_SIZE * 8 : segment->textSize * 2;
+            segment->text = realloc(segment->text, segment->textSize);
+        }
+        number = segment->termCount++;
+        SearchTerm* entry = &segment->terms[number];
+        memset(entry, 0, sizeof(SearchTerm));
+        entry->hash = hash;
+        entry->text = segment->textUsed;
+        memcpy(segment->text + segment->textUsed, term, length);
+        segment->text[segment->textUsed + length] = '\0';
+        segment->textUsed += length + 1;
+        int slot = hash & (segment->tableSize - 1);
+        while (segment->table[slot] >= 0) slot = (slot + 1) & (segment->tableSize - 1);
+        segment->table[slot] = number;
+    }
+
+    SearchTerm* entry = &segment->terms[number];
+    if (entry->count > 0 && entry->last == (unsigned int)message) return;
+    if (segment->hitCount == segment->hitSize) {
+        segment->hitSize = segment->hitSize == 0 ? SEARCH_SEGMENT_SIZE : segment->hitSize * 2;
+        segment->hits = realloc(segment->hits, segment->hitSize * sizeof(SearchHit));
+    }
+    segment->hits[segment->hitCount].term = number;
+    segment->hits[segment->hitCount].message = message;
+    segment->hits[segment->hitCount].previous = entry->head;
+    entry->head = segment->hitCount++;
+    entry->count++;
+    entry->last = message;
+}
+
+/**
+ * Adds a chat to the index. Ids must be handed out in order, and a chat
+ * is made of the user's name, a '>' and then the message. The name is
+ * indexed as a single term starting with '@' so it can't match a word
+*/
+void indexMessage(SearchIndex* index, long long id, const char* text, int length, long long time) {
+    long long number = id / SEARCH_SEGMENT_SIZE;
+    SearchSegment** slot = &index->segments[number % index->slots];
+    if (*slot == NULL || (*slot)->first != number * SEARCH_SEGMENT_SIZE) {
+        if (*slot != NULL) freeSegment(index, *slot);
+        *slot = calloc(1, sizeof(SearchSegment));
+        (*slot)->first = number * SEARCH_SEGMENT_SIZE;
+    }
+    SearchSegment* segment = *slot;
+    int message = (int)(id - segment->first);
+    segment->times[message] = (unsigned int)time;
+    segment->messages = message + 1;
+    index->messages++;
+
+    // the user's name, if the chat has one
+    const char* end = text + length;
+    const char* body = memchr(text, '>', length);
+    char term[SEARCH_TERM_SIZE + 1];
+    if (body != NULL) {
+        int nameLength = body - text;
+        if (nameLength > SEARCH_TERM_SIZE - 1) nameLength = SEARCH_TERM_SIZE - 1;
+        term[0] = '@';
+        for (int i = 0; i < nameLength; i++) term[i + 1] = (char)tolower((unsigned char)text[i]);
+        addTerm(segment, term, nameLength + 1, message);
+        text = body + 1;
+    }
+
+    // and every word in the message
+    int termLength;
+    while ((termLength = nextTerm(&text, end, term)) > 0)
+        addTerm(segment, term, termLength, message);
+    if (segment->messages == SEARCH_SEGMENT_SIZE) sealSegment(segment);
+}
+
+/**
+ * Seals a full segment. Its hits are sorted by term and written out as
+ * varint gaps between message numbers, which mostly take a byte each,
+ * and everything that was only needed to take new messages is freed
+*/
+void sealSegment(SearchSegment* segment) {
+    // hits are in message order, so a stable counting sort by
+    // term leaves every term's messages in order too
+    unsigned int* starts = malloc((segment->termCount + 1) * sizeof(unsigned int));
+    unsigned short* sorted = malloc((segment->hitCount + 1) * sizeof(unsigned short));
+    unsigned int position = 0;
+    for (int i = 0; i < segment->termCount; i++) {
+        starts[i] = position;
+        position += segment->terms[i].count;
+    }
+    for (int i = 0; i < segment->hitCount; i++)
+        sorted[starts[segment->hits[i].term]++] = (unsigned short)segment->hits[i].message;
+
+    // message numbers fit in 16 bits, so no gap takes more than three bytes
+    char* postings = malloc(segment->hitCount * 3 + 1);
+    int used = 0;
+    position = 0;
+    for (int i = 0; i < segment->termCount; i++) {
+        SearchTerm* entry = &segment->terms[i];
+        entry->offset = used;
+        int previous = -1;
+        for (unsigned int j = 0; j < entry->count; j++) {
+            used += putVarint(postings + used, sorted[position + j] - previous);
+            previous = sorted[position + j];
+        }
+        position += entry->count;
+    }
+    free(starts);
+    free(sorted);
+    free(segment->hits);
+    segment->hits = NULL;
+    segment->hitCount = 0;
+    segment->hitSize = 0;
+
+    segment->postings = realloc(postings, used + 1);
+    segment->postingBytes = used;
+    segment->terms = realloc(segment->terms, (segment->termCount + 1) * sizeof(SearchTerm));
+    segment->terms[segment->termCount].offset = used;
+    segment->termSize = segment->termCount + 1;
+    segment->text = realloc(segment->text, segment->textUsed + 1);
+    segment->textSize = segment->textUsed;
+    segment->sealed = 1;
+}
+
+/**
+ * Frees a segment that has been pushed out of the index
+*/
+void freeSegment(SearchIndex* index, SearchSegment* segment) {
+    index->messages -= segment->messages;
+    free(segment->table);
+    free(segment->terms);
+    free(segment->text);
+    free(segment->hits);
+    free(segment->postings);
+    free(segment);
+}
+
+/**
+ * Decodes the messages a term appears in, in order, and returns how many there are
+*/
+int termMessages(SearchSegment* segment, int number, unsigned short* messages) {
+    SearchTerm* entry = &segment->terms[number];
+    if (!segment->sealed) {
+        // the chain runs newest first, so fill in from the back
+        unsigned int hit = entry->head;
+        for (int i = entry->count - 1; i >= 0; i--, hit = segment->hits[hit].previous)
+            messages[i] = (unsigned short)segment->hits[hit].message;
+        return entry->count;
+    }
+    const char* read = segment->postings + entry->offset;
+    const char* end = segment->postings + segment->terms[number + 1].offset;
+    int count = 0;
+    long long message = -1;
+    while (read < end) {
+        unsigned long long gap;
+        read += getVarint(read, &gap);
+        message += gap;
+        messages[count++] = (unsigned short)message;
+    }
+    return count;
+}
+
+/**
+ * Finds the messages of a segment that hold every term of the query and
+ * leaves them in candidates, in order. The rarest term picks the candidates
+ * and each other term in turn only keeps the ones it also appears in
+*/
+int matchSegment(SearchIndex* index, SearchSegment* segment, SearchQuery* query) {
+    int numbers[SEARCH_MAX_TERMS];
+    for (int i = 0; i < query->count; i++) {
+        int length = strlen(query->terms[i]);
+        numbers[i] = findTerm(segment, query->terms[i], length, hashTerm(query->terms[i], length));
+        if (numbers[i] < 0) return 0;
+        for (int j = i; j > 0 && segment->terms[numbers[j]].count < segment->terms[numbers[j - 1]].count; j--) {
+            int swap = numbers[j];
+            numbers[j] = numbers[j - 1];
+            numbers[j - 1] = swap;
+        }
+    }
+
+    // a message is marked base + i once the first i + 1 terms are all in it
+    if (index->stamp > 0xFFFFFFFFu - 2 * SEARCH_MAX_TERMS) {
+        memset(index->marks, 0, sizeof(index->marks));
+        index->stamp = 0;
+    }
+    unsigned int base = index->stamp + 1;
+    index->stamp += SEARCH_MAX_TERMS;
+    int count = termMessages(segment, numbers[0], index->candidates);
+    for (int i = 0; i < count; i++) index->marks[index->candidates[i]] = base;
+    for (int i = 1; i < query->count; i++) {
+        int found = termMessages(segment, numbers[i], index->postings);
+        for (int j = 0; j < found; j++)
+            if (index->marks[index->postings[j]] == base + i - 1) index->marks[index->postings[j]] = base + i;
+    }
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+        if (index->marks[index->candidates[i]] == base + query->count - 1) index->candidates[kept++] = index->candidates[i];
+    return kept;
+}
+
+/**
+ * Runs a query against every message with an id of at least oldest. Up to
+ * max of the newest matches are put in results, newest first, and the
+ * number of matches overall is returned
+*/
+long long searchIndex(SearchIndex* index, SearchQuery* query, long long oldest, SearchResult* results, int max) {
+    // find the newest segment, then walk back through the ring from it
+    long long newest = -1;
+    for (int i = 0; i < index->slots; i++)
+        if (index->segments[i] != NULL && index->segments[i]->first > newest) newest = index->segments[i]->first;
+    if (newest < 0) return 0;
+
+    long long total = 0;
+    int found = 0;
+    for (long long first = newest; first >= 0; first -= SEARCH_SEGMENT_SIZE) {
+        SearchSegment* segment = index->segments[(first / SEARCH_SEGMENT_SIZE) % index->slots];
+        if (segment == NULL || segment->first != first) break;
+        if (first + segment->messages <= oldest) break;
+        if (query->since > 0 && segment->times[segment->messages - 1] < query->since) break;
+
+        // with no terms every message is a candidate
+        int count = query->count > 0 ? matchSegment(index, segment, query) : segment->messages;
+        for (int i = count - 1; i >= 0; i--) {
+            int message = query->count > 0 ? index->candidates[i] : i;
+            if (first + message < oldest || segment->times[message] < query->since) continue;
+            if (found < max) {
+                results[found].id = first + message;
+                results[found].time = segment->times[message];
+                found++;
+            }
+            total++;
+        }
+    }
+    return total;
+}
+
+/**
+ * Adds up how many bytes the index is holding on to
+*/
+long long searchMemory(SearchIndex* index) {
+    long long bytes = sizeof(SearchIndex) + index->slots * sizeof(SearchSegment*);
+    for (int i = 0; i < index->slots; i++) {
+        SearchSegment* segment = index->segments[i];
+        if (segment == NULL) continue;
+        bytes += sizeof(SearchSegment) + segment->tableSize * sizeof(int) + segment->termSize * sizeof(SearchTerm) +
+            segment->textSize + segment->hitSize * sizeof(SearchHit) + segment->postingBytes;
+    }
+    return bytes;
+}
+
+/**
+ * Adds a term to a query the same way messages are broken into terms.
+ * A prefix of '@' makes it a user's name instead of words
+*/
+void addQueryTerm(SearchQuery* query, char prefix, const char* text, int length) {
+    const char* end = text + length;
+    if (prefix != '\0') {
+        if (query->count == SEARCH_MAX_TERMS || length == 0) return;
+        if (length > SEARCH_TERM_SIZE - 1) length = SEARCH_TERM_SIZE - 1;
+        char* term = query->terms[query->count++];
+        term[0] = prefix;
+        for (int i = 0; i < length; i++) term[i + 1] = (char)tolower((unsigned char)text[i]);
+        term[length + 1] = '\0';
+        return;
+    }
+    char term[SEARCH_TERM_SIZE + 1];
+    int termLength;
+    while (query->count < SEARCH_MAX_TERMS && (termLength = nextTerm(&text, end, term)) > 0) {
+        memcpy(query->terms[query->count], term, termLength);
+        query->terms[query->count][termLength] = '\0';
+        query->count++;
+    }
+}
+
+/**
+ * Builds a query from a command's arguments. Plain arguments are words,
+ * user:<name> only matches that user's chats and since:<age> only matches
+ * chats newer than the age, given as a number with s, m, h or d after it.
+ * Returns 0 on success and -1 if an age couldn't be read
+*/
+int parseQuery(SearchQuery* query, char** args, int numargs, long long now) {
+    memset(query, 0, sizeof(SearchQuery));
+    for (int i = 0; i < numargs; i++) {
+        if (strncmp(args[i], "user:", 5) == 0) {
+            addQueryTerm(query, '@', args[i] + 5, strlen(args[i] + 5));
+        } else if (strncmp(args[i], "since:", 6) == 0) {
+            char* unit;
+            long long age = strtoll(args[i] + 6, &unit, 10);
+            if (unit == args[i] + 6 || age < 0) return -1;
+            if (*unit == 'm') age *= 60;
+            else if (*unit == 'h') age *= 3600;
+            else if (*unit == 'd') age *= 86400;
+            else if (*unit != 's' && *unit != '\0') return -1;
+            query->since = now - age;
+        } else {
+            addQueryTerm(query, '\0', args[i], strlen(args[i]));
+        }
+    }
+    return 0;
+}
+
+#endif
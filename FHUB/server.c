@@ -1,7 +1,7 @@
 /**
  * server.c - a program to take in client connections and manage them
  * author: Jason Heflinger
- * last modified: 6-8-2023
+ * last modified: 10-18-2026
 */
 
 // defines
@@ -13,23 +13,182 @@
 #define PACKET_SIZE           4096
 #define BUFFER_SIZE           2048
 #define MAX_USERS             10
+#define CHAT_MESSAGE_RATE     10
+#define CHAT_BYTE_RATE        16384
+#define FILE_MESSAGE_RATE     5
+#define FILE_BYTE_RATE        4194304
+#define BURST_SECONDS         2
+#define MAX_THROTTLE_DELAY    250000
+#define FLOOD_STRIKES         50
+#define COALESCE_WINDOW       2000
+#define MAX_COALESCE_WINDOW   20000
+#define FLUSH_THRESHOLD       65536
+#define MAX_ARGS              16
+#define MAX_SEARCH_RESULTS    20
+#define ZERO_COPY_THRESHOLD   65536
+#define RING_ENTRIES          64
+#define TRANSFER_RING_ENTRIES 8
+#define HASH_CACHE_FILE       ".fhub_hashes"
+#define HASH_WORKERS          2
+#define MAX_BLOCKS_SHOWN      16
+#define NOTIFY_WINDOW         100000
+#define MAX_WORKERS           16
+#define HANDOFF_DRAIN         100
+#define HANDOFF_TIMEOUT       5000
+#define VERSION_SIZE          64
+#define BULK_LATENCY          5000
+#define MIN_CHUNK             4096
 #define TRUE                  1
 #define FALSE                 0
 
 // third party includes
-#include <ws2tcpip.h>
 #include <sys/stat.h>
-#include <direct.h>
 #include <dirent.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+#endif
 
 // custom includes
+#include "platform.h"
 #include "utils.h"
+#include "ratelimit.h"
+#include "protocol.h"
+#include "packetpool.h"
+#include "outqueue.h"
+#include "fileops.h"
+#include "tarstream.h"
+#include "workdir.h"
+#include "uring.h"
+#include "trace.h"
+#include "search.h"
+#include "hashcache.h"
+#include "manifest.h"
+#include "diskusage.h"
+#include "watch.h"
+#include "notify.h"
+#include "bus.h"
+#include "locallink.h"
+#ifdef FHUB_ZLIB
+#include <zlib.h>
+#endif
+
+// per client connection state, including the buckets used to rate
+// limit their chat and file traffic and the directory they're watching
+typedef struct {
+    int         socket;
+    int         slot;
+    int         active;
+    unsigned long long id;
+    TokenBucket chatMessages;
+    TokenBucket chatBytes;
+    TokenBucket fileMessages;
+    TokenBucket fileBytes;
+    long long   packets;
+    long long   bytes;
+    long long   delayed;
+    long long   dropped;
+    int         strikes;
+    long long   throttle;
+    OutQueue    output;
+    long long   framesSent;
+    long long   sendCalls;
+    int         bulk;
+    int         flushing;
+    WorkDir     dir;
+    int         subscribed;
+    char        watching[MAX_PATH_SIZE];
+    pthread_t   thread;
+    FrameReader* carried;
+#ifdef __linux__
+    LocalLink*  link;
+#endif
+} Session;
+
+// another process serving the same port, as seen from the first one.
+// clients it hands off come back over its bus
+#ifdef __linux__
+typedef struct {
+    pid_t       pid;
+    int         bus;
+    long long   chats;
+    long long   adopted;
+} Worker;
+#endif
+
+// a stream of a directory being sent to a client, either as a tar of the
+// whole tree, a tar of the files named in names, or a manifest of the
+// tree. small entries are gathered in the staging buffer so many of them
+// share one frame, while a manifest is built up in records first. frames
+// are cut at chunk bytes, which shrinks while the client is slow to take
+// them so chat never waits long behind one. fd is a handle to what's at
+// path, opened beneath the root, and everything streamed is looked up from
+// it without following symlinks, so none of it can come from outside the root
+typedef struct {
+    int         kind;
+    int         fd;
+    int         socket;
+    int         slot;
+    int         chunk;
+    unsigned long long owner;
+    int         compress;
+    int         broken;
+    int         used;
+    long long   files;
+    long long   failed;
+    long long   bytes;
+    char        path[MAX_PATH_SIZE];
+    char*       names;
+    char*       records;
+    long long   recordsUsed;
+    long long   recordsSize;
+    unsigned long long digest;
+    char        version[VERSION_SIZE];
+    char        stage[MAX_PAYLOAD_SIZE];
+#ifdef __linux__
+    Ring*       ring;
+    char*       ahead;
+    LocalLink*  link;
+#endif
+#ifdef FHUB_ZLIB
+    z_stream    deflater;
+    char        compressed[MAX_PAYLOAD_SIZE];
+#endif
+} ArchiveStream;
 
 // global variables
-char g_chatLog[MAX_LOGS][PACKET_SIZE]  = { 0 };
+Packet* g_chatLog[MAX_LOGS]            = { 0 };
 int  g_clients[MAX_USERS]              = { 0 };
 char g_buffer[BUFFER_SIZE]             = { 0 };
-char g_relativePath[MAX_PATH_SIZE]     = { 0 };
+WorkDir g_adminDir                     = { { 0 }, -1 };
+Session g_sessions[MAX_USERS]          = { 0 };
+double g_chatMessageRate               = CHAT_MESSAGE_RATE;
+double g_chatByteRate                  = CHAT_BYTE_RATE;
+double g_fileMessageRate               = FILE_MESSAGE_RATE;
+double g_fileByteRate                  = FILE_BYTE_RATE;
+long long g_coalesceWindow             = COALESCE_WINDOW;
+long long g_batchStart                 =   0  ;
+long long g_pendingBytes               =   0  ;
+long long g_framesSent                 =   0  ;
+long long g_sendCalls                  =   0  ;
+int  g_pendingFrames                   =   0  ;
+long long g_ioCalls                    =   0  ;
+long long g_bytesIn                    =   0  ;
+long long g_bytesOut                   =   0  ;
+pthread_mutex_t g_outputLock           = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  g_outputReady          = PTHREAD_COND_INITIALIZER;
+pthread_mutex_t g_chatLock             = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t g_clientLock           = PTHREAD_MUTEX_INITIALIZER;
+PacketPool g_packetPool;
+pthread_mutex_t g_sendLocks[MAX_USERS];
 int  g_logIndex                        =   0  ; 
 int  g_clientIndex                     =   0  ;
 int  g_port                            =   0  ;
@@ -38,45 +197,234 @@ int  g_socket                          =   0  ;
 int  g_monitor                         =   0  ;
 int  g_shutdown                        =   0  ;
 int  g_talkEnabled                     =   0  ;
+int  g_rootFd                          =  -1  ;
+int  g_backend                         =   0  ;
+int  g_tracing                         =   0  ;
+unsigned long long g_connections       =   0  ;
+char g_tracePath[MAX_PATH_SIZE]        = { 0 };
+TraceWriter g_trace;
+SearchIndex g_searchIndex;
+HashCache g_hashCache;
+UsageTree g_usage;
+#ifdef __linux__
+Watcher g_watcher;
+ChangeSet g_changes;
+int  g_watching                        =   0  ;
+long long g_notifications              =   0  ;
+long long g_versionChecks              =   0  ;
+long long g_notModified                =   0  ;
+long long g_preempted                  =   0  ;
+pthread_mutex_t g_watchLock            = PTHREAD_MUTEX_INITIALIZER;
+Worker g_workers[MAX_WORKERS]          = { 0 };
+LocalLink g_links[MAX_USERS];
+int  g_localSocket                     =  -1  ;
+long long g_localClients               =   0  ;
+#endif
+int  g_workerCount                     =   1  ;
+int  g_workerIndex                     =   0  ;
+int  g_bus                             =  -1  ;
+volatile int g_handingOff              =   0  ;
+long long g_chatsShared                =   0  ;
+pthread_rwlock_t g_traceLock           = PTHREAD_RWLOCK_INITIALIZER;
 
 // helper enum to describe packets
 enum PACKET_TYPE {
     CHAT = 'c',
-    SHUTDOWN = 's'
+    SHUTDOWN = 's',
+    COMMAND = 'm',
+    RESPONSE = 'r',
+    ARCHIVE_START = 'b',
+    ARCHIVE = 'a',
+    ARCHIVE_END = 'e',
+    MANIFEST = 'f',
+    MANIFEST_END = 'g',
+    NOTIFY = 'n',
+    CACHED_START = 'v',
+    CACHED = 'd',
+    CACHED_END = 'k',
+    UNCHANGED = 'u'
+};
+
+// what an ArchiveStream sends
+enum STREAM_KIND {
+    STREAM_DIRECTORY = 0,
+    STREAM_FILES     = 1,
+    STREAM_MANIFEST  = 2,
+    STREAM_LISTING   = 3,
+    STREAM_CONTENT   = 4
+};
+
+// outcomes of running a packet through the rate limiter
+enum ADMISSION {
+    ADMITTED = 0,
+    DROPPED  = 1,
+    FLOODED  = 2,
+    DEFERRED = 3
+};
+
+// what a client's connection should do after its frames are handled
+enum CLIENT_STATE {
+    CLIENT_OK      = 0,
+    CLIENT_WAITING = 1,
+    CLIENT_CLOSED  = 2
+};
+
+// ways the server can drive its sockets and files
+enum IO_BACKEND {
+    BACKEND_THREADS = 0,
+    BACKEND_URING   = 1
+};
+
+// operations the event loop can have in flight on its ring
+enum RING_OP {
+    RING_ACCEPT = 0,
+    RING_RECV   = 1,
+    RING_RESUME = 2
 };
 
 // function declarations
 void  initialize(void);
 void  hostConnection(void);
 void  disconnect(void);
-void  handleInput(void);
-void  handleClient(int socket_fd);
-void  addUser(int socket_fd);
-void  addChat(char* chat);
-void  handlePacket(char* buf, int socket_fd);
+void* handleInput(void* arg);
+void* handleClient(void* arg);
+int   handleFrames(Session* session, int socket_fd, FrameReader* reader, int canWait);
+int   serveRing(int server_fd);
+void  countIo(long long calls, long long received, long long sent);
+void  startTrace(char* path);
+void  stopTrace(void);
+void  recordTrace(int kind, Session* session, char type, char* payload, unsigned int length);
+Session* addUser(int socket_fd);
+void  addChat(Packet* chat);
+void  searchChat(Session* session, char** args, int numargs);
+void  formatAge(long long seconds, char* age);
+void  hashItem(Session* session, char* name, int blocks);
+void  hashFinished(HashRequest* request, HashResult* result);
+void  printHash(Session* session, char* path, HashResult* result);
+void  watchDirectory(Session* session, char* directory);
+void  showUsage(Session* session, char* name);
+void  setDirectoryQuota(char** args, int numargs);
+int   fitsQuota(char* target, char* source, char* from);
+char* rootRelative(char* path);
+#ifdef __linux__
+void  fileChanged(void* context, int change, const char* path, int directory);
+void* watchRoot(void* arg);
+void  pushChanges(void);
+void  sendNotification(Session* session, char* text, int length);
+int   spawnWorker(int index);
+void* runBus(void* arg);
+void* runWorkerBus(void* arg);
+void  handleBus(int from, char type, char* data, int length, int passed);
+void  adoptClient(int from, char* data, int length, int passed);
+void  drainWorker(void);
+void  handOff(Session* session, int socket_fd, FrameReader* reader);
+void  interruptClient(int signal);
+void* acceptLocalClients(void* arg);
+#endif
+void  startWorkers(void);
+void  shareChat(Packet* packet, int from);
+void  listWorkers(void);
+void  replaceWorker(char* index);
+void  handlePacket(Packet* packet, int socket_fd);
 int   compareCommand(char* buffer, char* command, char* shortcut);
 void  disconnectClient(int socket_fd);
-void  listDirectory(void);
+void  listDirectory(Session* session);
 void  readFile(char* arg);
 int   confirmArgs(int numArgs, int desiredArgs);
 void  createItem(char* flag, char* name);
-void  changeDirectory(char* directory);
-void  getWorkingDir(char* path);
+int   changeDirectory(Session* session, char* directory);
+void  getWorkingDir(WorkDir* dir, char* path);
+WorkDir* workDirOf(Session* session);
+int   rootFd(void);
+int   openItem(WorkDir* dir, char* name, int flags, int mode);
+int   directoryExists(WorkDir* dir, char* name);
+int   openParent(char* path, int* dir, char** name);
+void  report(Session* session, int color, char* format, ...);
+Session* openSession(int socket_fd);
+void  closeSession(int socket_fd);
+void  resetBuckets(Session* session);
+Session* findSession(int socket_fd);
+int   admitPacket(Session* session, char* packet, int length, int canWait);
+void  setRateLimit(char* type, char* messages, char* bytes);
+void  printStats(void);
+void  broadcastPacket(Packet* packet);
+void* flushOutput(void* arg);
+#ifdef __linux__
+long long flushRing(Ring* ring, OutQueue* batches, int* slots, int* sockets, int* sent, long long* calls, int count);
+int   archiveRead(ArchiveStream* stream, int file, long long size);
+#endif
+void  setCoalesceWindow(char* micros);
+int   resolvePath(char* relative, char* name, char* path);
+int   resolveTarget(WorkDir* dir, char* source, char* name, char* target);
+int   isInside(char* path, char* parent);
+void  copyItem(char* from, char* to);
+void  moveItem(char* from, char* to);
+void  renameItem(char* item, char* name);
+int   tokenize(char* command, char** args, int maxArgs);
+void  handleCommand(Session* session, char* text);
+void  respond(Session* session, char* format, ...);
+void  unicastPacket(Session* session, Packet* packet);
+void  sendDirectory(Session* session, char* directory, int compress);
+void  sendFiles(Session* session, char* request);
+void  sendManifest(Session* session, char* directory, char* digest);
+void  sendCached(Session* session, int kind, char* name, char* version);
+void  formatVersion(struct stat* info, char* version);
+ArchiveStream* openStream(Session* session, int kind, char* directory, int compress);
+void  startStream(Session* session, ArchiveStream* stream);
+void  runStream(ArchiveStream* stream);
+void  closeStream(ArchiveStream* stream);
+void  streamDirectory(ArchiveStream* stream);
+void  streamManifest(ArchiveStream* stream);
+void  manifestEntry(ArchiveStream* stream, int at, char* item, char* name);
+void  streamListing(ArchiveStream* stream);
+void  streamContent(ArchiveStream* stream);
+void* runTransfer(void* arg);
+void  archiveEntry(ArchiveStream* stream, int at, char* item, char* name);
+void  archiveFile(ArchiveStream* stream, int file, char* name, struct stat* info);
+void  archiveWrite(ArchiveStream* stream, const char* data, int length);
+void  archiveFlush(ArchiveStream* stream, int finish);
+int   sendArchiveFrame(ArchiveStream* stream, char type, const char* data, int length);
+int   beginBulk(ArchiveStream* stream, long long* calls);
+void  endBulk(ArchiveStream* stream, int urgent, long long calls, long long start, int length);
 
 /**
  * prints out non blocking using intermediate input buffer
 */
 #define ASYNC_PRINT(...) do { for (int i = 0; i < strlen(g_buffer); i++) printf("\b \b"); printf(__VA_ARGS__); printf("%s", g_buffer); } while (0)
 
+// the benchmarks include this file and bring their own main
+#ifndef FHUB_BENCH
 /**
  * Main function that handles program flow. 
 */
 int main(int argc, char *argv[]) {
+    char* tracePath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--uring") == 0) g_backend = BACKEND_URING;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) tracePath = argv[++i];
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) g_workerCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--worker") == 0 && i + 3 < argc) {
+            // how the first process starts the others, never typed by hand
+            g_workerIndex = atoi(argv[++i]);
+            g_bus = atoi(argv[++i]);
+            g_port = atoi(argv[++i]);
+        }
+    }
+    if (g_workerCount < 1) g_workerCount = 1;
+    if (g_workerCount > MAX_WORKERS) g_workerCount = MAX_WORKERS;
+    if (g_workerCount > 1 && g_backend == BACKEND_URING) {
+        setTextColor(YELLOW);
+        printf("WARNING: workers hand clients between threads, so io_uring is not used with them\n");
+        resetText();
+        g_backend = BACKEND_THREADS;
+    }
     initialize();
+    if (tracePath != NULL) startTrace(tracePath);
     hostConnection();
     disconnect();
     return 0; 
 }
+#endif
 
 /**
  * initializes critical data to run the program, including user
@@ -99,15 +447,17 @@ void initialize() {
         exit(2);
     }
 
-    // get port from user
-    printf("What port will you be hosting on? (enter for default %s)\n", DEFAULT_PORT);
-    char portStr[7];
-    getInput(portStr, 7);
+    // get port from user, unless this is a worker started by the first process
+    char portStr[7] = { 0 };
+    if (g_workerIndex == 0) {
+        printf("What port will you be hosting on? (enter for default %s)\n", DEFAULT_PORT);
+        getInput(portStr, 7);
 
-    // validate and set to default port if needed
-    if (portStr[0] == '\0')
-        memcpy(portStr, DEFAULT_PORT, 6);
-    g_port = atoi(portStr);
+        // validate and set to default port if needed
+        if (portStr[0] == '\0')
+            memcpy(portStr, DEFAULT_PORT, 6);
+        g_port = atoi(portStr);
+    }
     if (g_port <= 1024) {
         setTextColor(YELLOW);
         printf("WARNING: Indicated port is either invalid or reserved. Defaulting to %s\n", DEFAULT_PORT);
@@ -115,6 +465,20 @@ void initialize() {
         g_port = atoi(DEFAULT_PORT);
     }
 
+    initPacketPool(&g_packetPool);
+    initSearchIndex(&g_searchIndex, MAX_LOGS);
+
+    // workers keep their own hash cache so they never write over each other's
+    char hashFile[64] = HASH_CACHE_FILE;
+    if (g_workerIndex > 0) snprintf(hashFile, sizeof(hashFile), "%s.%d", HASH_CACHE_FILE, g_workerIndex);
+    if (initHashCache(&g_hashCache, hashFile, HASH_WORKERS, hashFinished) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> Failed to start hashing threads.\n");
+        resetText();
+        exit(9);
+    }
+    for (int i = 0; i < MAX_USERS; i++)
+        pthread_mutex_init(&g_sendLocks[i], NULL);
     g_initialized = TRUE;
 }
 
@@ -143,7 +507,6 @@ void hostConnection() {
         resetText();
         exit(4);
     }
-    ioctlsocket(server_fd, FIONBIO, 1);
     g_socket = server_fd;
 
     // Forcefully attaching socket to the desired port
@@ -153,6 +516,16 @@ void hostConnection() {
         resetText();
         exit(5);
     }
+#ifdef __linux__
+    // every worker binds the port itself and the kernel spreads new
+    // connections across them
+    if ((g_workerCount > 1 || g_workerIndex > 0) && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+        setTextColor(RED);
+        printf("ERROR   >> failed to share the port between workers");
+        resetText();
+        exit(5);
+    }
+#endif
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(g_port);
@@ -171,22 +544,77 @@ void hostConnection() {
         exit(7);
     }
     setTextColor(GREEN);
-    printf("Server initialized! Now listening on port %d\n", g_port);
+    if (g_workerIndex > 0) printf("Worker %d initialized! Now listening on port %d\n", g_workerIndex, g_port);
+    else printf("Server initialized! Now listening on port %d\n", g_port);
     resetText();
+    startWorkers();
+
+    // start output thread that coalesces writes to clients
+    pthread_t outputThread;
+    if (pthread_create(&outputThread, NULL, flushOutput, NULL) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> Failed to create output thread.\n");
+        resetText();
+        exit(8);
+    }
+
+    // watch the root so cached hashes are dropped as soon as files change,
+    // then count it up. changes made during the count are applied after it
+    initUsage(&g_usage, ROOT_DIR);
+#ifdef __linux__
+    pthread_t watchThread;
+    if (initWatcher(&g_watcher, ROOT_DIR) != 0 || pthread_create(&watchThread, NULL, watchRoot, NULL) != 0) {
+        setTextColor(YELLOW);
+        printf("WARNING: could not watch the root directory. Cached hashes will be checked against file times only\n");
+        resetText();
+    } else {
+        g_watching = TRUE;
+    }
+#endif
+    refreshUsage(&g_usage, "", TRUE);
 
-    // start input thread
-    HANDLE inputThread;
-    inputThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)handleInput, NULL, 0, NULL);
-    if (inputThread == NULL) {
+    // start input thread, which only the first process has
+    pthread_t inputThread;
+    if (g_workerIndex == 0 && pthread_create(&inputThread, NULL, handleInput, NULL) != 0) {
         setTextColor(RED);
         printf("ERROR   >> Failed to create new input thread.\n");
         resetText();
     }
 
+    // hand the sockets over to the ring if asked to, falling back to
+    // a thread per client if the kernel doesn't support it
+    if (g_backend == BACKEND_URING) {
+        if (serveRing(server_fd)) return;
+        setTextColor(YELLOW);
+        printf("WARNING: io_uring is unavailable. Falling back to a thread per client\n");
+        resetText();
+        g_backend = BACKEND_THREADS;
+    }
+
+    // take clients on this machine through shared memory as well. the
+    // first process is the only one that can't be handed off, so it
+    // holds every local client
+#ifdef __linux__
+    pthread_t localThread;
+    if (g_workerIndex == 0 && (g_localSocket = listenLocal(g_port)) >= 0) {
+        if (pthread_create(&localThread, NULL, acceptLocalClients, NULL) != 0) {
+            setTextColor(RED);
+            printf("ERROR   >> Failed to create local client thread.\n");
+            resetText();
+            close(g_localSocket);
+            g_localSocket = -1;
+        } else {
+            pthread_detach(localThread);
+        }
+    }
+#endif
+
     // accept and handle clients
     while (!g_shutdown) {
         int client_socket;
+        countIo(1, 0, 0);
         if ((client_socket = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen)) < 0) {
+            if (g_handingOff) break;
             setTextColor(RED);
             printf("ERROR   >> failed to accept\n");
             resetText();
@@ -195,17 +623,25 @@ void hostConnection() {
             setTextColor(GREEN);
             if (g_monitor) ASYNC_PRINT("MONITOR >> New client connected\n");
             resetText();
-            HANDLE clientThread;
-            clientThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)handleClient, client_socket, 0, NULL);
-            if (clientThread == NULL) {
+            if (addUser(client_socket) == NULL) {
+                if (g_monitor) ASYNC_PRINT("MONITOR >> server is full, turned a client away\n");
+                close(client_socket);
+                continue;
+            }
+            pthread_t clientThread;
+            if (pthread_create(&clientThread, NULL, handleClient, (void*)(intptr_t)client_socket) != 0) {
                 setTextColor(RED);
                 printf("ERROR   >> Failed to create new client thread.\n");
                 resetText();
+                disconnectClient(client_socket);
                 continue;
             }
-            addUser(client_socket);
+            pthread_detach(clientThread);
         }
     }
+
+    // a worker being replaced stays up until its clients have moved
+    while (g_handingOff) sleepMicros(1000000);
 }
 
 /**
@@ -216,43 +652,472 @@ void disconnect() {
     setTextColor(YELLOW);
     printf("SERVER  >> Shutting down...\n");
     resetText();
+    if (g_tracing) stopTrace();
     close(g_socket);
     for (int i = 0; i < g_clientIndex; i++)
         close(g_clients[i]);
     exit(0);
 }
 
+/**
+ * starts the other workers when the server is run with more than one,
+ * along with the thread that passes messages between them. a worker
+ * itself just starts listening to its bus
+*/
+void startWorkers() {
+#ifdef __linux__
+    pthread_t busThread;
+    if (g_workerIndex > 0) {
+        // client threads are poked with this to wake them out of recv
+        // when the worker hands them off
+        struct sigaction action = { 0 };
+        action.sa_handler = interruptClient;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGUSR2, &action, NULL);
+        if (pthread_create(&busThread, NULL, runWorkerBus, NULL) != 0) {
+            setTextColor(RED);
+            printf("ERROR   >> Failed to create bus thread.\n");
+            resetText();
+            exit(8);
+        }
+        return;
+    }
+    if (g_workerCount == 1) return;
+    for (int i = 0; i < MAX_WORKERS; i++) g_workers[i].bus = -1;
+    for (int i = 1; i < g_workerCount; i++) {
+        if (!spawnWorker(i)) {
+            setTextColor(RED);
+            printf("ERROR   >> Failed to start worker %d.\n", i);
+            resetText();
+        }
+    }
+    if (pthread_create(&busThread, NULL, runBus, NULL) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> Failed to create bus thread.\n");
+        resetText();
+        exit(8);
+    }
+#else
+    if (g_workerCount > 1) {
+        setTextColor(YELLOW);
+        printf("WARNING: workers are only supported on linux. Running as a single process\n");
+        resetText();
+        g_workerCount = 1;
+    }
+#endif
+}
+
+/**
+ * passes a chat on to the other workers so their clients see it too.
+ * workers send theirs to the first process, which sends them on to
+ * every worker but the one it came from
+*/
+void shareChat(Packet* packet, int from) {
+#ifdef __linux__
+    if (g_workerIndex > 0) {
+        sendBus(g_bus, BUS_CHAT, packetPayload(packet), payloadLength(packet), -1);
+        return;
+    }
+    for (int i = 1; i < g_workerCount; i++) {
+        if (i == from || g_workers[i].bus < 0) continue;
+        if (sendBus(g_workers[i].bus, BUS_CHAT, packetPayload(packet), payloadLength(packet), -1) == 0) g_chatsShared++;
+    }
+#endif
+}
+
+/**
+ * lists the workers sharing the port and what has gone between them
+*/
+void listWorkers() {
+    if (g_workerCount == 1) {
+        printf("SERVER  >> running as a single process (start with --workers <n> for more)\n");
+        return;
+    }
+#ifdef __linux__
+    printf("\n\t%-8s %-10s %-10s %-10s\n", "WORKER", "PID", "CHATS", "ADOPTED");
+    printf("\t%-8d %-10d %-10s %-10s\n", 0, (int)getpid(), "-", "-");
+    for (int i = 1; i < g_workerCount; i++) {
+        if (g_workers[i].bus < 0) printf("\t%-8d %-10s\n", i, "stopped");
+        else printf("\t%-8d %-10d %-10lld %-10lld\n", i, (int)g_workers[i].pid, g_workers[i].chats, g_workers[i].adopted);
+    }
+    printf("\n");
+#endif
+}
+
+/**
+ * asks a worker to hand its clients over to the first process and exit,
+ * after which a new worker is started in its place
+*/
+void replaceWorker(char* index) {
+#ifdef __linux__
+    int worker = atoi(index);
+    if (worker < 1 || worker >= g_workerCount || g_workers[worker].bus < 0) {
+        setTextColor(RED);
+        printf("ERROR   >> there is no worker %s to hand off (the first process can't be replaced)\n", index);
+        resetText();
+        return;
+    }
+    if (sendBus(g_workers[worker].bus, BUS_DRAIN, NULL, 0, -1) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> worker %d could not be reached\n", worker);
+        resetText();
+        return;
+    }
+    printf("SERVER  >> worker %d is handing its clients off\n", worker);
+#else
+    setTextColor(RED);
+    printf("ERROR   >> there are no workers to hand off\n");
+    resetText();
+#endif
+}
+
+#ifdef __linux__
+/**
+ * starts a worker as a fresh copy of this program with a bus back to
+ * this process. Returns TRUE if it was started
+*/
+int spawnWorker(int index) {
+    int ends[2];
+    if (openBus(ends) != 0) return FALSE;
+    fcntl(ends[0], F_SETFD, FD_CLOEXEC);
+    char indexText[16], busText[16], portText[16];
+    snprintf(indexText, sizeof(indexText), "%d", index);
+    snprintf(busText, sizeof(busText), "%d", ends[1]);
+    snprintf(portText, sizeof(portText), "%d", g_port);
+    struct rlimit limit;
+    int maxFd = getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < 65536 ? (int)limit.rlim_cur : 65536;
+    int devnull = open("/dev/null", O_RDONLY);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // only the bus and the console go along, so the worker never
+        // holds on to this process's clients or files
+        if (devnull >= 0) dup2(devnull, 0);
+        for (int fd = 3; fd < maxFd; fd++)
+            if (fd != ends[1]) close(fd);
+        execl("/proc/self/exe", "FHUB_server", "--worker", indexText, busText, portText, (char*)NULL);
+        _exit(127);
+    }
+    if (devnull >= 0) close(devnull);
+    close(ends[1]);
+    if (pid < 0) {
+        close(ends[0]);
+        g_workers[index].bus = -1;
+        return FALSE;
+    }
+    g_workers[index].pid = pid;
+    g_workers[index].bus = ends[0];
+    g_workers[index].chats = 0;
+    g_workers[index].adopted = 0;
+    return TRUE;
+}
+
+/**
+ * waits on every worker's bus in the first process, restarting any
+ * worker that goes away while the server is still up
+*/
+void* runBus(void* arg) {
+    char* message = malloc(BUS_MESSAGE_SIZE);
+    while (!g_shutdown) {
+        struct pollfd polled[MAX_WORKERS];
+        int owners[MAX_WORKERS];
+        int count = 0;
+        for (int i = 1; i < g_workerCount; i++) {
+            if (g_workers[i].bus < 0) continue;
+            polled[count].fd = g_workers[i].bus;
+            polled[count].events = POLLIN;
+            polled[count].revents = 0;
+            owners[count++] = i;
+        }
+        if (count == 0) break;
+        if (poll(polled, count, -1) < 0) continue;
+
+        for (int i = 0; i < count; i++) {
+            if (polled[i].revents == 0) continue;
+            Worker* worker = &g_workers[owners[i]];
+            char type;
+            int passed;
+            int length = receiveBus(worker->bus, &type, message, BUS_MESSAGE_SIZE, &passed);
+            if (length >= 0) {
+                handleBus(owners[i], type, message, length, passed);
+                continue;
+            }
+
+            // the worker has exited, so put a new one in its place
+            close(worker->bus);
+            worker->bus = -1;
+            waitpid(worker->pid, NULL, 0);
+            if (g_shutdown) continue;
+            if (spawnWorker(owners[i])) {
+                setTextColor(YELLOW);
+                ASYNC_PRINT("SERVER  >> worker %d was replaced (pid %d)\n", owners[i], (int)worker->pid);
+                resetText();
+            } else {
+                setTextColor(RED);
+                ASYNC_PRINT("ERROR   >> Failed to restart worker %d.\n", owners[i]);
+                resetText();
+            }
+        }
+    }
+    free(message);
+    return NULL;
+}
+
+/**
+ * waits on the bus in a worker. once the first process is gone the
+ * worker shuts down with it
+*/
+void* runWorkerBus(void* arg) {
+    char* message = malloc(BUS_MESSAGE_SIZE);
+    char type;
+    int passed, length;
+    while ((length = receiveBus(g_bus, &type, message, BUS_MESSAGE_SIZE, &passed)) >= 0)
+        handleBus(0, type, message, length, passed);
+    free(message);
+    g_shutdown = TRUE;
+    disconnect();
+    return NULL;
+}
+
+/**
+ * handles a message from the bus. from is the worker it came from in
+ * the first process, and passed is any socket that came along with it
+*/
+void handleBus(int from, char type, char* data, int length, int passed) {
+    if (type == BUS_CHAT) {
+        Packet* packet = makePacket(&g_packetPool, CHAT, data, length);
+        if (packet != NULL) {
+            addChat(packet);
+            handlePacket(packet, -1);
+            if (g_workerIndex == 0) {
+                g_workers[from].chats++;
+                shareChat(packet, from);
+            }
+            releasePacket(packet);
+        }
+    } else if (type == BUS_ADOPT && g_workerIndex == 0) {
+        adoptClient(from, data, length, passed);
+        return;
+    } else if (type == BUS_DRAIN && g_workerIndex > 0) {
+        drainWorker();
+    } else if (type == BUS_DONE && g_workerIndex == 0) {
+        setTextColor(YELLOW);
+        ASYNC_PRINT("SERVER  >> worker %d handed off %lld clients\n", from, g_workers[from].adopted);
+        resetText();
+    }
+    if (passed >= 0) close(passed);
+}
+
+/**
+ * takes over a client handed off by a worker, putting it back in the
+ * directory it was in and watching what it was watching, and handles
+ * anything it had sent that the worker hadn't gotten to yet
+*/
+void adoptClient(int from, char* data, int length, int passed) {
+    if (passed < 0) return;
+    char dir[MAX_PATH_SIZE + 1];
+    char watching[MAX_PATH_SIZE];
+    unsigned long long dirLength = 0, watchLength = 0;
+    int used = 1, read = 0;
+    int failed = length < 1 || (read = getBoundedVarint(data + used, length - used, &dirLength)) < 0 ||
+        dirLength >= MAX_PATH_SIZE || dirLength > (unsigned long long)(length - used - read);
+    if (!failed) {
+        used += read;
+        dir[0] = '/';
+        memcpy(dir + 1, data + used, dirLength);
+        dir[dirLength + 1] = '\0';
+        used += dirLength;
+        failed = (read = getBoundedVarint(data + used, length - used, &watchLength)) < 0 ||
+            watchLength >= MAX_PATH_SIZE || watchLength > (unsigned long long)(length - used - read);
+    }
+    if (!failed) {
+        used += read;
+        memcpy(watching, data + used, watchLength);
+        watching[watchLength] = '\0';
+        used += watchLength;
+        failed = length - used > READER_SIZE;
+    }
+    Session* session = failed ? NULL : addUser(passed);
+    if (session == NULL) {
+        setTextColor(YELLOW);
+        ASYNC_PRINT("SERVER  >> could not take over a client from worker %d\n", from);
+        resetText();
+        close(passed);
+        return;
+    }
+
+    if (dirLength > 0) changeDirectory(session, dir);
+    pthread_mutex_lock(&g_watchLock);
+    session->subscribed = data[0];
+    strcpy(session->watching, watching);
+    pthread_mutex_unlock(&g_watchLock);
+    if (length > used) {
+        session->carried = calloc(1, sizeof(FrameReader));
+        memcpy(session->carried->data, data + used, length - used);
+        session->carried->end = length - used;
+    }
+    g_workers[from].adopted++;
+
+    pthread_t clientThread;
+    if (pthread_create(&clientThread, NULL, handleClient, (void*)(intptr_t)passed) != 0) {
+        setTextColor(RED);
+        ASYNC_PRINT("ERROR   >> Failed to create new client thread.\n");
+        resetText();
+        free(session->carried);
+        session->carried = NULL;
+        disconnectClient(passed);
+        return;
+    }
+    pthread_detach(clientThread);
+}
+
+/**
+ * stops taking new clients and hands every connected one off to the
+ * first process, then exits once they're gone. client threads are
+ * interrupted until each of them notices and hands itself off
+*/
+void drainWorker() {
+    setTextColor(YELLOW);
+    printf("SERVER  >> worker %d is handing its clients off\n", g_workerIndex);
+    resetText();
+    g_handingOff = TRUE;
+    shutdown(g_socket, SHUT_RDWR);
+    for (int waited = 0; waited < HANDOFF_TIMEOUT; waited++) {
+        int remaining = 0;
+        for (int i = 0; i < MAX_USERS; i++) {
+            if (!g_sessions[i].active) continue;
+            remaining++;
+            if (g_sessions[i].thread != 0) pthread_kill(g_sessions[i].thread, SIGUSR2);
+        }
+        if (remaining == 0) break;
+        sleepMicros(1000);
+    }
+    sendBus(g_bus, BUS_DONE, NULL, 0, -1);
+    exit(0);
+}
+
+/**
+ * hands a client's socket to the first process along with its working
+ * directory, what it's watching and any bytes it sent that haven't been
+ * handled, then lets go of it here without closing the connection
+*/
+void handOff(Session* session, int socket_fd, FrameReader* reader) {
+    // let what's already queued for the client go out first, since
+    // it starts over with an empty queue
+    for (int i = 0; i < HANDOFF_DRAIN; i++) {
+        pthread_mutex_lock(&g_outputLock);
+        int queued = session->output.count;
+        pthread_mutex_unlock(&g_outputLock);
+        if (queued == 0) break;
+        sleepMicros(1000);
+    }
+
+    char* message = malloc(BUS_MESSAGE_SIZE);
+    int used = 0;
+    int dirLength = strlen(session->dir.relative);
+    message[used++] = (char)session->subscribed;
+    used += putVarint(message + used, dirLength);
+    memcpy(message + used, session->dir.relative, dirLength);
+    used += dirLength;
+    pthread_mutex_lock(&g_watchLock);
+    int watchLength = strlen(session->watching);
+    used += putVarint(message + used, watchLength);
+    memcpy(message + used, session->watching, watchLength);
+    used += watchLength;
+    pthread_mutex_unlock(&g_watchLock);
+    memcpy(message + used, reader->data + reader->start, reader->end - reader->start);
+    used += reader->end - reader->start;
+    if (sendBus(g_bus, BUS_ADOPT, message, used, socket_fd) != 0) {
+        setTextColor(YELLOW);
+        printf("SERVER  >> could not hand off client %d, disconnecting it\n", socket_fd);
+        resetText();
+    }
+    free(message);
+    disconnectClient(socket_fd);
+}
+
+/**
+ * takes clients connecting from this machine, giving each a link over
+ * shared memory in place of a socket. the link is in place before the
+ * session can be seen, so nothing is ever written to its unix socket
+*/
+void* acceptLocalClients(void* arg) {
+    while (!g_shutdown) {
+        LocalLink link;
+        if (acceptLocal(g_localSocket, &link) != 0) {
+            if (errno == EBADF || errno == EINVAL) break;
+            continue;
+        }
+        // the output thread could flush chats to the session's unix socket
+        // between it being claimed and its link being set, so it waits
+        pthread_mutex_lock(&g_outputLock);
+        Session* session = addUser(link.socket);
+        if (session == NULL) {
+            pthread_mutex_unlock(&g_outputLock);
+            closeLink(&link);
+            close(link.socket);
+            continue;
+        }
+        g_links[session->slot] = link;
+        session->link = &g_links[session->slot];
+        g_localClients++;
+        pthread_mutex_unlock(&g_outputLock);
+
+        setTextColor(GREEN);
+        if (g_monitor) ASYNC_PRINT("MONITOR >> New local client connected\n");
+        resetText();
+        pthread_t clientThread;
+        if (pthread_create(&clientThread, NULL, handleClient, (void*)(intptr_t)link.socket) != 0) {
+            setTextColor(RED);
+            ASYNC_PRINT("ERROR   >> Failed to create new client thread.\n");
+            resetText();
+            disconnectClient(link.socket);
+            continue;
+        }
+        pthread_detach(clientThread);
+    }
+    return NULL;
+}
+
+/**
+ * does nothing, and is only there so SIGUSR2 interrupts a client
+ * thread's recv instead of killing the worker
+*/
+void interruptClient(int signal) {
+}
+#endif
+
 /**
  * Handles user input on the server side for server admins
  * and deployers who want to manage the server in real time
 */
-void handleInput() {
+void* handleInput(void* arg) {
     while(!g_shutdown) {
         // print precursor
-        if (strlen(g_relativePath) == 0) {
+        if (strlen(g_adminDir.relative) == 0) {
             printf("R:> ");
-        } else printf("R:/%s> ", g_relativePath);
+        } else printf("R:/%s> ", g_adminDir.relative);
 
         int index = 0;
         char curr = 0;
 
-        // gather user input
+        // gather user input, sleeping in getch until each key comes in
         do {
-            if (kbhit()) { // if input is detected
-                // get the next character
-                curr = getch();
-
-                // update the input buffer and print out the typed input
-                if (curr == '\b') {
-                    g_buffer[--index] = '\0';
-                    printf("\b \b");
-                } else {
-                    g_buffer[index++] = curr;
-                    printf("%c", curr);
-                }
+            curr = getch();
+
+            // update the input buffer and print out the typed input
+            if (curr == '\b') {
+                if (index > 0) g_buffer[--index] = '\0';
+                printf("\b \b");
+            } else {
+                g_buffer[index++] = curr;
+                printf("%c", curr);
             }
         } while (curr != '\r' && curr != '\n'); //loop until carriage return or newline
 
+        // once the console is closed the server carries on without it
+        if (g_inputClosed && index == 1) break;
+
         // replace newline with string end
         for(int i = 0; i < BUFFER_SIZE; i++) {
             if (g_buffer[i] == '\n' || g_buffer[i] == '\r') {
@@ -269,40 +1134,13 @@ void handleInput() {
         // proccess command
         if(g_buffer[0] == '/') {
             printf("ADMIN   >> %s\n", g_buffer);
-            char command[strlen(g_buffer) - 1];
+            char command[BUFFER_SIZE];
+            char* args[MAX_ARGS];
 
             //parse args
             strcpy(command, g_buffer + 1);
-            while(command[strlen(command) - 1] == ' ') command[strlen(command) - 1] = '\0';
-            int numargs = 1;
-            int inquotes = FALSE;
-            for(int i = 0; i < strlen(command); i++) {
-                if (command[i] == ' ' && !inquotes)
-                    numargs++;
-                else if (command[i] == '"')
-                    inquotes = !inquotes;
-            }
-            char args[numargs][strlen(command)];
-            char arg[strlen(command)];
-            int argindex = 0;
-            int argsindex = 0;
-            inquotes = FALSE;
-            for(int i = 0; i < strlen(command); i++) {
-                if (command[i] == ' ' && !inquotes) {
-                    arg[argindex] = '\0';
-                    argindex = 0;
-                    strcpy(args[argsindex], arg);
-                    memset(arg, '\0', strlen(command));
-                    argsindex++;
-                } else if (command[i] == '"') {
-                    inquotes = !inquotes;
-                } else {
-                    arg[argindex] = command[i];
-                    argindex++;
-                }
-            }
-            arg[argindex] = '\0';
-            strcpy(args[argsindex], arg);
+            int numargs = tokenize(command, args, MAX_ARGS);
+            if (numargs == 0) args[numargs++] = command;
 
             if (compareCommand(args[0], "monitor", "m")) {
                 if (confirmArgs(numargs, 1)) {
@@ -323,18 +1161,31 @@ void handleInput() {
                     "\n\t- [/monitor]    toggles monitoring log on or off"
                     "\n\t- [/list]       lists all files in the current directory"
                     "\n\t- [/talk]       toggles chatting with connected clients"
+                    "\n\t- [/stats]      shows traffic and rate limiting counters for each client"
+                    "\n\t- [/workers]    lists the worker processes sharing the port"
                     "\n\t- [/exit]       shuts down the application and disconnects all clients"
                     "\n"
                     "\n\t- [/read] <filename>          reads a file and outputs its contents to the terminal"
                     "\n\t- [/changedir] <dir>          changes working directory to the specified directory"
                     "\n"
                     "\n\t- [/create] <flag> <name>     creates a file or directory (-f for file or -d for directory)"
+                    "\n\t- [/copy] <from> <to>         copies a file or directory"
+                    "\n\t- [/move] <from> <to>         moves a file or directory"
+                    "\n\t- [/rename] <item> <name>     renames a file or directory in place"
+                    "\n\t- [/ratelimit] <type> <msgs> <bytes>   sets per client limits per second for chat or file traffic (0 for unlimited)"
+                    "\n\t- [/coalesce] <micros>         sets how long outgoing messages are held to be batched together"
+                    "\n\t- [/trace] <file>              records every inbound packet to a trace file ([/trace] alone stops)"
+                    "\n\t- [/search] <terms> [user:<name>] [since:<age>]   searches the chat log, with ages like 30s, 10m, 2h or 1d"
+                    "\n\t- [/hash] <file> [-b]         shows the hash of a file (-b for the hash of every 1MB block too)"
+                    "\n\t- [/handoff] <worker>         replaces a worker with a new one, moving its clients over without disconnecting them"
+                    "\n\t- [/du] [dir]                  shows how many bytes and files are below a directory"
+                    "\n\t- [/quota] <dir> <bytes> [files]   limits what a directory can hold, like 10G (0 0 removes it, [/quota] alone lists them)"
                     "\n\n"
                     "\nTHANK YOU FOR USING FHUB\n\n\n");
                 }
             } else if (compareCommand(args[0], "list", "l")) {
                 if (confirmArgs(numargs, 1)) {
-                    listDirectory();
+                    listDirectory(NULL);
                 }
             } else if (compareCommand(args[0], "talk", "t")) {
                 if (confirmArgs(numargs, 1)) {
@@ -352,7 +1203,52 @@ void handleInput() {
                 }
             } else if (compareCommand(args[0], "changedir", "cd")) {
                 if (confirmArgs(numargs, 2)) {
-                    changeDirectory(args[1]);
+                    changeDirectory(NULL, args[1]);
+                }
+            } else if (compareCommand(args[0], "copy", "cp")) {
+                if (confirmArgs(numargs, 3)) {
+                    copyItem(args[1], args[2]);
+                }
+            } else if (compareCommand(args[0], "move", "mv")) {
+                if (confirmArgs(numargs, 3)) {
+                    moveItem(args[1], args[2]);
+                }
+            } else if (compareCommand(args[0], "rename", "rn")) {
+                if (confirmArgs(numargs, 3)) {
+                    renameItem(args[1], args[2]);
+                }
+            } else if (compareCommand(args[0], "stats", "st")) {
+                if (confirmArgs(numargs, 1)) {
+                    printStats();
+                }
+            } else if (compareCommand(args[0], "ratelimit", "rl")) {
+                if (confirmArgs(numargs, 4)) {
+                    setRateLimit(args[1], args[2], args[3]);
+                }
+            } else if (compareCommand(args[0], "coalesce", "co")) {
+                if (confirmArgs(numargs, 2)) {
+                    setCoalesceWindow(args[1]);
+                }
+            } else if (compareCommand(args[0], "trace", "tr")) {
+                if (numargs == 1) stopTrace();
+                else if (confirmArgs(numargs, 2)) startTrace(args[1]);
+            } else if (compareCommand(args[0], "search", "se")) {
+                searchChat(NULL, args + 1, numargs - 1);
+            } else if (compareCommand(args[0], "hash", "ha")) {
+                if (numargs == 3 && strcmp(args[2], "-b") == 0) hashItem(NULL, args[1], TRUE);
+                else if (confirmArgs(numargs, 2)) hashItem(NULL, args[1], FALSE);
+            } else if (compareCommand(args[0], "du", "du")) {
+                if (numargs <= 2) showUsage(NULL, numargs == 2 ? args[1] : ".");
+                else confirmArgs(numargs, 2);
+            } else if (compareCommand(args[0], "quota", "qu")) {
+                setDirectoryQuota(args + 1, numargs - 1);
+            } else if (compareCommand(args[0], "workers", "wk")) {
+                if (confirmArgs(numargs, 1)) {
+                    listWorkers();
+                }
+            } else if (compareCommand(args[0], "handoff", "ho")) {
+                if (confirmArgs(numargs, 2)) {
+                    replaceWorker(args[1]);
                 }
             } else {
                 setTextColor(RED);
@@ -361,12 +1257,16 @@ void handleInput() {
             }
         } else if (g_talkEnabled) {
             printf("ADMIN   >> %s\n", g_buffer);
-            char packet[PACKET_SIZE];
-            packet[0] = CHAT;
-            strcpy(packet + 1, "ADMIN>");
-            strcpy(packet + strlen(packet), g_buffer);
-            addChat(packet);
-            handlePacket(packet, g_socket);
+            char chat[BUFFER_SIZE + 6];
+            strcpy(chat, "ADMIN>");
+            strcpy(chat + strlen(chat), g_buffer);
+            Packet* packet = makePacket(&g_packetPool, CHAT, chat, strlen(chat));
+            if (packet != NULL) {
+                addChat(packet);
+                handlePacket(packet, g_socket);
+                shareChat(packet, -1);
+                releasePacket(packet);
+            }
         } else {
             setTextColor(YELLOW);
             printf("SERVER  >> talking is not enabled!\n");
@@ -376,6 +1276,7 @@ void handleInput() {
         // clear buffer
         memset(g_buffer, '\0', BUFFER_SIZE);
     }
+    return NULL;
 }
 
 /**
@@ -384,22 +1285,37 @@ void handleInput() {
 */
 void createItem(char* flag, char* name) {
     char path[MAX_PATH_SIZE];
-    getWorkingDir(path);
-    path[strlen(path)] = '/';
-    strcpy(path + strlen(path), name);
-
+    if (!resolvePath(g_adminDir.relative, name, path)) path[0] = '\0';
     if (strcmp(flag, "-f") == 0) {
-        FILE *file;
-        file = fopen(path, "w");
-        if (file == NULL) {
+        if (path[0] != '\0' && !fitsQuota(path, NULL, NULL)) return;
+        int file = openItem(&g_adminDir, name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (file < 0) {
             setTextColor(RED);
             printf("ERROR   >> unable to create file\n");
             resetText();
             return;
         }
-        fclose(file);
+        close(file);
     } else if (strcmp(flag, "-d") == 0) {
-        int result = mkdir(path);
+#ifdef __linux__
+        // make the last step inside of its parent's handle
+        char parent[MAX_PATH_SIZE];
+        strncpy(parent, name, MAX_PATH_SIZE - 1);
+        parent[MAX_PATH_SIZE - 1] = '\0';
+        char* last = strrchr(parent, '/');
+        int parentFd;
+        if (last == NULL) {
+            last = parent;
+            parentFd = openItem(&g_adminDir, ".", O_PATH | O_DIRECTORY, 0);
+        } else {
+            *last++ = '\0';
+            parentFd = openItem(&g_adminDir, parent[0] == '\0' ? "/" : parent, O_PATH | O_DIRECTORY, 0);
+        }
+        int result = (parentFd < 0 || !isPlainRelative(last)) ? -1 : mkdirat(parentFd, last, 0777);
+        if (parentFd >= 0) close(parentFd);
+#else
+        int result = path[0] != '\0' ? makeDirectory(path) : -1;
+#endif
         if (result == -1) {
             setTextColor(RED);
             printf("ERROR   >> unable to create directory\n");
@@ -410,278 +1326,2615 @@ void createItem(char* flag, char* name) {
         setTextColor(RED);
         printf("ERROR   >> invalid use of create. Usage is [/create] <flag> <name>. see [/help] for more information.\n");
         resetText();
+        return;
     }
+    if (path[0] != '\0') refreshUsage(&g_usage, rootRelative(path), TRUE);
 }
 
 /**
  * handles client received packets and proccesses them
  * accordingly
 */
-void handleClient(int socket_fd) {
-    while (!g_shutdown) { // TODO: add afk timer later
-        char packet[PACKET_SIZE] = { 0 };
-        int recCode = recv(socket_fd, packet, PACKET_SIZE, 0);
-        if (recCode >= 0) {
-            if (g_monitor) ASYNC_PRINT("MONITOR >> received new packet: %s\n", packet);
-            addChat(packet);
-            handlePacket(packet, socket_fd);
+void* handleClient(void* arg) {
+    int socket_fd = (int)(intptr_t)arg;
+    Session* session = findSession(socket_fd);
+    FrameReader* reader = calloc(1, sizeof(FrameReader));
+    int closed = FALSE;
+    if (session != NULL) {
+        session->thread = pthread_self();
+
+        // a client handed over from another worker brings along whatever
+        // it had sent that wasn't handled yet
+        if (session->carried != NULL) {
+            free(reader);
+            reader = session->carried;
+            session->carried = NULL;
+            closed = handleFrames(session, socket_fd, reader, TRUE) == CLIENT_CLOSED;
         }
     }
-}
-
-/**
- * handles a packet given the packet and the socket
- * that sent the packet
-*/
-void handlePacket(char* buf, int socket_fd) {
-    switch (buf[0]) {
-        case CHAT:
-            if (g_talkEnabled && socket_fd != g_socket) {
-                char chat[PACKET_SIZE];
-                int index = 1;
-                for(index = 1; buf[index] != '>'; index++);
-                strcpy(chat, buf + 1);
-                strcpy(chat + index - 1, " >> ");
-                strcpy(chat + index + 3, buf + index + 1);
-                setTextColor(BLUE);
-                ASYNC_PRINT("CLIENT  >> %s\n", chat);
-                resetText();
-            }
-            if (g_monitor) ASYNC_PRINT("MONITOR >> updating client chatrooms\n");
-            for(int i = 0; i < g_clientIndex; i++) {
-                send(g_clients[i], buf, strlen(buf), 0);
-            }
+    while (!g_shutdown && !closed) { // TODO: add afk timer later
+#ifdef __linux__
+        if (g_handingOff && session != NULL) {
+            handOff(session, socket_fd, reader);
             break;
-        case SHUTDOWN:
+        }
+#endif
+        int available;
+        char* space = readerSpace(reader, &available);
+        int recCode;
+#ifdef __linux__
+        if (session != NULL && session->link != NULL) {
+            recCode = readLink(session->link, space, available);
+            countIo(0, recCode > 0 ? recCode : 0, 0);
+        } else
+#endif
+        {
+            recCode = recv(socket_fd, space, available, 0);
+            countIo(1, recCode > 0 ? recCode : 0, 0);
+        }
+        if (recCode < 0 && errno == EINTR) continue;
+        if (recCode <= 0) {
+            // the client hung up without saying goodbye, or its socket broke
             setTextColor(YELLOW);
-            if (g_monitor) ASYNC_PRINT("MONITOR >> client disconnected");
+            if (g_monitor) ASYNC_PRINT("MONITOR >> client disconnected\n");
             resetText();
             disconnectClient(socket_fd);
             break;
+        }
+        readerCommit(reader, recCode);
+        if (handleFrames(session, socket_fd, reader, TRUE) == CLIENT_CLOSED) break;
     }
+    free(reader);
+    return NULL;
 }
 
 /**
- * disconnects a certain client given their socket
+ * handles every complete frame that has arrived in a client's reader.
+ * clients that go over their rate are slept on when canWait is set.
+ * otherwise the frame is left in the reader, the session's throttle
+ * says how long to hold off, and CLIENT_WAITING is returned
 */
-void disconnectClient(int socket_fd) {
-    close(socket_fd);
-    int found = FALSE;
-    for(int i = 0; i < g_clientIndex; i++) {
-        if (found)
-            g_clients[i - 1] = g_clients[i];
-        if (g_clients[i] == socket_fd) 
-            found = TRUE;
-    }
-    g_clientIndex--;
-}
+int handleFrames(Session* session, int socket_fd, FrameReader* reader, int canWait) {
+    char type;
+    char* payload;
+    unsigned int length;
+    int status;
+    while ((status = nextFrame(reader, &type, &payload, &length)) == TRUE) {
+        if (session != NULL) {
+            int admission = admitPacket(session, &type, HEADER_SIZE + length, canWait);
+            if (admission == DEFERRED) {
+                reader->start -= HEADER_SIZE + length;
+                return CLIENT_WAITING;
+            }
+            if (g_tracing) recordTrace(TRACE_FRAME, session, type, payload, length);
+            if (admission == DROPPED) {
+                if (g_monitor) ASYNC_PRINT("MONITOR >> dropped packet from client %d (rate limited)\n", socket_fd);
+                continue;
+            } else if (admission == FLOODED) {
+                setTextColor(YELLOW);
+                ASYNC_PRINT("SERVER  >> disconnecting client %d for flooding\n", socket_fd);
+                resetText();
+                disconnectClient(socket_fd);
+                return CLIENT_CLOSED;
+            }
+        }
+        if (g_monitor) ASYNC_PRINT("MONITOR >> received new packet: %c%.*s\n", type, (int)length, payload);
 
-/**
- * adds a chat to the chat log
+        // frames can be bigger than a pooled packet, and cutting a chat
+        // or command short would change what it says, so refuse it instead
+        if (length > POOL_PAYLOAD_SIZE) {
+            if (g_monitor) ASYNC_PRINT("MONITOR >> dropped packet from client %d (%u bytes is too long)\n", socket_fd, length);
+            if (session != NULL) respond(session, "ERROR   >> %s is too long, the limit is %d bytes",
+                type == COMMAND ? "command" : "message", POOL_PAYLOAD_SIZE);
+            continue;
+        }
+
+        // decode the frame once into a pooled packet that gets shared
+        // by the chat log, the console and every client's output queue
+        Packet* packet = makePacket(&g_packetPool, type, payload, length);
+        if (packet == NULL) continue;
+        if (type == CHAT) addChat(packet);
+        handlePacket(packet, socket_fd);
+        if (type == CHAT) shareChat(packet, -1);
+        releasePacket(packet);
+        if (session != NULL && (!session->active || session->socket != socket_fd)) return CLIENT_CLOSED;
+    }
+    if (status == FRAME_ERROR) {
+        setTextColor(YELLOW);
+        ASYNC_PRINT("SERVER  >> disconnecting client %d for sending a malformed packet\n", socket_fd);
+        resetText();
+        disconnectClient(socket_fd);
+        return CLIENT_CLOSED;
+    }
+    return CLIENT_OK;
+}
+
+/**
+ * event loop for the io_uring backend. accepts and receives for every
+ * client are kept in flight on a single ring, and each pass submits
+ * everything queued since the last one and reaps whatever completed
+ * with one system call. returns FALSE if a ring couldn't be set up
+*/
+int serveRing(int server_fd) {
+#ifdef __linux__
+    Ring ring;
+    if (initRing(&ring, RING_ENTRIES) != 0) return FALSE;
+
+    // the ring writes straight to sockets and knows nothing of local
+    // links, so the shared memory listener is never started for it
+    setTextColor(YELLOW);
+    printf("WARNING: local clients are not taken through shared memory with io_uring, so they connect over TCP\n");
+    resetText();
+    FrameReader* readers[MAX_USERS] = { 0 };
+    struct __kernel_timespec waits[MAX_USERS];
+    prepAccept(nextSqe(&ring), server_fd, RING_ACCEPT);
+
+    while (!g_shutdown) {
+        if (submitRing(&ring, 1) < 0) break;
+        countIo(1, 0, 0);
+        struct io_uring_cqe* cqe;
+        while ((cqe = peekCompletion(&ring)) != NULL) {
+            int op = (int)(cqe->user_data >> 32);
+            int slot = (int)(cqe->user_data & 0xFFFFFFFF);
+            int result = cqe->res;
+            seenCompletion(&ring);
+
+            if (op == RING_ACCEPT) {
+                prepAccept(nextSqe(&ring), server_fd, RING_ACCEPT);
+                if (result < 0) {
+                    setTextColor(RED);
+                    ASYNC_PRINT("ERROR   >> failed to accept\n");
+                    resetText();
+                    continue;
+                }
+                setTextColor(GREEN);
+                if (g_monitor) ASYNC_PRINT("MONITOR >> New client connected\n");
+                resetText();
+                Session* session = addUser(result);
+                FrameReader* reader = session == NULL ? NULL : calloc(1, sizeof(FrameReader));
+                if (reader == NULL) {
+                    disconnectClient(result);
+                    continue;
+                }
+                readers[session->slot] = reader;
+                int available;
+                char* space = readerSpace(reader, &available);
+                prepRecv(nextSqe(&ring), result, space, available, ((unsigned long long)RING_RECV << 32) | session->slot);
+                continue;
+            }
+
+            // every client has exactly one receive or throttle wait in flight,
+            // so its slot can't have been handed to someone else yet
+            Session* session = &g_sessions[slot];
+            FrameReader* reader = readers[slot];
+            if (op == RING_RECV) {
+                if (result <= 0) {
+                    setTextColor(YELLOW);
+                    if (g_monitor) ASYNC_PRINT("MONITOR >> client disconnected\n");
+                    resetText();
+                    disconnectClient(session->socket);
+                    free(reader);
+                    readers[slot] = NULL;
+                    continue;
+                }
+                countIo(0, result, 0);
+                readerCommit(reader, result);
+            }
+
+            int socket_fd = session->socket;
+            int state = handleFrames(session, socket_fd, reader, FALSE);
+            if (state == CLIENT_CLOSED) {
+                free(reader);
+                readers[slot] = NULL;
+            } else if (state == CLIENT_WAITING) {
+                waits[slot].tv_sec = session->throttle / 1000000;
+                waits[slot].tv_nsec = (session->throttle % 1000000) * 1000;
+                prepTimeout(nextSqe(&ring), &waits[slot], ((unsigned long long)RING_RESUME << 32) | slot);
+            } else {
+                int available;
+                char* space = readerSpace(reader, &available);
+                prepRecv(nextSqe(&ring), socket_fd, space, available, ((unsigned long long)RING_RECV << 32) | slot);
+            }
+        }
+    }
+    closeRing(&ring);
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/**
+ * adds to the totals used to compare the I/O backends
+*/
+void countIo(long long calls, long long received, long long sent) {
+    if (calls > 0) __atomic_add_fetch(&g_ioCalls, calls, __ATOMIC_RELAXED);
+    if (received > 0) __atomic_add_fetch(&g_bytesIn, received, __ATOMIC_RELAXED);
+    if (sent > 0) __atomic_add_fetch(&g_bytesOut, sent, __ATOMIC_RELAXED);
+}
+
+/**
+ * starts recording every inbound packet to a trace file,
+ * replacing any trace that is already being recorded
+*/
+void startTrace(char* path) {
+    if (g_tracing) stopTrace();
+    pthread_rwlock_wrlock(&g_traceLock);
+    if (openTrace(&g_trace, path) != 0) {
+        pthread_rwlock_unlock(&g_traceLock);
+        setTextColor(RED);
+        printf("ERROR   >> unable to open trace file %s\n", path);
+        resetText();
+        return;
+    }
+    strncpy(g_tracePath, path, MAX_PATH_SIZE - 1);
+    g_tracing = TRUE;
+
+    // clients that are already connected get opened at the start of the trace
+    for (int i = 0; i < MAX_USERS; i++)
+        if (g_sessions[i].active)
+            traceRecord(&g_trace, TRACE_OPEN, g_sessions[i].id, 0, NULL, 0);
+    pthread_rwlock_unlock(&g_traceLock);
+    printf("SERVER  >> recording trace to %s\n", path);
+}
+
+/**
+ * stops recording and writes out whatever is left of the trace
+*/
+void stopTrace() {
+    pthread_rwlock_wrlock(&g_traceLock);
+    if (!g_tracing) {
+        pthread_rwlock_unlock(&g_traceLock);
+        printf("SERVER  >> no trace is being recorded\n");
+        return;
+    }
+    g_tracing = FALSE;
+    long long records = g_trace.records;
+    long long bytes = g_trace.bytes;
+    closeTrace(&g_trace);
+    pthread_rwlock_unlock(&g_traceLock);
+    printf("SERVER  >> trace %s closed (%lld records, %lld bytes)\n", g_tracePath, records, bytes);
+}
+
+/**
+ * adds a record to the trace if one is still being recorded
+*/
+void recordTrace(int kind, Session* session, char type, char* payload, unsigned int length) {
+    pthread_rwlock_rdlock(&g_traceLock);
+    if (g_tracing) traceRecord(&g_trace, kind, session->id, type, payload, length);
+    pthread_rwlock_unlock(&g_traceLock);
+}
+
+/**
+ * handles a packet given the packet and the socket
+ * that sent the packet
+*/
+void handlePacket(Packet* packet, int socket_fd) {
+    switch (packetType(packet)) {
+        case CHAT:
+            if (g_talkEnabled && socket_fd != g_socket) {
+                char* chat = packetPayload(packet);
+                char* message = strchr(chat, '>');
+                setTextColor(BLUE);
+                if (message != NULL) ASYNC_PRINT("CLIENT  >> %.*s >> %s\n", (int)(message - chat), chat, message + 1);
+                else ASYNC_PRINT("CLIENT  >> %s\n", chat);
+                resetText();
+            }
+            if (g_monitor) ASYNC_PRINT("MONITOR >> updating client chatrooms\n");
+            broadcastPacket(packet);
+            break;
+        case COMMAND:
+            if (g_monitor) ASYNC_PRINT("MONITOR >> client %d ran command: %s\n", socket_fd, packetPayload(packet));
+            handleCommand(findSession(socket_fd), packetPayload(packet));
+            break;
+        case SHUTDOWN:
+            setTextColor(YELLOW);
+            if (g_monitor) ASYNC_PRINT("MONITOR >> client disconnected");
+            resetText();
+            disconnectClient(socket_fd);
+            break;
+    }
+}
+
+/**
+ * disconnects a certain client given their socket
+*/
+void disconnectClient(int socket_fd) {
+#ifdef __linux__
+    // the link goes before the session so its slot can't be reused first
+    Session* session = findSession(socket_fd);
+    if (session != NULL && session->link != NULL) {
+        pthread_mutex_lock(&g_sendLocks[session->slot]);
+        closeLink(session->link);
+        pthread_mutex_unlock(&g_sendLocks[session->slot]);
+    }
+#endif
+    close(socket_fd);
+    closeSession(socket_fd);
+    pthread_mutex_lock(&g_clientLock);
+    int found = FALSE;
+    for(int i = 0; i < g_clientIndex; i++) {
+        if (found)
+            g_clients[i - 1] = g_clients[i];
+        if (g_clients[i] == socket_fd) 
+            found = TRUE;
+    }
+    if (found) g_clientIndex--;
+    pthread_mutex_unlock(&g_clientLock);
+}
+
+/**
+ * adds a chat to the chat log by holding a reference to its packet and
+ * indexes it for searching. the log is a ring, so the oldest chat is let
+ * go once it fills up
+*/
+void addChat(Packet* chat) {
+    retainPacket(chat);
+    pthread_mutex_lock(&g_chatLock);
+    Packet** slot = &g_chatLog[g_logIndex % MAX_LOGS];
+    if (*slot != NULL) releasePacket(*slot);
+    *slot = chat;
+    indexMessage(&g_searchIndex, g_logIndex, packetPayload(chat), payloadLength(chat), time(NULL));
+    g_logIndex++;
+    pthread_mutex_unlock(&g_chatLock);
+}
+
+/**
+ * searches the chat log and reports the newest matches to the admin,
+ * or to a client when session isn't NULL
+*/
+void searchChat(Session* session, char** args, int numargs) {
+    SearchQuery query;
+    if (numargs == 0 || parseQuery(&query, args, numargs, time(NULL)) != 0) {
+        report(session, RED, "ERROR   >> Usage is [/search] <terms> [user:<name>] [since:<age>], with ages like 30s, 10m, 2h or 1d");
+        return;
+    }
+    if (query.count == 0 && query.since == 0) {
+        report(session, RED, "ERROR   >> There is nothing to search for");
+        return;
+    }
+
+    // hold on to the matching chats so they can be printed after letting go of the log
+    SearchResult results[MAX_SEARCH_RESULTS];
+    Packet* chats[MAX_SEARCH_RESULTS];
+    long long start = getTimeMicros();
+    pthread_mutex_lock(&g_chatLock);
+    long long oldest = g_logIndex > MAX_LOGS ? g_logIndex - MAX_LOGS : 0;
+    long long total = searchIndex(&g_searchIndex, &query, oldest, results, MAX_SEARCH_RESULTS);
+    int found = total < MAX_SEARCH_RESULTS ? (int)total : MAX_SEARCH_RESULTS;
+    for (int i = 0; i < found; i++) {
+        chats[i] = g_chatLog[results[i].id % MAX_LOGS];
+        retainPacket(chats[i]);
+    }
+    pthread_mutex_unlock(&g_chatLock);
+    double millis = (getTimeMicros() - start) / 1000.0;
+
+    if (total > found) report(session, GREEN, "SERVER  >> %lld matches in %.3fms, showing the newest %d", total, millis, found);
+    else report(session, GREEN, "SERVER  >> %lld match%s in %.3fms", total, total == 1 ? "" : "es", millis);
+    long long now = time(NULL);
+    for (int i = found - 1; i >= 0; i--) {
+        char age[32];
+        formatAge(now - results[i].time, age);
+        char* chat = packetPayload(chats[i]);
+        char* message = strchr(chat, '>');
+        if (message != NULL) report(session, BLUE, "#%-8lld %5s ago  %.*s >> %s", results[i].id, age, (int)(message - chat), chat, message + 1);
+        else report(session, BLUE, "#%-8lld %5s ago  %s", results[i].id, age, chat);
+        releasePacket(chats[i]);
+    }
+}
+
+/**
+ * writes out a number of seconds in the largest unit that fits
+*/
+void formatAge(long long seconds, char* age) {
+    if (seconds < 0) seconds = 0;
+    if (seconds < 60) sprintf(age, "%llds", seconds);
+    else if (seconds < 3600) sprintf(age, "%lldm", seconds / 60);
+    else if (seconds < 86400) sprintf(age, "%lldh", seconds / 3600);
+    else sprintf(age, "%lldd", seconds / 86400);
+}
+
+/**
+ * shows the hash of a file to a client, or to the admin when session is
+ * NULL. a hash that is already cached is shown right away, otherwise the
+ * file is handed to the hashing threads and shown once they're done
+*/
+void hashItem(Session* session, char* name, int blocks) {
+    WorkDir* dir = workDirOf(session);
+    char path[MAX_PATH_SIZE];
+    if (!resolvePath(dir->relative, name, path)) {
+        report(session, RED, "ERROR   >> paths must stay inside of the root directory");
+        return;
+    }
+    char* relative = path + strlen(ROOT_DIR);
+    if (*relative == '/') relative++;
+
+    struct stat info;
+    int fd = openItem(dir, name, O_RDONLY, 0);
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        report(session, RED, "ERROR   >> %s is not a file that can be hashed", name);
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    HashKey key;
+    HashResult result;
+    makeHashKey(&key, &info);
+    if (lookupHash(&g_hashCache, &key, blocks, &result)) {
+        close(fd);
+        printHash(session, relative, &result);
+        free(result.blockHashes);
+        return;
+    }
+
+    HashRequest* request = calloc(1, sizeof(HashRequest));
+    request->fd = fd;
+    request->path = strdup(relative);
+    request->wantBlocks = blocks;
+    request->owner = session == NULL ? -1 : session->slot;
+    request->ownerId = session == NULL ? 0 : session->id;
+    requestHash(&g_hashCache, request);
+    report(session, YELLOW, "SERVER  >> hashing R:/%s (%lld bytes) in the background", relative, (long long)info.st_size);
+}
+
+/**
+ * called by a hashing thread once a requested hash is known. the result
+ * goes to whoever asked for it, unless they've disconnected since
+*/
+void hashFinished(HashRequest* request, HashResult* result) {
+    Session* session = NULL;
+    if (request->owner >= 0) session = &g_sessions[request->owner];
+    if (session == NULL || (session->active && session->id == request->ownerId)) {
+        if (result->error) report(session, RED, "ERROR   >> R:/%s could not be hashed", request->path);
+        else printHash(session, request->path, result);
+    }
+    free(result->blockHashes);
+    close(request->fd);
+    free(request->path);
+    free(request);
+}
+
+/**
+ * prints a file's hash along with the first of its block hashes
+*/
+void printHash(Session* session, char* path, HashResult* result) {
+    report(session, GREEN, "SERVER  >> R:/%s xxh64 %016llx (%lld bytes%s)", path, result->hash,
+        (long long)result->size, result->cached ? ", cached" : "");
+    for (int i = 0; i < result->blocks && i < MAX_BLOCKS_SHOWN; i++)
+        report(session, WHITE, "\tblock %-6d %016llx", i, result->blockHashes[i]);
+    if (result->blocks > MAX_BLOCKS_SHOWN)
+        report(session, WHITE, "\t... and %d more blocks", result->blocks - MAX_BLOCKS_SHOWN);
+}
+
+/**
+ * subscribes a client to changes anywhere below a directory, replacing
+ * whatever they were watching before. no directory unsubscribes them
+*/
+void watchDirectory(Session* session, char* directory) {
+#ifdef __linux__
+    if (directory == NULL) {
+        pthread_mutex_lock(&g_watchLock);
+        session->subscribed = FALSE;
+        pthread_mutex_unlock(&g_watchLock);
+        respond(session, "SERVER  >> no longer watching for changes");
+        return;
+    }
+    char path[MAX_PATH_SIZE];
+    if (!g_watching) {
+        respond(session, "ERROR   >> the server isn't able to watch for changes");
+        return;
+    } else if (!resolvePath(session->dir.relative, directory, path)) {
+        respond(session, "ERROR   >> paths must stay inside of the root directory");
+        return;
+    } else if (!directoryExists(&session->dir, directory)) {
+        respond(session, "ERROR   >> Directory does not exist or is not accessible");
+        return;
+    }
+    char* relative = path + strlen(ROOT_DIR);
+    if (*relative == '/') relative++;
+    pthread_mutex_lock(&g_watchLock);
+    strcpy(session->watching, relative);
+    session->subscribed = TRUE;
+    pthread_mutex_unlock(&g_watchLock);
+    respond(session, "SERVER  >> watching R:/%s for changes", relative);
+#else
+    respond(session, "ERROR   >> the server isn't able to watch for changes");
+#endif
+}
+
+#ifdef __linux__
+/**
+ * drops the cached hashes of anything under the root that changes, and
+ * gathers the change up to be pushed to clients. a change to the root
+ * itself means events were missed, so everything is dropped
+*/
+void fileChanged(void* context, int change, const char* path, int directory) {
+    if (path[0] == '\0') invalidateHashes(&g_hashCache, "", TRUE);
+    else if (!directory) invalidateHashes(&g_hashCache, path, FALSE);
+    else if (change != WATCH_CHANGED) invalidateHashes(&g_hashCache, path, TRUE);
+    // a directory reported changed only had its own times or permissions
+    // changed, so it's walked again when it comes or goes but not otherwise.
+    // the root is reported changed when changes were missed, so it always is
+    refreshUsage(&g_usage, path, change != WATCH_CHANGED || path[0] == '\0');
+    if (g_changes.since == 0) g_changes.since = getTimeMicros();
+    addChange(&g_changes, change, path, directory);
+}
+
+/**
+ * watcher thread. passes every change under the root on to fileChanged,
+ * and pushes them out once they've had a little while to pile up, so a
+ * burst of changes reaches clients as one notification
+*/
+void* watchRoot(void* arg) {
+    while (1) {
+        int timeout = -1;
+        if (g_changes.since != 0) {
+            long long left = g_changes.since + NOTIFY_WINDOW - getTimeMicros();
+            timeout = left > 0 ? (int)((left + 999) / 1000) : 0;
+        }
+        int ready = waitChanges(&g_watcher, timeout);
+        if (ready < 0 || (ready > 0 && readChanges(&g_watcher, fileChanged, NULL) != 0)) break;
+        if (g_changes.since != 0 && getTimeMicros() - g_changes.since >= NOTIFY_WINDOW) pushChanges();
+    }
+    return NULL;
+}
+
+/**
+ * sends every client the gathered changes below the directory they're
+ * watching, one per line. a lone * means too much changed to list
+*/
+void pushChanges() {
+    char text[PACKET_SIZE];
+    pthread_mutex_lock(&g_watchLock);
+    for (int i = 0; i < MAX_USERS; i++) {
+        Session* session = &g_sessions[i];
+        if (!session->active || !session->subscribed) continue;
+        int length = g_changes.overflowed ? sprintf(text, "*\n") : 0;
+        for (int c = 0; c < g_changes.count; c++) {
+            if (!isUnder(g_changes.changes[c].path, session->watching)) continue;
+            int line = formatChange(&g_changes.changes[c], session->watching, text + length, PACKET_SIZE - length);
+            if (line == 0 && length > 0) {
+                // the packet is full, so send it and start the next one with this change
+                sendNotification(session, text, length);
+                length = 0;
+                line = formatChange(&g_changes.changes[c], session->watching, text, PACKET_SIZE);
+            }
+            length += line;
+        }
+        if (length > 0) sendNotification(session, text, length);
+    }
+    pthread_mutex_unlock(&g_watchLock);
+    if (g_monitor) ASYNC_PRINT("MONITOR >> pushed %d changes to watching clients\n", g_changes.count);
+    clearChanges(&g_changes);
+}
+
+/**
+ * queues a notification of changes for a client
+*/
+void sendNotification(Session* session, char* text, int length) {
+    Packet* packet = makePacket(&g_packetPool, NOTIFY, text, length);
+    if (packet == NULL) return;
+    unicastPacket(session, packet);
+    releasePacket(packet);
+    g_notifications++;
+}
+#endif
+
+/**
+ * adds a user into the recorded current users and claims a session
+ * for them. clients are accepted on several threads, so both happen
+ * under g_clientLock. returns the session, or NULL if the server is full
+*/
+Session* addUser(int socket_fd) {
+    pthread_mutex_lock(&g_clientLock);
+    Session* session = g_clientIndex < MAX_USERS ? openSession(socket_fd) : NULL;
+    if (session != NULL) g_clients[g_clientIndex++] = socket_fd;
+    pthread_mutex_unlock(&g_clientLock);
+    return session;
+}
+
+/**
+ * claims a free session slot for a newly connected client and fills up
+ * its rate limiting buckets. the caller holds g_clientLock. returns the
+ * session, or NULL if every slot is taken
+*/
+Session* openSession(int socket_fd) {
+    for (int i = 0; i < MAX_USERS; i++) {
+        if (!g_sessions[i].active) {
+            memset(&g_sessions[i], 0, sizeof(Session));
+            g_sessions[i].socket = socket_fd;
+            g_sessions[i].slot = i;
+            g_sessions[i].id = ++g_connections;
+            initWorkDir(&g_sessions[i].dir);
+            resetBuckets(&g_sessions[i]);
+            g_sessions[i].active = TRUE;
+            if (g_tracing) recordTrace(TRACE_OPEN, &g_sessions[i], 0, NULL, 0);
+            return &g_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * releases the session slot owned by the given socket
+*/
+void closeSession(int socket_fd) {
+    pthread_mutex_lock(&g_outputLock);
+    Session* session = findSession(socket_fd);
+    if (session != NULL) {
+        if (g_tracing) recordTrace(TRACE_CLOSE, session, 0, NULL, 0);
+        session->active = FALSE;
+        clearQueue(&session->output);
+        closeWorkDir(&session->dir);
+    }
+    pthread_mutex_unlock(&g_outputLock);
+}
+
+/**
+ * finds the active session that owns the given socket,
+ * returns NULL if there is none
+*/
+Session* findSession(int socket_fd) {
+    for (int i = 0; i < MAX_USERS; i++)
+        if (g_sessions[i].active && g_sessions[i].socket == socket_fd)
+            return &g_sessions[i];
+    return NULL;
+}
+
+/**
+ * (re)initializes the buckets of a session from the current
+ * rate limits. byte buckets always hold at least one full packet
+*/
+void resetBuckets(Session* session) {
+    long long now = getTimeMicros();
+    double chatBurst = g_chatByteRate * BURST_SECONDS;
+    double fileBurst = g_fileByteRate * BURST_SECONDS;
+    if (chatBurst < PACKET_SIZE) chatBurst = PACKET_SIZE;
+    if (fileBurst < PACKET_SIZE) fileBurst = PACKET_SIZE;
+    initBucket(&session->chatMessages, g_chatMessageRate, g_chatMessageRate * BURST_SECONDS, now);
+    initBucket(&session->chatBytes,    g_chatByteRate,    chatBurst,                         now);
+    initBucket(&session->fileMessages, g_fileMessageRate, g_fileMessageRate * BURST_SECONDS, now);
+    initBucket(&session->fileBytes,    g_fileByteRate,    fileBurst,                         now);
+}
+
+/**
+ * runs a received packet through its session's rate limits. packets
+ * slightly over the limit are delayed until the buckets refill, while
+ * packets that would need to wait too long are dropped. a client that
+ * keeps getting dropped is reported as flooding. callers that can't
+ * sleep get DEFERRED back instead, with the wait left in the session
+*/
+int admitPacket(Session* session, char* packet, int length, int canWait) {
+    TokenBucket* messages;
+    TokenBucket* bytes;
+    switch (packet[0]) {
+        case CHAT:
+            messages = &session->chatMessages;
+            bytes    = &session->chatBytes;
+            break;
+        case SHUTDOWN:
+        case '\0':
+            return ADMITTED;
+        default:
+            messages = &session->fileMessages;
+            bytes    = &session->fileBytes;
+            break;
+    }
+
+    // find how long we would need to wait for both buckets
+    long long now = getTimeMicros();
+    long long delay = bucketDelay(messages, 1, now);
+    long long byteDelay = bucketDelay(bytes, length, now);
+    if (byteDelay > delay) delay = byteDelay;
+
+    if (delay > MAX_THROTTLE_DELAY) {
+        session->packets++;
+        session->bytes += length;
+        session->dropped++;
+        if (++session->strikes >= FLOOD_STRIKES) return FLOODED;
+        return DROPPED;
+    }
+    if (delay > 0 && !canWait) {
+        session->delayed++;
+        session->throttle = delay;
+        return DEFERRED;
+    }
+    session->packets++;
+    session->bytes += length;
+    if (delay > 0) {
+        // only this client's thread waits, so everyone else is unaffected
+        session->delayed++;
+        sleepMicros(delay);
+        now = getTimeMicros();
+        refillBucket(messages, now);
+        refillBucket(bytes, now);
+    }
+    takeTokens(messages, 1);
+    takeTokens(bytes, length);
+    session->strikes = 0;
+    return ADMITTED;
+}
+
+/**
+ * sets the per client message and byte rates for either chat
+ * or file traffic and applies them to everyone connected
+*/
+void setRateLimit(char* type, char* messages, char* bytes) {
+    double messageRate = atof(messages);
+    double byteRate = atof(bytes);
+    if (messageRate < 0 || byteRate < 0) {
+        setTextColor(RED);
+        printf("ERROR   >> rate limits cannot be negative\n");
+        resetText();
+        return;
+    }
+    if (strcmp(type, "chat") == 0) {
+        g_chatMessageRate = messageRate;
+        g_chatByteRate = byteRate;
+    } else if (strcmp(type, "file") == 0) {
+        g_fileMessageRate = messageRate;
+        g_fileByteRate = byteRate;
+    } else {
+        setTextColor(RED);
+        printf("ERROR   >> invalid use of ratelimit. Usage is [/ratelimit] <chat|file> <msgs> <bytes>. see [/help] for more information.\n");
+        resetText();
+        return;
+    }
+    for (int i = 0; i < MAX_USERS; i++)
+        if (g_sessions[i].active)
+            resetBuckets(&g_sessions[i]);
+    printf("SERVER  >> %s limits set to %.0f msgs/s and %.0f bytes/s\n", type, messageRate, byteRate);
+}
+
+/**
+ * prints the current rate limits along with the traffic
+ * counters of every connected client
+*/
+void printStats() {
+    printf("\n");
+    setHighlight(YELLOW);
+    printf("RATE LIMITS:");
+    resetText();
+    printf("\n\n\tchat: %.0f msgs/s, %.0f bytes/s\n", g_chatMessageRate, g_chatByteRate);
+    printf("\tfile: %.0f msgs/s, %.0f bytes/s\n\n", g_fileMessageRate, g_fileByteRate);
+    setHighlight(YELLOW);
+    printf("OUTPUT:");
+    resetText();
+    printf("\n\n\tcoalescing window: %lld us\n", g_coalesceWindow);
+    printf("\tframes sent: %lld in %lld send calls", g_framesSent, g_sendCalls);
+    if (g_framesSent > 0) printf(" (%.3f calls per frame)", (double)g_sendCalls / g_framesSent);
+    printf("\n\tpriority: %lld batches of chat sent ahead of transfer frames", g_preempted);
+    printf("\n\tpacket pool: %lld buffers in %lld slabs, %lld in use\n\n",
+        g_packetPool.created, g_packetPool.slabs, g_packetPool.inUse);
+    setHighlight(YELLOW);
+    printf("CHAT:");
+    resetText();
+    pthread_mutex_lock(&g_chatLock);
+    printf("\n\n\tmessages: %d logged, %lld indexed in %lld bytes\n\n", g_logIndex, g_searchIndex.messages, searchMemory(&g_searchIndex));
+    pthread_mutex_unlock(&g_chatLock);
+    setHighlight(YELLOW);
+    printf("HASHES:");
+    resetText();
+    pthread_mutex_lock(&g_hashCache.lock);
+    printf("\n\n\tcache: %d files, %lld hits, %lld misses, %lld invalidated\n", g_hashCache.count,
+        g_hashCache.hits, g_hashCache.misses, g_hashCache.invalidated);
+    printf("\tbytes hashed: %lld\n", g_hashCache.hashed);
+    pthread_mutex_unlock(&g_hashCache.lock);
+#ifdef __linux__
+    if (g_watching) {
+        printf("\twatching: %d directories, %lld events, %lld overflows, %lld paths too long\n", g_watcher.count,
+            g_watcher.events, g_watcher.overflows, g_watcher.skipped);
+        printf("\tnotifications: %lld pushed to clients\n", g_notifications);
+    }
+#endif
+    printf("\tclient caches: %lld versions checked, %lld not modified\n", g_versionChecks, g_notModified);
+    pthread_mutex_lock(&g_usage.lock);
+    printf("\tdisk usage: %d paths tracked, %lld refreshes, %d quotas, %lld writes refused\n",
+        g_usage.count, g_usage.refreshes, g_usage.quotaCount, g_usage.refused);
+    pthread_mutex_unlock(&g_usage.lock);
+    printf("\n");
+    setHighlight(YELLOW);
+    printf("I/O:");
+    resetText();
+    printf("\n\n\tbackend: %s\n", g_backend == BACKEND_URING ? "io_uring" : "threads");
+    printf("\tsystem calls: %lld\n", g_ioCalls);
+    printf("\tbytes in: %lld, bytes out: %lld\n", g_bytesIn, g_bytesOut);
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+    double gigabytes = (g_bytesIn + g_bytesOut) / 1000000000.0;
+    printf("\tcpu time: %.3fs", cpu);
+    if (gigabytes > 0) printf(" (%.3fs per GB)", cpu / gigabytes);
+    printf("\n");
+#endif
+    if (g_tracing) printf("\ttrace: recording to %s (%lld records, %lld bytes)\n", g_tracePath, g_trace.records, g_trace.bytes);
+#ifdef __linux__
+    if (g_localSocket >= 0) printf("\tlocal clients: %lld through shared memory\n", g_localClients);
+#endif
+    if (g_workerCount > 1) printf("\tworkers: %d processes, %lld chats shared over the bus\n", g_workerCount, g_chatsShared);
+    printf("\n");
+    setHighlight(YELLOW);
+    printf("CLIENTS:");
+    resetText();
+    printf("\n\n\t%-8s %-10s %-12s %-10s %-10s %-10s %-10s\n", "SOCKET", "PACKETS", "BYTES", "DELAYED", "DROPPED", "SENT", "CALLS");
+    for (int i = 0; i < MAX_USERS; i++) {
+        Session* session = &g_sessions[i];
+        if (!session->active) continue;
+        printf("\t%-8d %-10lld %-12lld %-10lld %-10lld %-10lld %-10lld\n", session->socket, session->packets,
+            session->bytes, session->delayed, session->dropped, session->framesSent, session->sendCalls);
+    }
+    printf("\n");
+}
+
+/**
+ * queues a reference to the packet for every connected client.
+ * the output thread is only woken up when a new batch starts or the
+ * batch has grown big enough to send right away
+*/
+void broadcastPacket(Packet* packet) {
+    pthread_mutex_lock(&g_outputLock);
+    int wasEmpty = (g_pendingFrames == 0);
+    for (int i = 0; i < MAX_USERS; i++) {
+        Session* session = &g_sessions[i];
+        if (!session->active) continue;
+        if (!queuePacket(&session->output, packet)) {
+            session->dropped++; // client isn't keeping up, so this message is lost to them
+            continue;
+        }
+        g_pendingFrames++;
+        g_pendingBytes += packet->length;
+    }
+    if (wasEmpty && g_pendingFrames > 0) {
+        g_batchStart = getTimeMicros();
+        pthread_cond_signal(&g_outputReady);
+    } else if (g_pendingBytes >= FLUSH_THRESHOLD) {
+        pthread_cond_signal(&g_outputReady);
+    }
+    pthread_mutex_unlock(&g_outputLock);
+}
+
+/**
+ * output thread that writes queued frames to clients. frames are held
+ * for at most the coalescing window after the first one of a batch
+ * arrives, so a burst of messages goes out to each client in a single
+ * gather write instead of one send per message
+*/
+void* flushOutput(void* arg) {
+    static OutQueue batches[MAX_USERS];
+    int slots[MAX_USERS];
+    int sockets[MAX_USERS];
+    int sent[MAX_USERS];
+    long long calls[MAX_USERS];
+#ifdef __linux__
+    LocalLink* links[MAX_USERS];
+    Ring ring;
+    int useRing = g_backend == BACKEND_URING && initRing(&ring, RING_ENTRIES) == 0;
+#endif
+
+    pthread_mutex_lock(&g_outputLock);
+    while (!g_shutdown) {
+        if (g_pendingFrames == 0) {
+            pthread_cond_wait(&g_outputReady, &g_outputLock);
+            continue;
+        }
+
+        // hold the batch open until the window closes or it gets big
+        long long remaining = g_batchStart + g_coalesceWindow - getTimeMicros();
+        if (remaining > 0 && g_pendingBytes < FLUSH_THRESHOLD) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += (deadline.tv_nsec + remaining * 1000) / 1000000000;
+            deadline.tv_nsec = (deadline.tv_nsec + remaining * 1000) % 1000000000;
+            pthread_cond_timedwait(&g_outputReady, &g_outputLock, &deadline);
+            continue;
+        }
+
+        // take the whole batch so clients can keep queueing while we write
+        int numBatches = 0;
+        for (int i = 0; i < MAX_USERS; i++) {
+            Session* session = &g_sessions[i];
+            if (!session->active || session->output.count == 0) continue;
+
+            // a client in the middle of a transfer frame gets its queue
+            // sent by the transfer, so it can't hold up everyone else
+            if (session->bulk) continue;
+            batches[numBatches] = session->output;
+            memset(&session->output, 0, sizeof(OutQueue));
+            session->flushing++;
+            slots[numBatches] = i;
+            sockets[numBatches] = session->socket;
+#ifdef __linux__
+            links[numBatches] = session->link;
+#endif
+            numBatches++;
+        }
+        g_pendingFrames = 0;
+        g_pendingBytes = 0;
+        pthread_mutex_unlock(&g_outputLock);
+
+        long long totalCalls = 0;
+#ifdef __linux__
+        if (useRing) {
+            totalCalls = flushRing(&ring, batches, slots, sockets, sent, calls, numBatches);
+        } else
+#endif
+        for (int i = 0; i < numBatches; i++) {
+            long long bytes = batches[i].bytes;
+            calls[i] = 0;
+            pthread_mutex_lock(&g_sendLocks[slots[i]]);
+#ifdef __linux__
+            if (links[i] != NULL) sent[i] = flushLink(&batches[i], links[i], &calls[i]);
+            else
+#endif
+            sent[i] = flushQueue(&batches[i], sockets[i], &calls[i]);
+            pthread_mutex_unlock(&g_sendLocks[slots[i]]);
+            countIo(calls[i], 0, sent[i] < 0 ? 0 : bytes);
+            totalCalls += calls[i];
+        }
+
+        pthread_mutex_lock(&g_outputLock);
+        for (int i = 0; i < numBatches; i++) {
+            if (sent[i] < 0) sent[i] = 0;
+            Session* session = &g_sessions[slots[i]];
+            session->flushing--;
+            if (session->active && session->socket == sockets[i]) {
+                session->framesSent += sent[i];
+                session->sendCalls += calls[i];
+            }
+            g_framesSent += sent[i];
+        }
+        g_sendCalls += totalCalls;
+    }
+    pthread_mutex_unlock(&g_outputLock);
+#ifdef __linux__
+    if (useRing) closeRing(&ring);
+#endif
+    return NULL;
+}
+
+#ifdef __linux__
+/**
+ * writes every client's batch through the ring. each round puts one
+ * sendmsg per client on the ring and submits them all with a single
+ * system call. sends the kernel only partly finished are completed with
+ * a normal gather write. sent and calls are filled in per batch, and the
+ * number of system calls made in total is returned
+*/
+long long flushRing(Ring* ring, OutQueue* batches, int* slots, int* sockets, int* sent, long long* calls, int count) {
+    static IoVector vectors[MAX_USERS][FLUSH_VECTORS];
+    struct msghdr messages[MAX_USERS];
+    int lengths[MAX_USERS];
+    long long total = 0;
+    for (int i = 0; i < count; i++) {
+        sent[i] = 0;
+        calls[i] = 0;
+        pthread_mutex_lock(&g_sendLocks[slots[i]]);
+    }
+
+    int remaining = count;
+    while (remaining > 0) {
+        int submitted = 0;
+        for (int i = 0; i < count; i++) {
+            lengths[i] = 0;
+            if (sent[i] < 0 || batches[i].count == 0) continue;
+            lengths[i] = fillVectors(&batches[i], vectors[i], FLUSH_VECTORS);
+            memset(&messages[i], 0, sizeof(struct msghdr));
+            messages[i].msg_iov = vectors[i];
+            messages[i].msg_iovlen = lengths[i];
+            prepSendmsg(nextSqe(ring), sockets[i], &messages[i], MSG_NOSIGNAL, i);
+            calls[i]++;
+            submitted++;
+        }
+        if (submitRing(ring, submitted) < 0) {
+            // the ring broke, so finish this batch the old fashioned way
+            for (int i = 0; i < count; i++) {
+                if (sent[i] < 0 || batches[i].count == 0) continue;
+                long long bytes = batches[i].bytes;
+                int flushed = flushQueue(&batches[i], sockets[i], &calls[i]);
+                total += calls[i];
+                countIo(calls[i], 0, flushed < 0 ? 0 : bytes);
+                sent[i] = flushed < 0 ? -1 : sent[i] + flushed;
+            }
+            break;
+        }
+        total++;
+        countIo(1, 0, 0);
+
+        for (int reaped = 0; reaped < submitted; reaped++) {
+            struct io_uring_cqe* cqe;
+            while ((cqe = peekCompletion(ring)) == NULL) {
+                submitRing(ring, 1);
+                total++;
+                countIo(1, 0, 0);
+            }
+            int i = (int)cqe->user_data;
+            long long written = cqe->res;
+            seenCompletion(ring);
+
+            long long wanted = 0;
+            for (int v = 0; v < lengths[i]; v++) wanted += vectors[i][v].iov_len;
+            if (written >= 0 && written < wanted) {
+                // pick up where the kernel left off
+                int index = 0;
+                long long skip = written;
+                while (skip >= (long long)vectors[i][index].iov_len) skip -= vectors[i][index++].iov_len;
+                vectors[i][index].iov_base = (char*)vectors[i][index].iov_base + skip;
+                vectors[i][index].iov_len -= skip;
+                long long extra = 0;
+                long long more = gatherWrite(sockets[i], vectors[i] + index, lengths[i] - index, &extra);
+                calls[i] += extra;
+                total += extra;
+                countIo(extra, 0, 0);
+                written = more < 0 ? -1 : wanted;
+            }
+            if (written < 0) {
+                clearQueue(&batches[i]);
+                sent[i] = -1;
+                remaining--;
+                continue;
+            }
+            countIo(0, 0, written);
+            dropSent(&batches[i], lengths[i]);
+            sent[i] += lengths[i];
+            if (batches[i].count == 0) remaining--;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        batches[i].head = 0;
+        pthread_mutex_unlock(&g_sendLocks[slots[i]]);
+    }
+    return total;
+}
+#endif
+
+/**
+ * sets how long the output thread holds on to a batch of outgoing
+ * frames, capped so batching never adds much latency
+*/
+void setCoalesceWindow(char* micros) {
+    long long window = atoll(micros);
+    if (window < 0) window = 0;
+    if (window > MAX_COALESCE_WINDOW) {
+        setTextColor(YELLOW);
+        printf("SERVER  >> coalescing window capped at %d us\n", MAX_COALESCE_WINDOW);
+        resetText();
+        window = MAX_COALESCE_WINDOW;
+    }
+    pthread_mutex_lock(&g_outputLock);
+    g_coalesceWindow = window;
+    pthread_mutex_unlock(&g_outputLock);
+    printf("SERVER  >> coalescing window set to %lld us\n", window);
+}
+
+/**
+ * compares a given buffer to a command and it's respective shortcut
+*/
+int compareCommand(char* buffer, char* command, char* shortcut) {
+    return (strcmp(buffer, command) == 0 || strcmp(buffer, shortcut) == 0);
+}
+
+/**
+ * compares arguments and prints out error if false, and returns whether
+ * number of arguments were valid or not.
+*/
+int confirmArgs(int numArgs, int desiredArgs) {
+    if (numArgs != desiredArgs) {
+        setTextColor(RED);
+        printf("ERROR   >> Invalid use of command. Received %d arguments, should've received %d.\n", numArgs - 1, desiredArgs - 1);
+        resetText();
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Changes the working directory of a client, or of the admin when
+ * session is NULL, to the specified directory. Returns TRUE on success
+*/
+int changeDirectory(Session* session, char* directory) {
+    WorkDir* dir = workDirOf(session);
+    char path[MAX_PATH_SIZE];
+    if (!resolvePath(dir->relative, directory, path)) {
+        report(session, RED, "ERROR   >> Cannot go back further than the root directory");
+        return FALSE;
+    }
+    char* relative = path + strlen(ROOT_DIR);
+    if (*relative == '/') relative++;
+
+#ifdef __linux__
+    // plain names are looked up from the current handle, anything that
+    // steps back up is looked up from the root handle instead
+    int fd;
+    if (isPlainRelative(directory)) fd = openBeneath(dir->fd >= 0 ? dir->fd : rootFd(), directory, O_PATH | O_DIRECTORY, 0);
+    else fd = openBeneath(rootFd(), relative[0] == '\0' ? "." : relative, O_PATH | O_DIRECTORY, 0);
+    if (fd < 0) {
+        report(session, RED, "ERROR   >> Directory does not exist or is not accessible");
+        return FALSE;
+    }
+    if (dir->fd >= 0) close(dir->fd);
+    dir->fd = fd;
+#else
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        report(session, RED, "ERROR   >> Directory does not exist or is not accessible");
+        return FALSE;
+    }
+#endif
+    strcpy(dir->relative, relative);
+    return TRUE;
+}
+
+/**
+ * Reads from a specified file and outputs it to the terminal
+*/
+void readFile(char* arg) {
+    int fd = openItem(&g_adminDir, arg, O_RDONLY, 0);
+    FILE *file = fd < 0 ? NULL : fdopen(fd, "r");
+    char ch;
+    if (file == NULL) {
+        if (fd >= 0) close(fd);
+        setTextColor(RED);
+        printf("ERROR   >> File could not be opened or could not be found\n");
+        resetText();
+        return;
+    }
+
+    do {
+        ch = fgetc(file);
+        putchar(ch);
+
+    } while(ch != EOF);
+    printf("\n");
+    fclose(file);
+}
+
+/**
+ * Lists the working directory of a client, or of the admin when
+ * session is NULL. Directories are shown in bold for the admin and
+ * with a trailing slash for clients
+*/
+void listDirectory(Session* session) {
+    WorkDir* dir = workDirOf(session);
+    char path[MAX_PATH_SIZE];
+    getWorkingDir(dir, path);
+    if (session == NULL) printf("path: %s\n", path);
+
+#ifdef __linux__
+    int fd = rootFd() < 0 ? -1 : openat(dir->fd >= 0 ? dir->fd : rootFd(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* directory = fd < 0 ? NULL : fdopendir(fd);
+    if (directory == NULL && fd >= 0) close(fd);
+#else
+    DIR* directory = opendir(path);
+#endif
+    if (directory == NULL) {
+        // directory doesn't exist
+        if (strlen(dir->relative) == 0) {
+            report(session, YELLOW, "SERVER  >> No root directory detected. Creating a new directory...");
+            if (makeDirectory(ROOT_DIR) == 0) {
+                report(session, GREEN, "SERVER  >> Root directory created!");
+            } else {
+                report(session, RED, "ERROR   >> unable to create root directory");
+            }
+        } else {
+            report(session, RED, "ERROR   >> current directory does not exist");
+        }
+        return;
+    }
+
+    if (session == NULL) {
+        printf("\n");
+        setHighlight(YELLOW);
+        printf("DIRECTORY: %s/", path);
+        resetText();
+        printf("\n\n");
+    } else respond(session, "DIRECTORY: %s/", path);
+
+    struct dirent* entry;
+    while((entry = readdir(directory)) != NULL) {
+#ifdef __linux__
+        // the entry type usually comes for free, so only stat when it doesn't
+        int isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat fileInfo;
+            if (fstatat(dirfd(directory), entry->d_name, &fileInfo, AT_SYMLINK_NOFOLLOW) != 0) continue;
+            isDir = S_ISDIR(fileInfo.st_mode);
+        }
+#else
+        char filepath[MAX_PATH_SIZE];
+        snprintf(filepath, MAX_PATH_SIZE, "%s/%s", path, entry->d_name);
+        struct stat fileInfo;
+        if (stat(filepath, &fileInfo) != 0) continue;
+        int isDir = S_ISDIR(fileInfo.st_mode);
+#endif
+        if (session != NULL) {
+            respond(session, "%s%s", entry->d_name, isDir ? "/" : "");
+            continue;
+        }
+        if (isDir) setBoldText();
+        printf("%s\n", entry->d_name);
+        resetText();
+    }
+    if (session == NULL) printf("\n");
+
+    closedir(directory);
+}
+
+/**
+ * gets the path of a working directory, starting at the root
+ * directory, and copies it into the given path pointer
+*/
+void getWorkingDir(WorkDir* dir, char* path) {
+    strcpy(path, ROOT_DIR);
+    if (strlen(dir->relative) > 0) {
+        path[strlen(ROOT_DIR)] = '/';
+        strcpy(path + strlen(ROOT_DIR) + 1, dir->relative);
+    }
+}
+
+/**
+ * gets the working directory of a client, or of the admin when session is NULL
+*/
+WorkDir* workDirOf(Session* session) {
+    return session == NULL ? &g_adminDir : &session->dir;
+}
+
+/**
+ * gets a handle to the root directory, opening it the first time it exists
+*/
+int rootFd() {
+#ifdef __linux__
+    if (g_rootFd < 0) {
+        int fd = open(ROOT_DIR, O_PATH | O_DIRECTORY | O_CLOEXEC);
+        int expected = -1;
+        if (fd >= 0 && !__atomic_compare_exchange_n(&g_rootFd, &expected, fd, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            close(fd);
+    }
+#endif
+    return g_rootFd;
+}
+
+/**
+ * opens an item relative to a working directory. plain names are opened
+ * straight from the directory's handle and anything else from the root's,
+ * either way without being able to leave the root. returns -1 on failure
+*/
+int openItem(WorkDir* dir, char* name, int flags, int mode) {
+    char path[MAX_PATH_SIZE];
+    if (!resolvePath(dir->relative, name, path)) return -1;
+#ifdef __linux__
+    if (isPlainRelative(name)) return openBeneath(dir->fd >= 0 ? dir->fd : rootFd(), name, flags, mode);
+    char* relative = path + strlen(ROOT_DIR);
+    if (*relative == '/') relative++;
+    return openBeneath(rootFd(), relative[0] == '\0' ? "." : relative, flags, mode);
+#else
+    return open(path, flags, mode);
+#endif
+}
+
+/**
+ * checks that a directory can be reached from a working directory, looking
+ * it up from the same handles as openItem so links can't lead out of root
+*/
+int directoryExists(WorkDir* dir, char* name) {
+#ifdef __linux__
+    int fd = openItem(dir, name, O_PATH | O_DIRECTORY, 0);
+    if (fd < 0) return FALSE;
+    close(fd);
+    return TRUE;
+#else
+    char path[MAX_PATH_SIZE];
+    struct stat info;
+    return resolvePath(dir->relative, name, path) && stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+/**
+ * opens the directory holding a path made by resolvePath, from the root's
+ * handle so it can't be left, and points name at the path's last step. on
+ * windows dir is -1 and name is the whole path. returns FALSE on failure
+*/
+int openParent(char* path, int* dir, char** name) {
+#ifdef _WIN32
+    *dir = -1;
+    *name = path;
+    return TRUE;
+#else
+    char* slash = strrchr(path, '/');
+    if (slash == NULL) return FALSE;
+    *slash = '\0';
+    char* relative = rootRelative(path);
+#ifdef __linux__
+    *dir = openBeneath(rootFd(), relative[0] == '\0' ? "." : relative, O_PATH | O_DIRECTORY, 0);
+#else
+    *dir = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+    *slash = '/';
+    *name = slash + 1;
+    return *dir >= 0;
+#endif
+}
+
+/**
+ * prints a line to the admin console, or sends it to a client
+ * when session isn't NULL
+*/
+void report(Session* session, int color, char* format, ...) {
+    char text[PACKET_SIZE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, PACKET_SIZE, format, args);
+    va_end(args);
+    if (session != NULL) {
+        respond(session, "%s", text);
+        return;
+    }
+    setTextColor(color);
+    printf("%s\n", text);
+    resetText();
+}
+
+/**
+ * builds the path to an item given relative to a working directory (or
+ * to the root directory if it starts with a slash), resolving any . and ..
+ * steps along the way. returns FALSE if the item would be outside of root
+*/
+int resolvePath(char* relative, char* name, char* path) {
+    int rootLength = strlen(ROOT_DIR);
+    int length = rootLength;
+    strcpy(path, ROOT_DIR);
+
+    // walk the working directory first unless the name is absolute
+    for (int pass = (name[0] == '/' || name[0] == '\\') ? 1 : 0; pass < 2; pass++) {
+        char* steps = pass == 0 ? relative : name;
+        int start = 0;
+        for (int i = 0; ; i++) {
+            if (steps[i] != '/' && steps[i] != '\\' && steps[i] != '\0') continue;
+            int stepLength = i - start;
+            if (stepLength == 2 && steps[start] == '.' && steps[start + 1] == '.') {
+                if (length == rootLength) return FALSE;
+                while (path[length - 1] != '/') length--;
+                path[--length] = '\0';
+            } else if (stepLength > 0 && !(stepLength == 1 && steps[start] == '.')) {
+                if (memchr(steps + start, ':', stepLength) != NULL) return FALSE; // no drive letters or streams
+                if (length + stepLength + 2 >= MAX_PATH_SIZE) return FALSE;
+                path[length++] = '/';
+                memcpy(path + length, steps + start, stepLength);
+                length += stepLength;
+                path[length] = '\0';
+            }
+            if (steps[i] == '\0') break;
+            start = i + 1;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * resolves where a copy or move of source should end up. if the name
+ * is an existing directory the source is placed inside of it
+*/
+int resolveTarget(WorkDir* dir, char* source, char* name, char* target) {
+    if (!resolvePath(dir->relative, name, target)) return FALSE;
+    if (directoryExists(dir, name)) {
+        char* base = strrchr(source, '/');
+        if (strlen(target) + strlen(base) >= MAX_PATH_SIZE) return FALSE;
+        strcat(target, base);
+    }
+    return TRUE;
+}
+
+/**
+ * checks if a path is the same as or somewhere inside of the parent path
+*/
+int isInside(char* path, char* parent) {
+    int length = strlen(parent);
+    return strncmp(path, parent, length) == 0 && (path[length] == '/' || path[length] == '\0');
+}
+
+/**
+ * copies a file or directory to a new location inside of root
+*/
+void copyItem(char* from, char* to) {
+    char source[MAX_PATH_SIZE];
+    char target[MAX_PATH_SIZE];
+    if (!resolvePath(g_adminDir.relative, from, source) || !resolveTarget(&g_adminDir, source, to, target)) {
+        setTextColor(RED);
+        printf("ERROR   >> paths must stay inside of the root directory\n");
+        resetText();
+        return;
+    } else if (isInside(target, source)) {
+        setTextColor(RED);
+        printf("ERROR   >> cannot copy a directory into itself\n");
+        resetText();
+        return;
+    }
+
+    // both ends are looked up from handles opened beneath the root,
+    // so a symlink along the way can't lead the copy out of it
+    int fromDir = -1, toDir = -1;
+    char* fromName;
+    char* toName;
+    struct stat info;
+    if (strcmp(source, ROOT_DIR) == 0 || !openParent(source, &fromDir, &fromName) || statAt(fromDir, fromName, &info) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> item does not exist or is not accessible\n");
+        resetText();
+    } else if (!openParent(target, &toDir, &toName)) {
+        setTextColor(RED);
+        printf("ERROR   >> the directory to copy into does not exist or is not accessible\n");
+        resetText();
+    } else if (statAt(toDir, toName, &info) == 0) {
+        setTextColor(RED);
+        printf("ERROR   >> %s already exists\n", target);
+        resetText();
+    } else if (fitsQuota(target, source, NULL)) {
+        CopyStats stats = { 0 };
+        long long start = getTimeMicros();
+        int result = copyTree(fromDir, fromName, toDir, toName, &stats);
+        refreshUsage(&g_usage, rootRelative(target), TRUE);
+        double seconds = (getTimeMicros() - start) / 1000000.0;
+        if (result != 0) {
+            setTextColor(RED);
+            printf("ERROR   >> failed to copy %lld items\n", stats.failed);
+            resetText();
+        }
+        printf("SERVER  >> copied %lld files and %lld directories (%lld bytes, %lld cloned) in %.3fs\n",
+            stats.files, stats.directories, stats.bytes, stats.cloned, seconds);
+    }
+    if (fromDir >= 0) close(fromDir);
+    if (toDir >= 0) close(toDir);
+}
+
+/**
+ * moves a file or directory to a new location inside of root
+*/
+void moveItem(char* from, char* to) {
+    char source[MAX_PATH_SIZE];
+    char target[MAX_PATH_SIZE];
+    if (!resolvePath(g_adminDir.relative, from, source) || !resolveTarget(&g_adminDir, source, to, target)) {
+        setTextColor(RED);
+        printf("ERROR   >> paths must stay inside of the root directory\n");
+        resetText();
+        return;
+    } else if (isInside(target, source)) {
+        setTextColor(RED);
+        printf("ERROR   >> cannot move a directory into itself\n");
+        resetText();
+        return;
+    }
+
+    int fromDir = -1, toDir = -1;
+    char* fromName;
+    char* toName;
+    struct stat info;
+    if (strcmp(source, ROOT_DIR) == 0 || !openParent(source, &fromDir, &fromName) || statAt(fromDir, fromName, &info) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> item does not exist or is not accessible\n");
+        resetText();
+    } else if (!openParent(target, &toDir, &toName)) {
+        setTextColor(RED);
+        printf("ERROR   >> the directory to move into does not exist or is not accessible\n");
+        resetText();
+    } else if (fitsQuota(target, source, source)) {
+        if (movePath(fromDir, fromName, toDir, toName) != 0) {
+            setTextColor(RED);
+            printf("ERROR   >> unable to move %s to %s\n", source, target);
+            resetText();
+        } else {
+            refreshUsage(&g_usage, rootRelative(source), TRUE);
+            refreshUsage(&g_usage, rootRelative(target), TRUE);
+            printf("SERVER  >> moved %s to %s\n", source, target);
+        }
+    }
+    if (fromDir >= 0) close(fromDir);
+    if (toDir >= 0) close(toDir);
+}
+
+/**
+ * renames a file or directory without moving it
+*/
+void renameItem(char* item, char* name) {
+    char source[MAX_PATH_SIZE];
+    char target[MAX_PATH_SIZE];
+    if (strpbrk(name, "/\\:") != NULL || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        setTextColor(RED);
+        printf("ERROR   >> new name cannot be a path\n");
+        resetText();
+        return;
+    } else if (!resolvePath(g_adminDir.relative, item, source) || strcmp(source, ROOT_DIR) == 0) {
+        setTextColor(RED);
+        printf("ERROR   >> item does not exist or is not accessible\n");
+        resetText();
+        return;
+    }
+
+    // swap out the last step of the path for the new name
+    int parentLength = strrchr(source, '/') - source;
+    if (parentLength + strlen(name) + 2 >= MAX_PATH_SIZE) return;
+    memcpy(target, source, parentLength);
+    sprintf(target + parentLength, "/%s", name);
+
+    // both names live in the same directory, opened once beneath the root
+    int dir;
+    char* current;
+    char* renamed;
+    if (!openParent(source, &dir, &current)) {
+        setTextColor(RED);
+        printf("ERROR   >> item does not exist or is not accessible\n");
+        resetText();
+        return;
+    }
+#ifdef _WIN32
+    renamed = target;
+#else
+    renamed = name;
+#endif
+    if (movePath(dir, current, dir, renamed) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> unable to rename %s to %s\n", source, name);
+        resetText();
+    } else {
+        refreshUsage(&g_usage, rootRelative(source), TRUE);
+        refreshUsage(&g_usage, rootRelative(target), TRUE);
+        printf("SERVER  >> renamed %s to %s\n", source, name);
+    }
+    if (dir >= 0) close(dir);
+}
+
+/**
+ * shows the admin or a client how many bytes and files are below a
+ * directory, along with its quota if it has one. the totals are kept up
+ * to date as things change, so nothing is walked to answer
+*/
+void showUsage(Session* session, char* name) {
+    char path[MAX_PATH_SIZE];
+    if (!resolvePath(workDirOf(session)->relative, name, path)) {
+        report(session, RED, "ERROR   >> paths must stay inside of the root directory");
+        return;
+    }
+    char* relative = rootRelative(path);
+    long long bytes, files;
+    if (!getUsage(&g_usage, relative, &bytes, &files)) {
+        report(session, RED, "ERROR   >> %s does not exist or is not accessible", name);
+        return;
+    }
+
+    char limit[128] = { 0 };
+    pthread_mutex_lock(&g_usage.lock);
+    for (int i = 0; i < g_usage.quotaCount; i++) {
+        Quota* quota = &g_usage.quotas[i];
+        if (strcmp(quota->path, relative) != 0) continue;
+        int over = (quota->bytes > 0 && bytes > quota->bytes) || (quota->files > 0 && files > quota->files);
+        snprintf(limit, sizeof(limit), " of a quota of %lld bytes and %lld files%s", quota->bytes, quota->files, over ? ", over it" : "");
+    }
+    pthread_mutex_unlock(&g_usage.lock);
+    report(session, YELLOW, "SERVER  >> R:/%s holds %lld bytes in %lld files%s", relative, bytes, files, limit);
+}
+
+/**
+ * sets the quota on a directory, or lists every quota when given nothing.
+ * a limit of 0 leaves that side unlimited, and 0 for both takes it away
+*/
+void setDirectoryQuota(char** args, int numargs) {
+    if (numargs == 0) {
+        pthread_mutex_lock(&g_usage.lock);
+        if (g_usage.quotaCount == 0) printf("SERVER  >> no directories have quotas\n");
+        for (int i = 0; i < g_usage.quotaCount; i++) {
+            Quota* quota = &g_usage.quotas[i];
+            UsageNode* node = findUsage(&g_usage, quota->path);
+            printf("\tR:/%-30s %lld of %lld bytes, %lld of %lld files\n", quota->path, node == NULL ? 0 : node->bytes,
+                quota->bytes, node == NULL ? 0 : node->files, quota->files);
+        }
+        pthread_mutex_unlock(&g_usage.lock);
+        return;
+    }
+    char path[MAX_PATH_SIZE];
+    long long bytes = numargs >= 2 ? parseSize(args[1]) : -1;
+    long long files = numargs == 3 ? parseSize(args[2]) : 0;
+    if (numargs < 2 || numargs > 3 || bytes < 0 || files < 0) {
+        setTextColor(RED);
+        printf("ERROR   >> Usage is [/quota] <dir> <bytes> [files], with sizes like 512, 64k, 10M or 2G\n");
+        resetText();
+        return;
+    } else if (!resolvePath(g_adminDir.relative, args[0], path) || !directoryExists(&g_adminDir, args[0])) {
+        setTextColor(RED);
+        printf("ERROR   >> Directory does not exist or is not accessible\n");
+        resetText();
+        return;
+    }
+    char* relative = rootRelative(path);
+    if (setQuota(&g_usage, relative, bytes, files) != 0) {
+        setTextColor(RED);
+        printf("ERROR   >> there can only be %d quotas\n", MAX_QUOTAS);
+        resetText();
+        return;
+    }
+    if (bytes == 0 && files == 0) printf("SERVER  >> R:/%s no longer has a quota\n", relative);
+    else printf("SERVER  >> R:/%s can now hold %lld bytes and %lld files (0 is unlimited)\n", relative, bytes, files);
+}
+
+/**
+ * checks that putting a copy of source at target, or a new empty file
+ * there when source is NULL, keeps every directory within its quota. a
+ * move also passes where it comes from. tells the admin why if it doesn't
 */
-void addChat(char* chat) {
-    strcpy(g_chatLog[g_logIndex], chat);
-    g_logIndex++;
+int fitsQuota(char* target, char* source, char* from) {
+    long long bytes = 0, files = 1;
+    if (source != NULL) {
+        char* relative = rootRelative(source);
+        if (!getUsage(&g_usage, relative, &bytes, &files)) {
+            refreshUsage(&g_usage, relative, TRUE);
+            getUsage(&g_usage, relative, &bytes, &files);
+        }
+    }
+    char over[MAX_PATH_SIZE];
+    if (checkQuota(&g_usage, rootRelative(target), from == NULL ? NULL : rootRelative(from), bytes, files, over))
+        return TRUE;
+    setTextColor(RED);
+    printf("ERROR   >> that would put R:/%s over its quota\n", over);
+    resetText();
+    return FALSE;
 }
 
 /**
- * adds a user into the recorded current
- * users
+ * gets the part of a resolved path below the root, which is
+ * empty for the root itself
 */
-void addUser(int socket_fd) {
-    g_clients[g_clientIndex] = socket_fd;
-    g_clientIndex++;
+char* rootRelative(char* path) {
+    char* relative = path + strlen(ROOT_DIR);
+    return *relative == '/' ? relative + 1 : relative;
 }
 
 /**
- * compares a given buffer to a command and it's respective shortcut
+ * splits a command into its arguments in place. arguments are separated
+ * by spaces unless they are in quotes. returns the number of arguments
 */
-int compareCommand(char* buffer, char* command, char* shortcut) {
-    return (strcmp(buffer, command) == 0 || strcmp(buffer, shortcut) == 0);
+int tokenize(char* command, char** args, int maxArgs) {
+    int numargs = 0;
+    char* read = command;
+    char* write = command;
+    while (*read != '\0' && numargs < maxArgs) {
+        while (*read == ' ') read++;
+        if (*read == '\0') break;
+        args[numargs++] = write;
+        int inquotes = FALSE;
+        while (*read != '\0' && (inquotes || *read != ' ')) {
+            if (*read == '"') inquotes = !inquotes;
+            else *write++ = *read;
+            read++;
+        }
+        if (*read != '\0') read++;
+        *write++ = '\0';
+    }
+    return numargs;
 }
 
 /**
- * compares arguments and prints out error if false, and returns whether
- * number of arguments were valid or not.
+ * runs a command sent in by a client. anything the client
+ * should see about it is sent back as a response
 */
-int confirmArgs(int numArgs, int desiredArgs) {
-    if (numArgs != desiredArgs) {
-        setTextColor(RED);
-        printf("ERROR   >> Invalid use of command. Received %d arguments, should've received %d.\n", numArgs - 1, desiredArgs - 1);
-        resetText();
-        return 0;
+void handleCommand(Session* session, char* text) {
+    if (session == NULL) return;
+
+    // a fetch names one file per line, since the names can have spaces in them
+    if (strncmp(text, "fetch\n", 6) == 0) {
+        sendFiles(session, text + 6);
+        return;
+    }
+
+    char command[PACKET_SIZE];
+    char* args[MAX_ARGS];
+    strncpy(command, text, PACKET_SIZE - 1);
+    command[PACKET_SIZE - 1] = '\0';
+    int numargs = tokenize(command, args, MAX_ARGS);
+    if (numargs == 0) return;
+
+    if (strcmp(args[0], "getdir") == 0) {
+        if (numargs == 2 || (numargs == 3 && strcmp(args[2], "-z") == 0))
+            sendDirectory(session, args[1], numargs == 3);
+        else respond(session, "ERROR   >> Usage is [/getdir] <dir> [-z]");
+    } else if (strcmp(args[0], "manifest") == 0) {
+        if (numargs == 2 || numargs == 3) sendManifest(session, args[1], numargs == 3 ? args[2] : "0");
+        else respond(session, "ERROR   >> Usage is manifest <dir> [digest]");
+    } else if (strcmp(args[0], "changedir") == 0) {
+        if (numargs == 2) {
+            if (changeDirectory(session, args[1]))
+                respond(session, "SERVER  >> working directory is now R:/%s", session->dir.relative);
+        } else respond(session, "ERROR   >> Usage is [/changedir] <dir>");
+    } else if (strcmp(args[0], "list") == 0) {
+        listDirectory(session);
+    } else if (strcmp(args[0], "search") == 0) {
+        searchChat(session, args + 1, numargs - 1);
+    } else if (strcmp(args[0], "watch") == 0) {
+        if (numargs <= 2) watchDirectory(session, numargs == 2 ? args[1] : NULL);
+        else respond(session, "ERROR   >> Usage is [/watch] <dir>");
+    } else if (strcmp(args[0], "browse") == 0 || strcmp(args[0], "read") == 0) {
+        int kind = args[0][0] == 'b' ? STREAM_LISTING : STREAM_CONTENT;
+        if (numargs == 2 || numargs == 3) sendCached(session, kind, args[1], numargs == 3 ? args[2] : "-");
+        else respond(session, "ERROR   >> Usage is %s <path> [version]", args[0]);
+    } else if (strcmp(args[0], "du") == 0) {
+        if (numargs <= 2) showUsage(session, numargs == 2 ? args[1] : ".");
+        else respond(session, "ERROR   >> Usage is [/du] [dir]");
+    } else if (strcmp(args[0], "hash") == 0) {
+        if (numargs == 2 || (numargs == 3 && strcmp(args[2], "-b") == 0))
+            hashItem(session, args[1], numargs == 3);
+        else respond(session, "ERROR   >> Usage is [/hash] <file> [-b]");
+    } else {
+        respond(session, "ERROR   >> Invalid command");
     }
-    return 1;
 }
 
 /**
- * Changes the working directory to the specified directory
+ * sends a line of text back to a single client
 */
-void changeDirectory(char* directory) {
-    //if (directory[0] == '.' && directory[1] == '.') {
-    //    if (strlen(g_relativePath) <= 0) {
-    //       setTextColor(RED);
-    //        printf("ERROR   >> Cannot go back further than the root directory\n");
-    //        resetText();
-    //    } 
-    //}
-    char path[MAX_PATH_SIZE];
-    getWorkingDir(path);
-
-    //parse steps
-    while(directory[strlen(directory) - 1] == '/' || directory[strlen(directory) - 1] == '\\') directory[strlen(directory) - 1] = '\0'; // get rid of trailing slashes
-    while(directory[0] == '/' || directory[0] == '\\') strcpy(directory, directory + 1); // get rid of forward slashes
-    int numsteps = 1;
-    for(int i = 0; i < strlen(directory); i++)
-        if (directory[i] == '/' || directory[i] == '\\')
-            numsteps++;
-    char steps[numsteps][strlen(directory)];
-    char step[strlen(directory)];
-    int stepindex = 0;
-    int stepsindex = 0;
-    for(int i = 0; i < strlen(directory); i++) {
-        if (directory[i] == '/' || directory[i] == '\\') {
-            step[stepindex] = '\0';
-            stepindex = 0;
-            strcpy(steps[stepsindex], step);
-            memset(step, '\0', strlen(directory));
-            stepsindex++;
-        } else step[stepindex++] = directory[i];
-    }
-    step[stepindex] = '\0';
-    strcpy(steps[stepsindex], step);
-
-    // construct complete path
-    for(int i = 0; i < numsteps; i++) {
-        if (strcmp(steps[i], "..") == 0) {
-            if (strlen(path) != strlen(ROOT_DIR)) {
-                while (path[strlen(path) - 1] != '/' && path[strlen(path) - 1] != '\\') path[strlen(path) - 1] = '\0'; // delete step
-                path[strlen(path) - 1] = '\0'; // get rid of trailing slash
-            } else {
-                setTextColor(RED);
-                printf("ERROR   >> Cannot go back further than the root directory\n");
-                resetText();
-                return;
-            }
-        } else {
-            int pathlen = strlen(path);
-            path[pathlen] = '/';
-            strcpy(path + pathlen + 1, steps[i]);
+void respond(Session* session, char* format, ...) {
+    char text[PACKET_SIZE];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, PACKET_SIZE, format, args);
+    va_end(args);
+    if (length < 0) return;
+    if (length >= PACKET_SIZE) length = PACKET_SIZE - 1;
+    Packet* packet = makePacket(&g_packetPool, RESPONSE, text, length);
+    if (packet == NULL) return;
+    unicastPacket(session, packet);
+    releasePacket(packet);
+}
+
+/**
+ * queues a packet for a single client and wakes up the output thread
+*/
+void unicastPacket(Session* session, Packet* packet) {
+    pthread_mutex_lock(&g_outputLock);
+    if (session->active && queuePacket(&session->output, packet)) {
+        if (g_pendingFrames++ == 0) {
+            g_batchStart = getTimeMicros();
+            pthread_cond_signal(&g_outputReady);
         }
+        g_pendingBytes += packet->length;
     }
+    pthread_mutex_unlock(&g_outputLock);
+}
 
-    // validate directory exists
-    DIR *dir = opendir(path);
-    if (dir) closedir(dir);
-    else {
-        setTextColor(RED);
-        printf("ERROR   >> Directory does not exist or is not accessible\n");
-        resetText();
+/**
+ * streams a tar of a directory to a client as the tree is walked, so no
+ * archive is ever written on the server. the archive is optionally gzipped
+*/
+void sendDirectory(Session* session, char* directory, int compress) {
+    ArchiveStream* stream = openStream(session, STREAM_DIRECTORY, directory, compress);
+    if (stream != NULL) startStream(session, stream);
+}
+
+/**
+ * streams a tar of some of the files in a directory to a client. the
+ * request is the directory followed by the files, one per line
+*/
+void sendFiles(Session* session, char* request) {
+    char* names = strchr(request, '\n');
+    if (names == NULL) {
+        respond(session, "ERROR   >> no files were asked for");
         return;
     }
-
-    // make path the g_relative path
-    strcpy(g_relativePath, path + strlen(ROOT_DIR) + 1);
+    *names++ = '\0';
+    ArchiveStream* stream = openStream(session, STREAM_FILES, request, FALSE);
+    if (stream == NULL) return;
+    stream->names = strdup(names);
+    startStream(session, stream);
 }
 
 /**
- * Reads from a specified file and outputs it to the terminal
+ * sends a client the manifest of a directory. if the client already has a
+ * manifest with the same digest, only the digest is sent back
 */
-void readFile(char* arg) {
-    //construct path
-    char path[MAX_PATH_SIZE];
-    getWorkingDir(path);
-    path[strlen(path)] = '/';
-    strcpy(path + strlen(path), arg);
+void sendManifest(Session* session, char* directory, char* digest) {
+    ArchiveStream* stream = openStream(session, STREAM_MANIFEST, directory, FALSE);
+    if (stream == NULL) return;
+    stream->digest = strtoull(digest, NULL, 16);
+    startStream(session, stream);
+}
 
-    FILE *file;
-    char ch;
-    file = fopen(path, "r");
-    if (file == NULL) {
-        setTextColor(RED);
-        printf("ERROR   >> File could not be opened or could not be found\n");
-        resetText();
+/**
+ * sends a client a directory listing or a file's contents for its cache.
+ * if the version the client has is still current, it only gets told so
+*/
+void sendCached(Session* session, int kind, char* name, char* version) {
+    ArchiveStream* stream = openStream(session, kind, name, FALSE);
+    if (stream == NULL) return;
+    // the version comes from the handle that gets sent, not from whatever the path now names
+    struct stat info;
+#ifdef _WIN32
+    int found = stat(stream->path, &info) == 0;
+#else
+    int found = fstat(stream->fd, &info) == 0;
+#endif
+    if (!found) {
+        respond(session, "ERROR   >> %s is no longer accessible", name);
+        closeStream(stream);
+        return;
+    }
+    formatVersion(&info, stream->version);
+    __atomic_add_fetch(&g_versionChecks, 1, __ATOMIC_RELAXED);
+    if (strcmp(version, stream->version) != 0) {
+        startStream(session, stream);
         return;
     }
 
-    do {
-        ch = fgetc(file);
-        putchar(ch);
+    // the reply names what was asked for the same way a fresh copy would
+    char* relative = stream->path + strlen(ROOT_DIR);
+    char text[MAX_PATH_SIZE + VERSION_SIZE + 4];
+    int length = snprintf(text, sizeof(text), "%s %c%s", stream->version, kind == STREAM_LISTING ? 'l' : 'f', *relative == '\0' ? "/" : relative);
+    closeStream(stream);
+    if (length >= PACKET_SIZE) return;
+    Packet* packet = makePacket(&g_packetPool, UNCHANGED, text, length);
+    if (packet == NULL) return;
+    unicastPacket(session, packet);
+    releasePacket(packet);
+    __atomic_add_fetch(&g_notModified, 1, __ATOMIC_RELAXED);
+}
 
-    } while(ch != EOF);
-    printf("\n");
-    fclose(file);
+/**
+ * makes the version of a file or directory that clients cache it under.
+ * anything that changes it changes its modification time, size or inode
+*/
+void formatVersion(struct stat* info, char* version) {
+    HashKey key;
+    makeHashKey(&key, info);
+    snprintf(version, VERSION_SIZE, "%llx-%llx-%llx", (unsigned long long)key.modified, key.size, key.inode);
 }
 
-void listDirectory() {
-    //construct path
+/**
+ * sets up a stream of a directory for a client, telling
+ * them why if it can't. returns NULL on failure
+*/
+ArchiveStream* openStream(Session* session, int kind, char* directory, int compress) {
     char path[MAX_PATH_SIZE];
-    getWorkingDir(path);
-    printf("path: %s\n", path);
+    struct stat info;
+    if (!resolvePath(session->dir.relative, directory, path)) {
+        respond(session, "ERROR   >> paths must stay inside of the root directory");
+        return NULL;
+    }
+#ifdef _WIN32
+    int fd = -1;
+    int found = stat(path, &info) == 0;
+#else
+    // opened beneath the working directory, so a symlink can't lead it out of the root
+    int fd = openItem(&session->dir, directory, kind == STREAM_CONTENT ? O_RDONLY | O_NONBLOCK : O_RDONLY | O_DIRECTORY, 0);
+    int found = fd >= 0 && fstat(fd, &info) == 0;
+#endif
+    if (kind == STREAM_CONTENT && (!found || !S_ISREG(info.st_mode))) {
+        if (fd >= 0) close(fd);
+        respond(session, "ERROR   >> File does not exist or is not accessible");
+        return NULL;
+    } else if (kind != STREAM_CONTENT && (!found || !S_ISDIR(info.st_mode))) {
+        if (fd >= 0) close(fd);
+        respond(session, "ERROR   >> Directory does not exist or is not accessible");
+        return NULL;
+    }
+#ifndef FHUB_ZLIB
+    compress = FALSE;
+#endif
+
+    ArchiveStream* stream = calloc(1, sizeof(ArchiveStream));
+    if (stream == NULL) {
+        if (fd >= 0) close(fd);
+        respond(session, "ERROR   >> server is out of memory");
+        return NULL;
+    }
+    stream->kind = kind;
+    stream->fd = fd;
+    stream->socket = session->socket;
+    stream->owner = session->id;
+    stream->slot = session->slot;
+    stream->chunk = MAX_PAYLOAD_SIZE;
+    stream->compress = compress;
+#ifdef __linux__
+    stream->link = session->link;
+
+    // keep what the kernel holds unsent down to about a chunk, so a chat
+    // sent in between frames isn't stuck behind megabytes of buffer
+    if (stream->link == NULL) setsockopt(session->socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &stream->chunk, sizeof(int));
+#endif
+    strcpy(stream->path, path);
+#ifdef FHUB_ZLIB
+    if (compress && deflateInit2(&stream->deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        closeStream(stream);
+        respond(session, "ERROR   >> failed to start compression");
+        return NULL;
+    }
+#endif
+    return stream;
+}
+
+/**
+ * sends a stream to its client and frees it. the io_uring backend
+ * hands it to a thread of its own, everything else sends it right away
+*/
+void startStream(Session* session, ArchiveStream* stream) {
+#ifdef __linux__
+    if (g_backend == BACKEND_URING) {
+        // the event loop can't block on a whole directory, so the transfer gets
+        // its own thread and its own copy of the socket, letting the loop close
+        // the client whenever it needs to without the number being reused
+        stream->socket = dup(session->socket);
+        pthread_t transferThread;
+        if (stream->socket >= 0 && pthread_create(&transferThread, NULL, runTransfer, stream) == 0) {
+            pthread_detach(transferThread);
+            return;
+        }
+        if (stream->socket >= 0) close(stream->socket);
+        stream->socket = session->socket;
+    }
+#endif
+    runStream(stream);
+    closeStream(stream);
+}
+
+/**
+ * sends whatever kind of stream this is
+*/
+void runStream(ArchiveStream* stream) {
+    if (stream->kind == STREAM_MANIFEST) streamManifest(stream);
+    else if (stream->kind == STREAM_LISTING) streamListing(stream);
+    else if (stream->kind == STREAM_CONTENT) streamContent(stream);
+    else streamDirectory(stream);
+}
+
+/**
+ * frees a stream once it's been sent
+*/
+void closeStream(ArchiveStream* stream) {
+    if (stream->fd >= 0) close(stream->fd);
+    free(stream->names);
+    free(stream->records);
+    free(stream);
+}
+
+/**
+ * transfer thread for the io_uring backend. sends the stream with
+ * file reads going through a ring of its own
+*/
+void* runTransfer(void* arg) {
+    ArchiveStream* stream = arg;
+    int socket_fd = stream->socket;
+#ifdef __linux__
+    Ring ring;
+    stream->ahead = malloc(MAX_PAYLOAD_SIZE * 2);
+    if (stream->ahead != NULL && initRing(&ring, TRANSFER_RING_ENTRIES) == 0) stream->ring = &ring;
+    runStream(stream);
+    if (stream->ring != NULL) closeRing(&ring);
+    free(stream->ahead);
+#else
+    runStream(stream);
+#endif
+    closeStream(stream);
+    close(socket_fd);
+    return NULL;
+}
+
+/**
+ * sends the directory at the stream's path, or just the files named in
+ * the stream, as a tar archive framed by an ARCHIVE_START and an ARCHIVE_END
+*/
+void streamDirectory(ArchiveStream* stream) {
+    // the archive is named after the directory, or ROOT for the root itself
+    char* path = stream->path;
+    char* name = strrchr(path, '/');
+    name = name == NULL ? path : name + 1;
+    long long start = getTimeMicros();
+    char* mode = stream->compress ? "tar.gz" : "tar";
+    sendArchiveFrame(stream, ARCHIVE_START, mode, strlen(mode));
+    if (stream->kind == STREAM_FILES) {
+        // files are named relative to the directory and must stay inside of it
+        char* next = stream->names;
+        while (*next != '\0' && !stream->broken) {
+            char* file = next;
+            next += strcspn(next, "\n");
+            if (*next != '\0') *next++ = '\0';
+            struct stat info;
+#ifdef _WIN32
+            char* filePath = isSafeTarPath(file) ? joinPath(path, file) : NULL;
+            int fd = filePath == NULL ? -1 : open(filePath, O_RDONLY | O_BINARY);
+            free(filePath);
+#else
+            int fd = isSafeTarPath(file) ? openBeneath(stream->fd, file, O_RDONLY | O_NOFOLLOW | O_NONBLOCK, 0) : -1;
+#endif
+            if (fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) archiveFile(stream, fd, file, &info);
+            else stream->failed++;
+            if (fd >= 0) close(fd);
+        }
+    } else {
+#ifdef _WIN32
+        archiveEntry(stream, -1, path, name);
+#else
+        archiveEntry(stream, stream->fd, ".", name);
+#endif
+    }
+    char end[TAR_BLOCK * 2] = { 0 };
+    archiveWrite(stream, end, sizeof(end));
+    archiveFlush(stream, TRUE);
+
+    char summary[128] = { 0 };
+    if (stream->failed > 0) sprintf(summary, "%lld items could not be read", stream->failed);
+    sendArchiveFrame(stream, ARCHIVE_END, summary, strlen(summary));
+    if (g_monitor) ASYNC_PRINT("MONITOR >> streamed %s to client %d (%lld files, %lld bytes in %.3fs)\n",
+        path, stream->socket, stream->files, stream->bytes, (getTimeMicros() - start) / 1000000.0);
+#ifdef FHUB_ZLIB
+    if (stream->compress) deflateEnd(&stream->deflater);
+#endif
+}
+
+/**
+ * sends the manifest of the directory at the stream's path as MANIFEST
+ * frames, each holding whole entries, then a MANIFEST_END with the digest
+ * and number of files. a client that already has this manifest only gets
+ * the MANIFEST_END
+*/
+void streamManifest(ArchiveStream* stream) {
+    long long start = getTimeMicros();
+#ifdef _WIN32
+    manifestEntry(stream, -1, stream->path, "");
+#else
+    manifestEntry(stream, stream->fd, ".", "");
+#endif
+    unsigned long long digest = hashBytes(stream->records, stream->recordsUsed, 0);
+    int unchanged = digest == stream->digest;
+
+    // the manifest is sent as is, a frame is cut before the entry that would overflow it
+    long long sent = 0;
+    while (!unchanged && sent < stream->recordsUsed && !stream->broken) {
+        long long end = sent;
+        ManifestEntry entry;
+        char name[MANIFEST_PATH_SIZE];
+        while (end < stream->recordsUsed) {
+            int left = stream->recordsUsed - end < MAX_PAYLOAD_SIZE ? (int)(stream->recordsUsed - end) : MAX_PAYLOAD_SIZE;
+            int length = getManifestEntry(stream->records + end, left, &entry, name);
+            if (length < 0 || end + length - sent > MAX_PAYLOAD_SIZE) break;
+            end += length;
+        }
+        sendArchiveFrame(stream, MANIFEST, stream->records + sent, end - sent);
+        sent = end;
+    }
+
+    char summary[64];
+    sprintf(summary, "%016llx %lld %d", digest, stream->files, unchanged);
+    sendArchiveFrame(stream, MANIFEST_END, summary, strlen(summary));
+    if (g_monitor) ASYNC_PRINT("MONITOR >> sent the manifest of %s to client %d (%lld files%s in %.3fs)\n", stream->path,
+        stream->socket, stream->files, unchanged ? ", unchanged" : "", (getTimeMicros() - start) / 1000000.0);
+}
 
-    struct stat sb;
-    if (stat(path, &sb) == 0 && S_ISDIR(sb.st_mode)) {
-        DIR* directory = opendir(path);
+/**
+ * sends the names in the directory at the stream's path for a client's
+ * cache, one per line with directories ending in a slash. they're framed
+ * by a CACHED_START with the version and a CACHED_END, which is empty
+ * unless the directory couldn't be read
+*/
+void streamListing(ArchiveStream* stream) {
+    char* relative = stream->path + strlen(ROOT_DIR);
+    char text[MAX_PATH_SIZE + VERSION_SIZE + 4];
+    int length = snprintf(text, sizeof(text), "%s l%s", stream->version, *relative == '\0' ? "/" : relative);
+    sendArchiveFrame(stream, CACHED_START, text, length);
+
+#ifdef _WIN32
+    DIR* directory = opendir(stream->path);
+#else
+    DIR* directory = openDirAt(stream->fd, ".");
+#endif
+    if (directory != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(directory)) != NULL && !stream->broken) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            struct stat info;
+#ifdef _WIN32
+            char* childPath = joinPath(stream->path, entry->d_name);
+            int isDirectory = childPath != NULL && stat(childPath, &info) == 0 && S_ISDIR(info.st_mode);
+            free(childPath);
+#else
+            int isDirectory = fstatat(dirfd(directory), entry->d_name, &info, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(info.st_mode);
+#endif
+            int nameLength = strlen(entry->d_name);
+            if (stream->used + nameLength + 2 > MAX_PAYLOAD_SIZE) {
+                sendArchiveFrame(stream, CACHED, stream->stage, stream->used);
+                stream->used = 0;
+            }
+            memcpy(stream->stage + stream->used, entry->d_name, nameLength);
+            stream->used += nameLength;
+            if (isDirectory) stream->stage[stream->used++] = '/';
+            stream->stage[stream->used++] = '\n';
+            stream->files++;
+        }
+        closedir(directory);
+    }
+    if (stream->used > 0) sendArchiveFrame(stream, CACHED, stream->stage, stream->used);
+    stream->used = 0;
+    char* error = directory == NULL ? "directory could not be read" : "";
+    sendArchiveFrame(stream, CACHED_END, error, strlen(error));
+}
+
+/**
+ * sends the contents of the file at the stream's path for a client's
+ * cache, framed the same way as a listing
+*/
+void streamContent(ArchiveStream* stream) {
+    char* relative = stream->path + strlen(ROOT_DIR);
+    char text[MAX_PATH_SIZE + VERSION_SIZE + 4];
+    int length = snprintf(text, sizeof(text), "%s f%s", stream->version, relative);
+    sendArchiveFrame(stream, CACHED_START, text, length);
+
+#ifdef _WIN32
+    FILE* file = fopen(stream->path, "rb");
+#else
+    // the file takes over the handle openStream opened
+    FILE* file = fdopen(stream->fd, "rb");
+    if (file != NULL) stream->fd = -1;
+#endif
+    int got = 0;
+    while (file != NULL && !stream->broken && (got = fread(stream->stage, 1, stream->chunk, file)) > 0) {
+        countIo(1, 0, 0);
+        sendArchiveFrame(stream, CACHED, stream->stage, got);
+    }
+    char* error = file == NULL || ferror(file) ? "file could not be read" : "";
+    if (file != NULL) fclose(file);
+    sendArchiveFrame(stream, CACHED_END, error, strlen(error));
+}
+
+/**
+ * adds a file, or every file inside of a directory, to the manifest being
+ * built. item is its name inside of the directory at, or its whole path on
+ * windows, and symlinks are left out rather than followed. hashes come from
+ * the hash cache, so only new or changed files are read
+*/
+void manifestEntry(ArchiveStream* stream, int at, char* item, char* name) {
+    struct stat info;
+#ifdef _WIN32
+    if (stat(item, &info) != 0) {
+#else
+    if (fstatat(at, item, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+#endif
+        stream->failed++;
+        return;
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+#ifdef _WIN32
+        DIR* directory = opendir(item);
+#else
+        DIR* directory = openDirAt(at, item);
+#endif
         if (directory == NULL) {
-            setTextColor(RED);
-            printf("ERROR   >> failed to open directory\n");
-            resetText();
+            stream->failed++;
+            return;
+        }
+        struct dirent* entry;
+        while ((entry = readdir(directory)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            char* childName = name[0] == '\0' ? strdup(entry->d_name) : joinPath(name, entry->d_name);
+#ifdef _WIN32
+            char* childPath = joinPath(item, entry->d_name);
+            if (childPath != NULL && childName != NULL) manifestEntry(stream, -1, childPath, childName);
+            free(childPath);
+#else
+            if (childName != NULL) manifestEntry(stream, dirfd(directory), entry->d_name, childName);
+#endif
+            free(childName);
+        }
+        closedir(directory);
+        return;
+    } else if (!S_ISREG(info.st_mode)) {
+        return;
+    }
+
+    // the cache knows files by their path under the root
+    char relative[MAX_PATH_SIZE];
+    char* top = stream->path + strlen(ROOT_DIR);
+    if (*top == '/') top++;
+    int fits = (top[0] == '\0' ? snprintf(relative, MAX_PATH_SIZE, "%s", name) :
+        snprintf(relative, MAX_PATH_SIZE, "%s/%s", top, name)) < MAX_PATH_SIZE;
+    if (!fits) {
+        stream->failed++;
+        return;
+    }
+    HashKey key;
+    HashResult result;
+    makeHashKey(&key, &info);
+    if (!lookupHash(&g_hashCache, &key, FALSE, &result)) {
+#ifdef _WIN32
+        int fd = open(item, O_RDONLY | O_BINARY);
+#else
+        int fd = openat(at, item, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+#endif
+        int failed = fd < 0 || fstat(fd, &info) != 0;
+        if (!failed) makeHashKey(&key, &info);
+        if (failed || cacheFile(&g_hashCache, fd, relative, &key, FALSE, &result) != 0) {
+            if (fd >= 0) close(fd);
+            stream->failed++;
+            return;
+        }
+        close(fd);
+    }
+
+    if (stream->recordsSize - stream->recordsUsed < MANIFEST_RECORD_MAX) {
+        stream->recordsSize = stream->recordsSize == 0 ? MAX_PAYLOAD_SIZE : stream->recordsSize * 2;
+        stream->records = realloc(stream->records, stream->recordsSize);
+    }
+    int length = putManifestEntry(stream->records + stream->recordsUsed, name, key.size, key.modified, result.hash);
+    if (length == 0) stream->failed++;
+    else stream->files++;
+    stream->recordsUsed += length;
+}
+
+/**
+ * adds a file or directory, and everything inside of it, to the archive.
+ * item is its name inside of the directory at, or its whole path on windows,
+ * and symlinks are left out rather than followed
+*/
+void archiveEntry(ArchiveStream* stream, int at, char* item, char* name) {
+    struct stat info;
+    if (stream->broken) return;
+#ifdef _WIN32
+    if (stat(item, &info) != 0) {
+#else
+    if (fstatat(at, item, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+#endif
+        stream->failed++;
+        return;
+    }
+
+    if (S_ISREG(info.st_mode)) {
+#ifdef _WIN32
+        int file = open(item, O_RDONLY | O_BINARY);
+#else
+        int file = openat(at, item, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+#endif
+        if (file < 0) {
+            stream->failed++;
             return;
         }
+        archiveFile(stream, file, name, &info);
+        close(file);
+    } else if (S_ISDIR(info.st_mode)) {
+        char header[TAR_HEADER_MAX];
+        char* directoryName = joinPath(name, "");
+        int length = directoryName == NULL ? 0 : writeTarHeader(header, directoryName, 0, info.st_mode, info.st_mtime, '5');
+        free(directoryName);
+        archiveWrite(stream, header, length);
 
+#ifdef _WIN32
+        DIR* directory = opendir(item);
+#else
+        DIR* directory = openDirAt(at, item);
+#endif
+        if (directory == NULL) {
+            stream->failed++;
+            return;
+        }
         struct dirent* entry;
-        printf("\n");
-        setHighlight(YELLOW);
-        printf("DIRECTORY: %s/", path);
-        resetText();
-        printf("\n\n");
-        while((entry = readdir(directory)) != NULL) {
-            char filepath[MAX_PATH_SIZE];
-            strcpy(filepath, path);
-            filepath[strlen(path)] = '/';
-            strcpy(filepath + strlen(path) + 1, entry->d_name);
+        while ((entry = readdir(directory)) != NULL && !stream->broken) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            char* childName = joinPath(name, entry->d_name);
+#ifdef _WIN32
+            char* childPath = joinPath(item, entry->d_name);
+            if (childPath != NULL && childName != NULL) archiveEntry(stream, -1, childPath, childName);
+            free(childPath);
+#else
+            if (childName != NULL) archiveEntry(stream, dirfd(directory), entry->d_name, childName);
+#endif
+            free(childName);
+        }
+        closedir(directory);
+    }
+}
 
-            struct stat fileInfo;
-            if (stat(filepath, &fileInfo) == 0) {
-                if (S_ISDIR(fileInfo.st_mode)) {
-                    setBoldText();
+/**
+ * adds a single file, already opened by the caller, to the archive. big
+ * files on linux skip the staging buffer and are sent straight from the
+ * page cache with sendfile
+*/
+void archiveFile(ArchiveStream* stream, int file, char* name, struct stat* info) {
+    char header[TAR_HEADER_MAX];
+    long long size = info->st_size;
+    int length = writeTarHeader(header, name, size, info->st_mode, info->st_mtime, '0');
+    if (length == 0) {
+        stream->failed++;
+        return;
+    }
+    static const char zeros[TAR_BLOCK] = { 0 };
+
+#ifdef __linux__
+    if (!stream->compress && stream->link == NULL && size >= ZERO_COPY_THRESHOLD) {
+        archiveWrite(stream, header, length);
+        archiveFlush(stream, FALSE);
+        off_t offset = 0;
+        while (offset < size && !stream->broken) {
+            int chunk = size - offset < stream->chunk ? (int)(size - offset) : stream->chunk;
+            char frame[HEADER_SIZE];
+            writeHeader(frame, ARCHIVE, chunk);
+            long long start = getTimeMicros();
+            long long calls = 0;
+            int urgent = beginBulk(stream, &calls);
+            int length = chunk;
+            int failed = urgent < 0 || send(stream->socket, frame, HEADER_SIZE, MSG_MORE | MSG_NOSIGNAL) != HEADER_SIZE;
+            countIo(1, 0, HEADER_SIZE);
+            while (!failed && chunk > 0) {
+                ssize_t sent = sendfile(stream->socket, file, &offset, chunk);
+                countIo(1, 0, sent);
+                if (sent < 0 && errno == EINTR) continue;
+                if (sent == 0) {
+                    // the file shrank under us, so fill out the promised size with zeros
+                    int fill = chunk < TAR_BLOCK ? chunk : TAR_BLOCK;
+                    sent = send(stream->socket, zeros, fill, MSG_NOSIGNAL);
+                    if (sent > 0) offset += sent;
                 }
-                printf("%s\n", entry->d_name);
-                resetText();
+                if (sent <= 0) failed = TRUE;
+                else chunk -= sent;
             }
+            endBulk(stream, urgent, calls, start, length);
+            if (failed) stream->broken = TRUE;
         }
-        printf("\n");
+        stream->bytes += size;
+        stream->files++;
+        archiveWrite(stream, zeros, tarPadding(size));
+        return;
+    }
+#endif
 
-        closedir(directory);
-    } else {
-        // directory doesn't exist
-        if (strlen(g_relativePath) == 0) {
-            setTextColor(YELLOW);
-            printf("SERVER  >> No root directory detected. Creating a new directory...\n");
-            if (_mkdir(ROOT_DIR) == 0) {
-                setTextColor(GREEN);
-                printf("SERVER  >> Root directory created!\n");
-            } else {
-                setTextColor(RED);
-                printf("ERROR   >> unable to create root directory\n");
+#ifdef __linux__
+    if (stream->ring != NULL) {
+        archiveWrite(stream, header, length);
+        archiveRead(stream, file, size);
+        stream->files++;
+        archiveWrite(stream, zeros, tarPadding(size));
+        return;
+    }
+#endif
+
+    archiveWrite(stream, header, length);
+
+    // read straight into the staging buffer
+    long long remaining = size;
+    while (remaining > 0 && !stream->broken) {
+        if (stream->used >= stream->chunk) archiveFlush(stream, FALSE);
+        int space = stream->chunk - stream->used;
+        int wanted = remaining < space ? (int)remaining : space;
+        int got = read(file, stream->stage + stream->used, wanted);
+        countIo(1, 0, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            // the file shrank under us, so fill out the promised size with zeros
+            memset(stream->stage + stream->used, 0, wanted);
+            got = wanted;
+        }
+        stream->used += got;
+        remaining -= got;
+    }
+    stream->files++;
+    archiveWrite(stream, zeros, tarPadding(size));
+}
+
+#ifdef __linux__
+/**
+ * reads a file into the archive through the stream's ring. two chunks
+ * are kept in flight, so the next read is already happening while the
+ * current chunk is compressed and sent, and every wait for a chunk also
+ * submits the read that refills the buffer just used
+*/
+int archiveRead(ArchiveStream* stream, int file, long long size) {
+    char* buffers[2] = { stream->ahead, stream->ahead + MAX_PAYLOAD_SIZE };
+    int lengths[2] = { 0 };
+    int results[2] = { 0 };
+    int busy[2] = { 0 };
+    long long issued = 0;
+    long long done = 0;
+    int cur = 0;
+    for (int b = 0; b < 2 && issued < size; b++) {
+        lengths[b] = size - issued < MAX_PAYLOAD_SIZE ? (int)(size - issued) : MAX_PAYLOAD_SIZE;
+        prepRead(nextSqe(stream->ring), file, buffers[b], lengths[b], issued, b);
+        busy[b] = TRUE;
+        issued += lengths[b];
+    }
+
+    while (done < size && !stream->broken) {
+        while (busy[cur]) {
+            if (submitRing(stream->ring, 1) < 0) {
+                stream->broken = TRUE;
+                return -1;
+            }
+            countIo(1, 0, 0);
+            struct io_uring_cqe* cqe;
+            while ((cqe = peekCompletion(stream->ring)) != NULL) {
+                results[cqe->user_data] = cqe->res;
+                busy[cqe->user_data] = FALSE;
+                seenCompletion(stream->ring);
             }
-        } else {
-            setTextColor(RED);
-            printf("ERROR   >> current directory does not exist\n");
         }
-        resetText();
+
+        // the file shrank under us, so fill out the promised size with zeros
+        int got = results[cur] < 0 ? 0 : results[cur];
+        if (got < lengths[cur]) memset(buffers[cur] + got, 0, lengths[cur] - got);
+        archiveWrite(stream, buffers[cur], lengths[cur]);
+        done += lengths[cur];
+
+        if (issued < size) {
+            lengths[cur] = size - issued < MAX_PAYLOAD_SIZE ? (int)(size - issued) : MAX_PAYLOAD_SIZE;
+            prepRead(nextSqe(stream->ring), file, buffers[cur], lengths[cur], issued, cur);
+            busy[cur] = TRUE;
+            issued += lengths[cur];
+        }
+        cur = !cur;
+    }
+
+    // don't hand the buffers back while the kernel could still be filling them
+    while (busy[0] || busy[1]) {
+        if (submitRing(stream->ring, 1) < 0) break;
+        struct io_uring_cqe* cqe;
+        while ((cqe = peekCompletion(stream->ring)) != NULL) {
+            busy[cqe->user_data] = FALSE;
+            seenCompletion(stream->ring);
+        }
     }
+    return stream->broken ? -1 : 0;
 }
+#endif
 
 /**
- * gets the working directory and copies it into
- * the given path pointer
+ * copies bytes into the staging buffer, sending it
+ * off whenever it fills up
 */
-void getWorkingDir(char* path) {
-    strcpy(path, ROOT_DIR);
-    if (strlen(g_relativePath) > 0) {
-        path[strlen(ROOT_DIR) + 1] = '/';
-        memcpy(path + strlen(ROOT_DIR) + 1, g_relativePath, strlen(g_relativePath));
-        path[strlen(ROOT_DIR) + 2 + strlen(g_relativePath)] = '\0';
+void archiveWrite(ArchiveStream* stream, const char* data, int length) {
+    while (length > 0 && !stream->broken) {
+        if (stream->used >= stream->chunk) archiveFlush(stream, FALSE);
+        int space = stream->chunk - stream->used;
+        int taken = length < space ? length : space;
+        memcpy(stream->stage + stream->used, data, taken);
+        stream->used += taken;
+        data += taken;
+        length -= taken;
+    }
+}
+
+/**
+ * sends whatever is in the staging buffer, compressing it first if
+ * asked to. finish ends the compressed stream
+*/
+void archiveFlush(ArchiveStream* stream, int finish) {
+#ifdef FHUB_ZLIB
+    if (stream->compress) {
+        stream->deflater.next_in = (Bytef*)stream->stage;
+        stream->deflater.avail_in = stream->used;
+        int result;
+        do {
+            int chunk = stream->chunk;
+            stream->deflater.next_out = (Bytef*)stream->compressed;
+            stream->deflater.avail_out = chunk;
+            result = deflate(&stream->deflater, finish ? Z_FINISH : Z_NO_FLUSH);
+            int produced = chunk - stream->deflater.avail_out;
+            if (produced > 0) sendArchiveFrame(stream, ARCHIVE, stream->compressed, produced);
+        } while (!stream->broken && (stream->deflater.avail_out == 0 || (finish && result != Z_STREAM_END)) && result != Z_STREAM_ERROR);
+        stream->used = 0;
+        return;
+    }
+#endif
+    if (stream->used > 0) sendArchiveFrame(stream, ARCHIVE, stream->stage, stream->used);
+    stream->used = 0;
+}
+
+/**
+ * writes one frame of the archive straight to the client's socket,
+ * holding its send lock so queued chats can't land in the middle of it
+*/
+int sendArchiveFrame(ArchiveStream* stream, char type, const char* data, int length) {
+    if (stream->broken) return -1;
+    char header[HEADER_SIZE];
+    writeHeader(header, type, length);
+    IoVector vectors[2];
+#ifdef _WIN32
+    vectors[0].buf = header;
+    vectors[0].len = HEADER_SIZE;
+    vectors[1].buf = (char*)data;
+    vectors[1].len = length;
+#else
+    vectors[0].iov_base = header;
+    vectors[0].iov_len = HEADER_SIZE;
+    vectors[1].iov_base = (char*)data;
+    vectors[1].iov_len = length;
+#endif
+    long long start = getTimeMicros();
+    long long urgentCalls = 0;
+    long long calls = 0;
+    int urgent = beginBulk(stream, &urgentCalls);
+    long long written = -1;
+#ifdef __linux__
+    if (urgent >= 0 && stream->link != NULL) written = stream->link->shared == NULL ? -1 : writeLink(stream->link, vectors, length > 0 ? 2 : 1);
+    else
+#endif
+    if (urgent >= 0) written = gatherWrite(stream->socket, vectors, length > 0 ? 2 : 1, &calls);
+    endBulk(stream, urgent, urgentCalls, start, type == ARCHIVE || type == CACHED ? length : 0);
+    countIo(calls, 0, written);
+    if (written < 0) {
+        stream->broken = TRUE;
+        return -1;
+    }
+    if (type == ARCHIVE) stream->bytes += length;
+    return 0;
+}
+
+/**
+ * takes the send lock of a stream's client to write a frame of the
+ * stream. anything already queued for the client is written first, so
+ * chat and responses go out between frames rather than behind the whole
+ * transfer. returns how many queued frames were written, or -1 if the
+ * socket failed
+*/
+int beginBulk(ArchiveStream* stream, long long* calls) {
+    // the output thread may already have the queue in hand, in which case
+    // it's left to it so nothing goes out of order
+    OutQueue urgent;
+    Session* session = &g_sessions[stream->slot];
+    pthread_mutex_lock(&g_outputLock);
+    int owned = session->active && session->id == stream->owner;
+    urgent.count = 0;
+    if (owned) {
+        session->bulk++;
+        if (!session->flushing) {
+            urgent = session->output;
+            memset(&session->output, 0, sizeof(OutQueue));
+        }
+    }
+    pthread_mutex_unlock(&g_outputLock);
+
+    pthread_mutex_lock(&g_sendLocks[stream->slot]);
+    if (urgent.count == 0) return 0;
+    long long bytes = urgent.bytes;
+    int sent;
+#ifdef __linux__
+    if (stream->link != NULL) sent = stream->link->shared == NULL ? -1 : flushLink(&urgent, stream->link, calls);
+    else
+#endif
+    sent = flushQueue(&urgent, stream->socket, calls);
+    countIo(*calls, 0, sent < 0 ? 0 : bytes);
+    return sent;
+}
+
+/**
+ * lets go of the send lock taken by beginBulk, counting the queued frames
+ * that were written ahead of the stream's frame. a bulk frame of length
+ * bytes that took longer than BULK_LATENCY halves the stream's chunk, and
+ * one that went quickly doubles it again
+*/
+void endBulk(ArchiveStream* stream, int urgent, long long calls, long long start, int length) {
+    pthread_mutex_unlock(&g_sendLocks[stream->slot]);
+    Session* session = &g_sessions[stream->slot];
+    pthread_mutex_lock(&g_outputLock);
+    if (session->active && session->id == stream->owner) {
+        if (session->bulk > 0) session->bulk--;
+        if (urgent > 0) {
+            session->framesSent += urgent;
+            session->sendCalls += calls;
+        }
+
+        // whatever came in while the frame was written was skipped by the
+        // output thread, so make sure it gets woken up for it
+        if (session->bulk == 0 && session->output.count > 0 && g_pendingFrames++ == 0) {
+            g_batchStart = getTimeMicros();
+            pthread_cond_signal(&g_outputReady);
+        }
+    }
+    if (urgent > 0) {
+        g_framesSent += urgent;
+        g_sendCalls += calls;
+        g_preempted++;
     }
-}
\ No newline at end of file
+    pthread_mutex_unlock(&g_outputLock);
+
+    if (length == 0) return;
+    long long elapsed = getTimeMicros() - start;
+    int chunk = stream->chunk;
+    if (elapsed > BULK_LATENCY && chunk > MIN_CHUNK) chunk /= 2;
+    else if (elapsed < BULK_LATENCY / 4 && length >= chunk && chunk < MAX_PAYLOAD_SIZE) chunk *= 2;
+    if (chunk == stream->chunk) return;
+    stream->chunk = chunk;
+#ifdef __linux__
+    if (stream->link == NULL) setsockopt(stream->socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &stream->chunk, sizeof(int));
+#endif
+}
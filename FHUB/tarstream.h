@@ -0,0 +1,345 @@
+/**
+ * tarstream.h - writing tar headers and unpacking tar streams as they arrive
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef TARSTREAM_H
+#define TARSTREAM_H
+
+// defines
+#define TAR_BLOCK             512
+#define TAR_NAME_SIZE         4096
+#define TAR_HEADER_MAX        (TAR_BLOCK * (3 + TAR_NAME_SIZE / TAR_BLOCK))
+
+// includes
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// what the unpacker expects to see next in the stream
+enum TAR_STATE {
+    TAR_HEADER   = 0,
+    TAR_BODY     = 1,
+    TAR_LONGNAME = 2,
+    TAR_PADDING  = 3,
+    TAR_DONE     = 4
+};
+
+// unpacks a tar stream into a directory one chunk at a time. entries
+// land under into, or in the current directory when it's empty
+typedef struct {
+    int       state;
+    char      block[TAR_BLOCK];
+    int       blockUsed;
+    char      name[TAR_NAME_SIZE];
+    int       nameUsed;
+    int       longName;
+    long long remaining;
+    int       padding;
+    int       zeroBlocks;
+    FILE*     file;
+    long long files;
+    long long directories;
+    long long bytes;
+    long long skipped;
+    char      into[TAR_NAME_SIZE];
+    char      target[TAR_NAME_SIZE * 2];
+} TarReader;
+
+// function declarations
+int        writeTarHeader(char* out, const char* name, long long size, int mode, long long mtime, char type);
+void       writeTarNumber(char* field, int width, long long value);
+long long  readTarNumber(const char* field, int width);
+int        tarPadding(long long size);
+int        isSafeTarPath(const char* name);
+int        makeTarDirectories(char* path, int includeLast);
+void       startTar(TarReader* reader);
+void       startTarIn(TarReader* reader, const char* directory);
+char*      tarTarget(TarReader* reader);
+int        feedTar(TarReader* reader, const char* data, int length);
+void       finishTarEntry(TarReader* reader);
+void       closeTar(TarReader* reader);
+
+/**
+ * Writes a numeric header field as zero padded octal, switching to the
+ * base-256 extension for values too big to fit
+*/
+void writeTarNumber(char* field, int width, long long value) {
+    long long limit = 1;
+    for (int i = 0; i < width - 1; i++) limit *= 8;
+    if (value >= 0 && value < limit) {
+        for (int i = width - 2; i >= 0; i--) {
+            field[i] = '0' + (value & 7);
+            value >>= 3;
+        }
+        field[width - 1] = '\0';
+        return;
+    }
+    memset(field, 0, width);
+    for (int i = width - 1; i > 0; i--) {
+        field[i] = (char)(value & 0xFF);
+        value >>= 8;
+    }
+    field[0] = (char)0x80;
+}
+
+/**
+ * Reads a numeric header field written in either octal or base-256
+*/
+long long readTarNumber(const char* field, int width) {
+    long long value = 0;
+    if ((unsigned char)field[0] & 0x80) {
+        for (int i = 1; i < width; i++)
+            value = (value << 8) | (unsigned char)field[i];
+        return value;
+    }
+    for (int i = 0; i < width && field[i] != '\0'; i++) {
+        if (field[i] == ' ') continue;
+        if (field[i] < '0' || field[i] > '7') break;
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+/**
+ * Gets how many zero bytes follow an entry body of the given size
+*/
+int tarPadding(long long size) {
+    return (int)((TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK);
+}
+
+/**
+ * Writes the ustar header for an entry into out and returns how many bytes
+ * it took. Names that don't fit in a ustar header are preceded by a GNU long
+ * name entry. out needs to have room for TAR_HEADER_MAX bytes
+*/
+int writeTarHeader(char* out, const char* name, long long size, int mode, long long mtime, char type) {
+    int written = 0;
+    int nameLength = strlen(name);
+    if (nameLength >= TAR_NAME_SIZE) return 0;
+    if (nameLength > 100) {
+        int longLength = nameLength + 1;
+        written += writeTarHeader(out, "././@LongLink", longLength, 0, 0, 'L');
+        memset(out + written, 0, longLength + tarPadding(longLength));
+        memcpy(out + written, name, nameLength);
+        written += longLength + tarPadding(longLength);
+    }
+
+    char* header = out + written;
+    memset(header, 0, TAR_BLOCK);
+    memcpy(header, name, nameLength > 100 ? 100 : nameLength);
+    writeTarNumber(header + 100, 8, mode & 07777);
+    writeTarNumber(header + 108, 8, 0);
+    writeTarNumber(header + 116, 8, 0);
+    writeTarNumber(header + 124, 12, size);
+    writeTarNumber(header + 136, 12, mtime);
+    header[156] = type;
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    // checksum is taken with the checksum field filled with spaces
+    memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (int i = 0; i < TAR_BLOCK; i++) checksum += (unsigned char)header[i];
+    writeTarNumber(header + 148, 7, checksum);
+    header[155] = ' ';
+    return written + TAR_BLOCK;
+}
+
+/**
+ * Checks that an entry name can't write outside of the directory being
+ * unpacked into, meaning it isn't absolute and has no .. steps
+*/
+int isSafeTarPath(const char* name) {
+    if (name[0] == '\0' || name[0] == '/' || name[0] == '\\' || strchr(name, ':') != NULL) return 0;
+    const char* step = name;
+    while (*step != '\0') {
+        int length = strcspn(step, "/\\");
+        if (length == 2 && step[0] == '.' && step[1] == '.') return 0;
+        step += length;
+        if (*step != '\0') step++;
+    }
+    return 1;
+}
+
+/**
+ * Creates every directory along a path, including the last step
+ * if asked to. Returns 0 if they all exist afterwards
+*/
+int makeTarDirectories(char* path, int includeLast) {
+    int length = strlen(path);
+    for (int i = 1; i <= length; i++) {
+        if (i < length && path[i] != '/' && path[i] != '\\') continue;
+        if (i == length && !includeLast) break;
+        char saved = path[i];
+        path[i] = '\0';
+        struct stat info;
+        if (stat(path, &info) != 0) {
+#ifdef _WIN32
+            _mkdir(path);
+#else
+            mkdir(path, 0777);
+#endif
+        }
+        path[i] = saved;
+    }
+    struct stat info;
+    if (!includeLast) return 0;
+    return (stat(path, &info) == 0 && S_ISDIR(info.st_mode)) ? 0 : -1;
+}
+
+/**
+ * Resets a reader to the start of a new stream
+*/
+void startTar(TarReader* reader) {
+    memset(reader, 0, sizeof(TarReader));
+    reader->state = TAR_HEADER;
+}
+
+/**
+ * Resets a reader to the start of a new stream that is
+ * unpacked into the given directory
+*/
+void startTarIn(TarReader* reader, const char* directory) {
+    startTar(reader);
+    snprintf(reader->into, TAR_NAME_SIZE, "%s", directory);
+}
+
+/**
+ * Gets where the current entry is unpacked to
+*/
+char* tarTarget(TarReader* reader) {
+    if (reader->into[0] == '\0') return reader->name;
+    snprintf(reader->target, sizeof(reader->target), "%s/%s", reader->into, reader->name);
+    return reader->target;
+}
+
+/**
+ * Unpacks the next chunk of a tar stream into the reader's directory,
+ * creating files and directories as soon as their headers arrive. Unsafe
+ * names and entry types other than files and directories are skipped.
+ * Returns -1 if the stream is corrupt and 0 otherwise
+*/
+int feedTar(TarReader* reader, const char* data, int length) {
+    while (length > 0 && reader->state != TAR_DONE) {
+        if (reader->state == TAR_HEADER) {
+            int needed = TAR_BLOCK - reader->blockUsed;
+            int taken = length < needed ? length : needed;
+            memcpy(reader->block + reader->blockUsed, data, taken);
+            reader->blockUsed += taken;
+            data += taken;
+            length -= taken;
+            if (reader->blockUsed < TAR_BLOCK) break;
+            reader->blockUsed = 0;
+
+            // two empty blocks mark the end of the archive
+            int empty = 1;
+            for (int i = 0; i < TAR_BLOCK && empty; i++) empty = reader->block[i] == 0;
+            if (empty) {
+                if (++reader->zeroBlocks == 2) reader->state = TAR_DONE;
+                continue;
+            }
+            reader->zeroBlocks = 0;
+
+            unsigned int checksum = 0;
+            for (int i = 0; i < TAR_BLOCK; i++)
+                checksum += (i >= 148 && i < 156) ? ' ' : (unsigned char)reader->block[i];
+            if (checksum != readTarNumber(reader->block + 148, 8)) return -1;
+
+            char type = reader->block[156];
+            long long size = readTarNumber(reader->block + 124, 12);
+            reader->remaining = size;
+            reader->padding = tarPadding(size);
+            if (type == 'L') {
+                reader->nameUsed = 0;
+                reader->state = TAR_LONGNAME;
+                continue;
+            }
+            if (!reader->longName) {
+                memcpy(reader->name, reader->block, 100);
+                reader->name[100] = '\0';
+            }
+            reader->longName = 0;
+
+            // strip trailing slashes off of directory names
+            int nameLength = strlen(reader->name);
+            while (nameLength > 0 && reader->name[nameLength - 1] == '/') reader->name[--nameLength] = '\0';
+            if (!isSafeTarPath(reader->name)) {
+                reader->skipped++;
+            } else if (type == '5') {
+                if (makeTarDirectories(tarTarget(reader), 1) == 0) reader->directories++;
+                else reader->skipped++;
+            } else if (type == '0' || type == '\0') {
+                char* target = tarTarget(reader);
+                makeTarDirectories(target, 0);
+                reader->file = fopen(target, "wb");
+                if (reader->file == NULL) reader->skipped++;
+            } else {
+                reader->skipped++;
+            }
+            reader->state = TAR_BODY;
+            if (reader->remaining == 0) finishTarEntry(reader);
+        } else if (reader->state == TAR_BODY) {
+            int taken = reader->remaining < length ? (int)reader->remaining : length;
+            if (reader->file != NULL && fwrite(data, 1, taken, reader->file) != (size_t)taken) {
+                fclose(reader->file);
+                reader->file = NULL;
+                reader->skipped++;
+            }
+            reader->bytes += taken;
+            reader->remaining -= taken;
+            data += taken;
+            length -= taken;
+            if (reader->remaining == 0) finishTarEntry(reader);
+        } else if (reader->state == TAR_LONGNAME) {
+            int taken = reader->remaining < length ? (int)reader->remaining : length;
+            int room = TAR_NAME_SIZE - 1 - reader->nameUsed;
+            memcpy(reader->name + reader->nameUsed, data, taken < room ? taken : room);
+            reader->nameUsed += taken < room ? taken : room;
+            reader->remaining -= taken;
+            data += taken;
+            length -= taken;
+            if (reader->remaining == 0) {
+                reader->name[reader->nameUsed] = '\0';
+                reader->longName = 1;
+                reader->state = reader->padding > 0 ? TAR_PADDING : TAR_HEADER;
+            }
+        } else if (reader->state == TAR_PADDING) {
+            int taken = reader->padding < length ? reader->padding : length;
+            reader->padding -= taken;
+            data += taken;
+            length -= taken;
+            if (reader->padding == 0) reader->state = TAR_HEADER;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Closes out the entry whose body was just finished
+*/
+void finishTarEntry(TarReader* reader) {
+    if (reader->file != NULL) {
+        fclose(reader->file);
+        reader->file = NULL;
+        reader->files++;
+    }
+    reader->state = reader->padding > 0 ? TAR_PADDING : TAR_HEADER;
+}
+
+/**
+ * Closes any file left open by a stream that ended early
+*/
+void closeTar(TarReader* reader) {
+    if (reader->file != NULL) {
+        fclose(reader->file);
+        reader->file = NULL;
+        reader->skipped++;
+    }
+}
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * trace.h - a compact binary log of inbound traffic that can be replayed
+ * against a server later. records are varint encoded and gathered in
+ * memory, so recording costs a copy and only rarely a write
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// every trace starts with TRACE_MAGIC and a version byte. each record is
+// then [kind:1][micros since the last record:varint][connection:varint],
+// and frame records follow that with [type:1][length:varint][payload]
+#define TRACE_MAGIC           "FHTR"
+#define TRACE_VERSION         1
+#define TRACE_BUFFER_SIZE     (256 * 1024)
+#define TRACE_RECORD_MAX      (1 + 10 + 10 + 1 + 10 + 65536)
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "utils.h"
+
+// what a trace record describes
+enum TRACE_KIND {
+    TRACE_FRAME = 1,
+    TRACE_OPEN  = 2,
+    TRACE_CLOSE = 3
+};
+
+// writes records into one buffer while the other is on its way to disk.
+// lock guards the active buffer and fileLock is held while writing, so
+// callers only ever wait on the disk if both buffers are full
+typedef struct {
+    FILE*              file;
+    char*              buffers[2];
+    int                active;
+    int                used;
+    long long          last;
+    long long          records;
+    long long          bytes;
+    pthread_mutex_t    lock;
+    pthread_mutex_t    fileLock;
+} TraceWriter;
+
+// a single record pulled back out of a trace
+typedef struct {
+    int                kind;
+    long long          time;
+    unsigned long long connection;
+    char               type;
+    unsigned int       length;
+    char*              payload;
+} TraceRecord;
+
+// reads records back out of a trace file
+typedef struct {
+    FILE*              file;
+    long long          time;
+    char*              payload;
+} TraceReader;
+
+// function declarations
+int    openTrace(TraceWriter* writer, const char* path);
+void   closeTrace(TraceWriter* writer);
+void   traceRecord(TraceWriter* writer, int kind, unsigned long long connection, char type, const char* payload, unsigned int length);
+void   flushTrace(TraceWriter* writer);
+int    openTraceReader(TraceReader* reader, const char* path);
+int    nextTraceRecord(TraceReader* reader, TraceRecord* record);
+void   closeTraceReader(TraceReader* reader);
+
+/**
+ * Starts a new trace at the given path. Returns 0 on success
+*/
+int openTrace(TraceWriter* writer, const char* path) {
+    memset(writer, 0, sizeof(TraceWriter));
+    writer->buffers[0] = malloc(TRACE_BUFFER_SIZE);
+    writer->buffers[1] = malloc(TRACE_BUFFER_SIZE);
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL || writer->buffers[0] == NULL || writer->buffers[1] == NULL) {
+        if (writer->file != NULL) fclose(writer->file);
+        free(writer->buffers[0]);
+        free(writer->buffers[1]);
+        writer->file = NULL;
+        return -1;
+    }
+    setvbuf(writer->file, NULL, _IONBF, 0);
+    char header[5] = TRACE_MAGIC;
+    header[4] = TRACE_VERSION;
+    fwrite(header, 1, sizeof(header), writer->file);
+    writer->bytes = sizeof(header);
+    writer->last = getTimeMicros();
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_mutex_init(&writer->fileLock, NULL);
+    return 0;
+}
+
+/**
+ * Appends a record to the trace, handing the active buffer off to be
+ * written whenever the record wouldn't fit in it
+*/
+void traceRecord(TraceWriter* writer, int kind, unsigned long long connection, char type, const char* payload, unsigned int length) {
+    pthread_mutex_lock(&writer->lock);
+    if (writer->used + TRACE_RECORD_MAX > TRACE_BUFFER_SIZE) {
+        // wait for the other buffer to be free, swap, then write outside of the lock
+        pthread_mutex_lock(&writer->fileLock);
+        char* full = writer->buffers[writer->active];
+        int size = writer->used;
+        writer->active = !writer->active;
+        writer->used = 0;
+        pthread_mutex_unlock(&writer->lock);
+        fwrite(full, 1, size, writer->file);
+        pthread_mutex_unlock(&writer->fileLock);
+        pthread_mutex_lock(&writer->lock);
+    }
+
+    // timestamps are taken under the lock so they never go backwards
+    char* out = writer->buffers[writer->active] + writer->used;
+    int used = 0;
+    long long now = getTimeMicros();
+    long long delta = now > writer->last ? now - writer->last : 0;
+    writer->last = now > writer->last ? now : writer->last;
+    out[used++] = (char)kind;
+    used += putVarint(out + used, delta);
+    used += putVarint(out + used, connection);
+    if (kind == TRACE_FRAME) {
+        out[used++] = type;
+        used += putVarint(out + used, length);
+        memcpy(out + used, payload, length);
+        used += length;
+    }
+    writer->used += used;
+    writer->records++;
+    writer->bytes += used;
+    pthread_mutex_unlock(&writer->lock);
+}
+
+/**
+ * Writes out whatever is sitting in the active buffer
+*/
+void flushTrace(TraceWriter* writer) {
+    pthread_mutex_lock(&writer->lock);
+    pthread_mutex_lock(&writer->fileLock);
+    fwrite(writer->buffers[writer->active], 1, writer->used, writer->file);
+    writer->used = 0;
+    pthread_mutex_unlock(&writer->fileLock);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+/**
+ * Flushes and closes a trace. Nothing may be recording into it anymore
+*/
+void closeTrace(TraceWriter* writer) {
+    flushTrace(writer);
+    fclose(writer->file);
+    writer->file = NULL;
+    free(writer->buffers[0]);
+    free(writer->buffers[1]);
+    pthread_mutex_destroy(&writer->lock);
+    pthread_mutex_destroy(&writer->fileLock);
+}
+
+/**
+ * Opens a trace to be read back. Returns 0 on success and -1
+ * if the file can't be opened or isn't a trace
+*/
+int openTraceReader(TraceReader* reader, const char* path) {
+    memset(reader, 0, sizeof(TraceReader));
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) return -1;
+    char header[5];
+    reader->payload = malloc(65536);
+    if (reader->payload == NULL || fread(header, 1, sizeof(header), reader->file) != sizeof(header) ||
+        memcmp(header, TRACE_MAGIC, 4) != 0 || header[4] != TRACE_VERSION) {
+        closeTraceReader(reader);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Reads the next record. Its time is in micros since the trace started
+ * and its payload stays valid until the next call. Returns 1 if a record
+ * was read, 0 at the end of the trace and -1 if the trace is corrupt
+*/
+int nextTraceRecord(TraceReader* reader, TraceRecord* record) {
+    int kind = fgetc(reader->file);
+    if (kind == EOF) return 0;
+    unsigned long long delta, connection, length = 0;
+    if (readVarint(reader->file, &delta) != 0 || readVarint(reader->file, &connection) != 0) return -1;
+    reader->time += delta;
+    record->kind = kind;
+    record->time = reader->time;
+    record->connection = connection;
+    record->type = 0;
+    record->length = 0;
+    record->payload = reader->payload;
+    if (kind == TRACE_FRAME) {
+        int type = fgetc(reader->file);
+        if (type == EOF || readVarint(reader->file, &length) != 0 || length > 65536) return -1;
+        if (fread(reader->payload, 1, length, reader->file) != length) return -1;
+        record->type = (char)type;
+        record->length = (unsigned int)length;
+    } else if (kind != TRACE_OPEN && kind != TRACE_CLOSE) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * Closes a trace that was being read
+*/
+void closeTraceReader(TraceReader* reader) {
+    if (reader->file != NULL) fclose(reader->file);
+    free(reader->payload);
+    reader->file = NULL;
+    reader->payload = NULL;
+}
+
+#endif
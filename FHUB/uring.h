@@ -0,0 +1,231 @@
+/**
+ * uring.h - a small io_uring wrapper built straight on the system calls, so
+ * that many socket and file operations can be submitted and reaped together
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef URING_H
+#define URING_H
+
+#ifdef __linux__
+
+// includes
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// an io_uring instance. sqes are filled in locally and only handed
+// to the kernel when the ring is submitted
+typedef struct {
+    int                   fd;
+    unsigned              entries;
+    unsigned*             sqHead;
+    unsigned*             sqTail;
+    unsigned*             sqMask;
+    unsigned*             sqArray;
+    unsigned*             cqHead;
+    unsigned*             cqTail;
+    unsigned*             cqMask;
+    struct io_uring_sqe*  sqes;
+    struct io_uring_cqe*  cqes;
+    void*                 sqMap;
+    size_t                sqMapSize;
+    void*                 cqMap;
+    size_t                cqMapSize;
+    size_t                sqesSize;
+    unsigned              tail;
+    unsigned              pending;
+} Ring;
+
+// function declarations
+int                   initRing(Ring* ring, unsigned entries);
+void                  closeRing(Ring* ring);
+struct io_uring_sqe*  nextSqe(Ring* ring);
+int                   submitRing(Ring* ring, unsigned waitFor);
+struct io_uring_cqe*  peekCompletion(Ring* ring);
+void                  seenCompletion(Ring* ring);
+void                  prepAccept(struct io_uring_sqe* sqe, int fd, unsigned long long data);
+void                  prepRecv(struct io_uring_sqe* sqe, int fd, void* buf, unsigned length, unsigned long long data);
+void                  prepSendmsg(struct io_uring_sqe* sqe, int fd, struct msghdr* message, int flags, unsigned long long data);
+void                  prepRead(struct io_uring_sqe* sqe, int fd, void* buf, unsigned length, unsigned long long offset, unsigned long long data);
+void                  prepTimeout(struct io_uring_sqe* sqe, struct __kernel_timespec* wait, unsigned long long data);
+
+/**
+ * Sets up a ring with room for the given number of submissions.
+ * Returns 0 on success, or -1 if io_uring isn't available
+*/
+int initRing(Ring* ring, unsigned entries) {
+    memset(ring, 0, sizeof(Ring));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = syscall(SYS_io_uring_setup, entries, &params);
+    if (ring->fd < 0) return -1;
+    ring->entries = params.sq_entries;
+
+    // map the submission and completion rings, which share one mapping on newer kernels
+    ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cqMapSize > ring->sqMapSize) ring->sqMapSize = ring->cqMapSize;
+        ring->cqMapSize = 0;
+    }
+    ring->sqMap = mmap(NULL, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqMap == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+    ring->cqMap = ring->sqMap;
+    if (ring->cqMapSize > 0) {
+        ring->cqMap = mmap(NULL, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqMap == MAP_FAILED) {
+            munmap(ring->sqMap, ring->sqMapSize);
+            close(ring->fd);
+            return -1;
+        }
+    }
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cqMapSize > 0) munmap(ring->cqMap, ring->cqMapSize);
+        munmap(ring->sqMap, ring->sqMapSize);
+        close(ring->fd);
+        return -1;
+    }
+
+    char* sq = ring->sqMap;
+    char* cq = ring->cqMap;
+    ring->sqHead  = (unsigned*)(sq + params.sq_off.head);
+    ring->sqTail  = (unsigned*)(sq + params.sq_off.tail);
+    ring->sqMask  = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned*)(sq + params.sq_off.array);
+    ring->cqHead  = (unsigned*)(cq + params.cq_off.head);
+    ring->cqTail  = (unsigned*)(cq + params.cq_off.tail);
+    ring->cqMask  = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes    = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring->tail    = *ring->sqTail;
+    return 0;
+}
+
+/**
+ * Unmaps and closes a ring
+*/
+void closeRing(Ring* ring) {
+    munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqMapSize > 0) munmap(ring->cqMap, ring->cqMapSize);
+    munmap(ring->sqMap, ring->sqMapSize);
+    close(ring->fd);
+}
+
+/**
+ * Gets a cleared submission entry to fill in, or NULL if every
+ * entry is already waiting to be submitted
+*/
+struct io_uring_sqe* nextSqe(Ring* ring) {
+    unsigned head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    if (ring->tail - head >= ring->entries) return NULL;
+    unsigned index = ring->tail & *ring->sqMask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sqArray[index] = index;
+    ring->tail++;
+    ring->pending++;
+    return sqe;
+}
+
+/**
+ * Hands every filled in entry to the kernel with a single system call,
+ * waiting until at least waitFor completions are ready. Returns the
+ * number of entries submitted or -1 on failure
+*/
+int submitRing(Ring* ring, unsigned waitFor) {
+    __atomic_store_n(ring->sqTail, ring->tail, __ATOMIC_RELEASE);
+    while (1) {
+        int submitted = syscall(SYS_io_uring_enter, ring->fd, ring->pending, waitFor,
+            waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (submitted >= 0) {
+            ring->pending -= submitted;
+            return submitted;
+        }
+        if (errno != EINTR) return -1;
+    }
+}
+
+/**
+ * Gets the oldest completion that hasn't been seen yet, or NULL if there isn't one
+*/
+struct io_uring_cqe* peekCompletion(Ring* ring) {
+    unsigned head = *ring->cqHead;
+    if (head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)) return NULL;
+    return &ring->cqes[head & *ring->cqMask];
+}
+
+/**
+ * Lets the kernel reuse the slot of the completion handed out by peekCompletion
+*/
+void seenCompletion(Ring* ring) {
+    __atomic_store_n(ring->cqHead, *ring->cqHead + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Accepts a connection on a listening socket
+*/
+void prepAccept(struct io_uring_sqe* sqe, int fd, unsigned long long data) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->user_data = data;
+}
+
+/**
+ * Receives into a buffer from a socket
+*/
+void prepRecv(struct io_uring_sqe* sqe, int fd, void* buf, unsigned length, unsigned long long data) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)buf;
+    sqe->len = length;
+    sqe->user_data = data;
+}
+
+/**
+ * Sends a gather list to a socket
+*/
+void prepSendmsg(struct io_uring_sqe* sqe, int fd, struct msghdr* message, int flags, unsigned long long data) {
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)message;
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->user_data = data;
+}
+
+/**
+ * Reads from a file at an offset
+*/
+void prepRead(struct io_uring_sqe* sqe, int fd, void* buf, unsigned length, unsigned long long offset, unsigned long long data) {
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)buf;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = data;
+}
+
+/**
+ * Completes after the given amount of time has passed
+*/
+void prepTimeout(struct io_uring_sqe* sqe, struct __kernel_timespec* wait, unsigned long long data) {
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (unsigned long long)wait;
+    sqe->len = 1;
+    sqe->user_data = data;
+}
+
+#endif
+
+#endif
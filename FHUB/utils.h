@@ -1,11 +1,21 @@
 /**
- * utils.h - program helper functions for terminal output
+ * utils.h - program helper functions for terminal output, timing, varints and paths
  * author: Jason Heflinger
- * last modified: 6-7-2023
+ * last modified: 10-18-2026
 */
 
+#ifndef UTILS_H
+#define UTILS_H
+
 // includes
 #include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
 
 // color identifier enum
 enum COLORS {
@@ -25,6 +35,12 @@ void   setHighlight(int color);
 void   setBoldText(void);
 void   resetText(void);
 void   getInput(char* buf, int len);
+long long getTimeMicros(void);
+void   sleepMicros(long long micros);
+int    putVarint(char* out, unsigned long long value);
+int    getVarint(const char* in, unsigned long long* value);
+int    readVarint(FILE* file, unsigned long long* value);
+int    isUnder(const char* path, const char* parent);
 
 /**
  * Given a color ID (see @COLORS) changes following 
@@ -83,4 +99,90 @@ void getInput(char* buf, int len) {
     for(int i = 0; i < len; i++)
        if (buf[i] == '\n')
             buf[i] = '\0';
-}
\ No newline at end of file
+}
+
+/**
+ * Gets a monotonic timestamp in microseconds. Only useful
+ * for measuring elapsed time, not for telling the time of day
+*/
+long long getTimeMicros() {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (long long)(counter.QuadPart * 1000000.0 / frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * Sleeps the calling thread for roughly the given
+ * number of microseconds
+*/
+void sleepMicros(long long micros) {
+    if (micros <= 0) return;
+#ifdef _WIN32
+    Sleep((DWORD)((micros + 999) / 1000));
+#else
+    usleep((useconds_t)micros);
+#endif
+}
+
+/**
+ * Writes a value as a little endian base-128 varint and
+ * returns how many bytes it took
+*/
+int putVarint(char* out, unsigned long long value) {
+    int length = 0;
+    while (value >= 0x80) {
+        out[length++] = (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (char)value;
+    return length;
+}
+
+/**
+ * Reads a varint written by putVarint and returns how many bytes
+ * it took. The varint must be complete
+*/
+int getVarint(const char* in, unsigned long long* value) {
+    int length = 0;
+    *value = 0;
+    for (int shift = 0; ; shift += 7) {
+        unsigned char byte = (unsigned char)in[length++];
+        *value |= (unsigned long long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return length;
+    }
+}
+
+/**
+ * Reads a varint back out of a file. Returns 0 on success
+ * and -1 at the end of the file or on a corrupt value
+*/
+int readVarint(FILE* file, unsigned long long* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(file);
+        if (byte == EOF) return -1;
+        *value |= (unsigned long long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return 0;
+    }
+    return -1;
+}
+
+/**
+ * Checks if a path is the parent itself or somewhere below it. Every
+ * path is below the empty path, which stands for the root
+*/
+int isUnder(const char* path, const char* parent) {
+    int length = strlen(parent);
+    if (length == 0) return 1;
+    return strncmp(path, parent, length) == 0 && (path[length] == '\0' || path[length] == '/');
+}
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * watch.h - watches a directory tree for changes with inotify. every
+ * directory in the tree gets a watch, new directories are picked up as
+ * they appear, and changes are reported by path relative to the tree
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#ifdef __linux__
+
+// defines
+#define WATCH_PATH_SIZE       4096
+#define WATCH_EVENT_SIZE      (64 * 1024)
+#define WATCH_MASK            (IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+                               IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+// includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+// what happened to a path
+enum WATCH_CHANGE {
+    WATCH_CHANGED = 0,
+    WATCH_CREATED = 1,
+    WATCH_REMOVED = 2
+};
+
+// a watched directory, by its path relative to the root of the tree
+typedef struct {
+    int            wd;
+    char*          path;
+} WatchedDir;
+
+// called for every change. directory is set when the path is a directory,
+// and a removed directory takes everything below it along with it
+typedef void (*WatchHandler)(void* context, int change, const char* path, int directory);
+
+// an inotify instance watching every directory below root
+typedef struct {
+    int            fd;
+    char           root[WATCH_PATH_SIZE];
+    WatchedDir*    dirs;
+    int            count;
+    int            size;
+    long long      events;
+    long long      overflows;
+    long long      skipped;
+    pthread_mutex_t lock;
+} Watcher;
+
+// function declarations
+int    initWatcher(Watcher* watcher, const char* root);
+void   closeWatcher(Watcher* watcher);
+int    watchTree(Watcher* watcher, const char* path);
+void   unwatchDir(Watcher* watcher, int wd);
+void   unwatchTree(Watcher* watcher, const char* path);
+WatchedDir* findWatch(Watcher* watcher, int wd);
+int    watchPath(char* path, const char* base, const char* name);
+int    readChanges(Watcher* watcher, WatchHandler handler, void* context);
+int    waitChanges(Watcher* watcher, int timeout);
+
+/**
+ * Starts watching the tree under root. Returns 0 on success, or
+ * -1 if inotify isn't available or root can't be watched
+*/
+int initWatcher(Watcher* watcher, const char* root) {
+    memset(watcher, 0, sizeof(Watcher));
+    snprintf(watcher->root, WATCH_PATH_SIZE, "%s", root);
+    pthread_mutex_init(&watcher->lock, NULL);
+    watcher->fd = inotify_init1(IN_CLOEXEC);
+    if (watcher->fd < 0) return -1;
+    if (watchTree(watcher, "") != 0) {
+        closeWatcher(watcher);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Stops watching and forgets every directory
+*/
+void closeWatcher(Watcher* watcher) {
+    if (watcher->fd >= 0) close(watcher->fd);
+    watcher->fd = -1;
+    for (int i = 0; i < watcher->count; i++) free(watcher->dirs[i].path);
+    free(watcher->dirs);
+    watcher->dirs = NULL;
+    watcher->count = 0;
+    watcher->size = 0;
+}
+
+/**
+ * Finds the directory a watch descriptor belongs to, or NULL
+*/
+WatchedDir* findWatch(Watcher* watcher, int wd) {
+    for (int i = 0; i < watcher->count; i++)
+        if (watcher->dirs[i].wd == wd) return &watcher->dirs[i];
+    return NULL;
+}
+
+/**
+ * Joins name onto base, either of which may be empty, into a
+ * WATCH_PATH_SIZE buffer. Returns 0 on success or -1 if it doesn't fit
+*/
+int watchPath(char* path, const char* base, const char* name) {
+    int length;
+    if (base[0] == '\0') length = snprintf(path, WATCH_PATH_SIZE, "%s", name);
+    else if (name[0] == '\0') length = snprintf(path, WATCH_PATH_SIZE, "%s", base);
+    else length = snprintf(path, WATCH_PATH_SIZE, "%s/%s", base, name);
+    return length < 0 || length >= WATCH_PATH_SIZE ? -1 : 0;
+}
+
+/**
+ * Watches a directory, given relative to the root, and every directory
+ * below it. Paths too long to build are skipped and counted. Returns 0
+ * on success or -1 if the directory itself can't be watched
+*/
+int watchTree(Watcher* watcher, const char* path) {
+    char full[WATCH_PATH_SIZE];
+    if (watchPath(full, watcher->root, path) != 0) {
+        watcher->skipped++;
+        return -1;
+    }
+    int wd = inotify_add_watch(watcher->fd, full, WATCH_MASK);
+    if (wd < 0) return -1;
+
+    // the same directory can be added twice when it's created while its parent is being walked
+    pthread_mutex_lock(&watcher->lock);
+    if (findWatch(watcher, wd) == NULL) {
+        if (watcher->count == watcher->size) {
+            watcher->size = watcher->size == 0 ? 64 : watcher->size * 2;
+            watcher->dirs = realloc(watcher->dirs, watcher->size * sizeof(WatchedDir));
+        }
+        watcher->dirs[watcher->count].wd = wd;
+        watcher->dirs[watcher->count].path = strdup(path);
+        watcher->count++;
+    }
+    pthread_mutex_unlock(&watcher->lock);
+
+    DIR* dir = opendir(full);
+    if (dir == NULL) return 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        char child[WATCH_PATH_SIZE];
+        char childFull[WATCH_PATH_SIZE];
+        if (watchPath(child, path, entry->d_name) != 0 || watchPath(childFull, full, entry->d_name) != 0) {
+            watcher->skipped++;
+            continue;
+        }
+        int isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat info;
+            isDir = lstat(childFull, &info) == 0 && S_ISDIR(info.st_mode);
+        }
+        if (isDir) watchTree(watcher, child);
+    }
+    closedir(dir);
+    return 0;
+}
+
+/**
+ * Forgets a watch the kernel has dropped
+*/
+void unwatchDir(Watcher* watcher, int wd) {
+    pthread_mutex_lock(&watcher->lock);
+    for (int i = 0; i < watcher->count; i++) {
+        if (watcher->dirs[i].wd != wd) continue;
+        free(watcher->dirs[i].path);
+        watcher->dirs[i] = watcher->dirs[--watcher->count];
+        break;
+    }
+    pthread_mutex_unlock(&watcher->lock);
+}
+
+/**
+ * Stops watching a directory that moved away and everything below it,
+ * since their watches would otherwise report changes under the old path
+*/
+void unwatchTree(Watcher* watcher, const char* path) {
+    int length = strlen(path);
+    pthread_mutex_lock(&watcher->lock);
+    for (int i = 0; i < watcher->count; i++) {
+        char* watched = watcher->dirs[i].path;
+        if (strncmp(watched, path, length) != 0 || (watched[length] != '\0' && watched[length] != '/')) continue;
+        inotify_rm_watch(watcher->fd, watcher->dirs[i].wd);
+        free(watched);
+        watcher->dirs[i--] = watcher->dirs[--watcher->count];
+    }
+    pthread_mutex_unlock(&watcher->lock);
+}
+
+/**
+ * Waits up to timeout milliseconds for changes to come in, or forever if
+ * it's negative. Returns 1 if there are changes to read, 0 if the time ran
+ * out and -1 once the watcher is closed
+*/
+int waitChanges(Watcher* watcher, int timeout) {
+    struct pollfd ready = { watcher->fd, POLLIN, 0 };
+    int result = poll(&ready, 1, timeout);
+    if (result < 0) return errno == EINTR ? 0 : -1;
+    if (result > 0 && (ready.revents & (POLLERR | POLLNVAL))) return -1;
+    return result;
+}
+
+/**
+ * Blocks until changes come in and hands each of them to the handler.
+ * New directories are watched before their creation is reported. If the
+ * kernel's queue overflowed, the root is reported as changed, since any
+ * change may have been missed, and changes to paths too long to build are
+ * skipped and counted. Returns -1 once the watcher is closed
+*/
+int readChanges(Watcher* watcher, WatchHandler handler, void* context) {
+    char buffer[WATCH_EVENT_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+    if (length < 0) return errno == EINTR ? 0 : -1;
+    for (char* next = buffer; next < buffer + length; ) {
+        struct inotify_event* event = (struct inotify_event*)next;
+        next += sizeof(struct inotify_event) + event->len;
+        watcher->events++;
+        if (event->mask & IN_Q_OVERFLOW) {
+            watcher->overflows++;
+            handler(context, WATCH_CHANGED, "", 1);
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            unwatchDir(watcher, event->wd);
+            continue;
+        }
+
+        // build the changed path out of the directory it happened in
+        char path[WATCH_PATH_SIZE];
+        pthread_mutex_lock(&watcher->lock);
+        WatchedDir* dir = findWatch(watcher, event->wd);
+        if (dir == NULL) {
+            pthread_mutex_unlock(&watcher->lock);
+            continue;
+        }
+        int fits = watchPath(path, dir->path, event->len == 0 ? "" : event->name) == 0;
+        pthread_mutex_unlock(&watcher->lock);
+        if (!fits) {
+            watcher->skipped++;
+            continue;
+        }
+
+        // the directory's own events are also reported by its parent, by name
+        if (event->len == 0) continue;
+        int directory = (event->mask & IN_ISDIR) != 0;
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            if (directory) watchTree(watcher, path);
+            handler(context, WATCH_CREATED, path, directory);
+        } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            if (directory && (event->mask & IN_MOVED_FROM)) unwatchTree(watcher, path);
+            handler(context, WATCH_REMOVED, path, directory);
+        } else {
+            handler(context, WATCH_CHANGED, path, directory);
+        }
+    }
+    return 0;
+}
+
+#endif
+
+#endif
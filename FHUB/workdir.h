@@ -0,0 +1,111 @@
+/**
+ * workdir.h - working directories held open as directory handles so that
+ * every lookup starts from the handle instead of re-walking a path
+ * author: Jason Heflinger
+ * last modified: 10-18-2026
+*/
+
+#ifndef WORKDIR_H
+#define WORKDIR_H
+
+// defines
+#define WORKDIR_PATH_SIZE     8192
+
+// includes
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+#endif
+
+// a working directory. relative is the path below the root, kept for
+// display and for platforms without directory handles. fd is an O_PATH
+// handle to the directory on linux, or -1 when it is the root itself
+typedef struct {
+    char relative[WORKDIR_PATH_SIZE];
+    int  fd;
+} WorkDir;
+
+// function declarations
+void  initWorkDir(WorkDir* dir);
+void  closeWorkDir(WorkDir* dir);
+int   isPlainRelative(const char* name);
+int   openBeneath(int dirfd, const char* name, int flags, int mode);
+DIR*  openDirAt(int dirfd, const char* name);
+
+/**
+ * Points a working directory at the root
+*/
+void initWorkDir(WorkDir* dir) {
+    dir->relative[0] = '\0';
+    dir->fd = -1;
+}
+
+/**
+ * Lets go of a working directory's handle, leaving it at the root
+*/
+void closeWorkDir(WorkDir* dir) {
+#ifdef __linux__
+    if (dir->fd >= 0) close(dir->fd);
+#endif
+    initWorkDir(dir);
+}
+
+/**
+ * Checks if a name can be looked up straight from the working directory,
+ * meaning it isn't absolute and never steps back up with ..
+*/
+int isPlainRelative(const char* name) {
+    if (name[0] == '/' || name[0] == '\\' || name[0] == '\0') return 0;
+    const char* step = name;
+    while (*step != '\0') {
+        int length = strcspn(step, "/\\");
+        if (length == 2 && step[0] == '.' && step[1] == '.') return 0;
+        step += length;
+        if (*step != '\0') step++;
+    }
+    return 1;
+}
+
+#ifndef _WIN32
+/**
+ * Opens a name relative to a directory handle without letting the lookup
+ * escape that directory, whether through .. or through symlinks. Falls back
+ * to a plain openat on kernels without openat2 and on other systems, where
+ * the caller's own checks on the name are all that keep it inside
+*/
+int openBeneath(int dirfd, const char* name, int flags, int mode) {
+#ifdef __linux__
+    static int supported = 1;
+    if (supported) {
+        struct open_how how = { 0 };
+        how.flags = flags | O_CLOEXEC;
+        how.mode = (flags & O_CREAT) ? mode : 0;
+        how.resolve = RESOLVE_BENEATH;
+        int fd = syscall(SYS_openat2, dirfd, name, &how, sizeof(how));
+        if (fd >= 0 || errno != ENOSYS) return fd;
+        supported = 0;
+    }
+#endif
+    return openat(dirfd, name, flags | O_CLOEXEC, mode);
+}
+
+/**
+ * Opens a directory inside of an open directory for reading, refusing
+ * to follow it if it's a symlink. Returns NULL on failure
+*/
+DIR* openDirAt(int dirfd, const char* name) {
+    int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    DIR* directory = fd < 0 ? NULL : fdopendir(fd);
+    if (directory == NULL && fd >= 0) close(fd);
+    return directory;
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+#!/bin/sh
+# compares the thread per client and io_uring backends of a linux server build
+# by running the load generator against each of them in chat and getdir mode.
+# usage: bench_backends.sh [server binary] (defaults to bin/FHUB_server)
+cd "$(dirname "$0")/.."
+PORT=${PORT:-42600}
+CLIENTS=${CLIENTS:-8}
+DURATION=${DURATION:-5}
+make server loadgen || exit 1
+SERVER=$(realpath "${1:-bin/FHUB_server}")
+LOADGEN=$(realpath bin/FHUB_loadgen)
+
+# a directory of a few big and many small files for the transfers
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+mkdir -p "$WORK/ROOT/bench/small"
+for i in 1 2 3 4; do head -c 4000000 /dev/urandom > "$WORK/ROOT/bench/big$i.bin"; done
+for i in $(seq 1 200); do head -c 3000 /dev/urandom > "$WORK/ROOT/bench/small/file$i.bin"; done
+
+printf "%-8s %-8s %12s %10s %14s %14s %12s\n" MODE BACKEND "SYSCALLS" "CALLS/S" "GB MOVED" "MB/S" "CPU S/GB"
+for MODE in chat getdir; do
+    for BACKEND in threads uring; do
+        FLAG=""
+        [ "$BACKEND" = uring ] && FLAG="--uring"
+        PORT=$((PORT + 1))
+        rm -f "$WORK/in" "$WORK/go"
+        mkfifo "$WORK/in" "$WORK/go"
+
+        (cd "$WORK" && "$SERVER" $FLAG < in > server.log 2>&1) &
+        SERVER_PID=$!
+        exec 3> "$WORK/in"
+        echo "$PORT" >&3
+        sleep 1
+        echo "/ratelimit chat 0 0" >&3
+        echo "/ratelimit file 0 0" >&3
+
+        if [ "$MODE" = chat ]; then ARGS="chat"; else ARGS="getdir bench"; fi
+        "$LOADGEN" "$PORT" "$CLIENTS" "$DURATION" $ARGS < "$WORK/go" > "$WORK/loadgen.log" &
+        LOADGEN_PID=$!
+        exec 4> "$WORK/go"
+        while ! grep -q '^done' "$WORK/loadgen.log" 2>/dev/null; do sleep 0.2; done
+
+        # read the server's counters while every client is still connected
+        echo "/stats" >&3
+        echo "/exit" >&3
+        wait $SERVER_PID 2>/dev/null
+        exec 3>&-
+        exec 4>&-
+        wait $LOADGEN_PID
+
+        SECONDS_RUN=$(sed -n 's/^seconds: //p' "$WORK/loadgen.log")
+        RATE=$(sed -n 's/^bytes received: .*(\(.*\) MB\/s)/\1/p' "$WORK/loadgen.log")
+        CALLS=$(sed -n 's/.*system calls: \([0-9]*\).*/\1/p' "$WORK/server.log" | tail -n 1)
+        BYTES=$(sed -n 's/.*bytes in: \([0-9]*\), bytes out: \([0-9]*\).*/\1 \2/p' "$WORK/server.log" | tail -n 1)
+        CPU=$(sed -n 's/.*cpu time: \([0-9.]*\)s.*/\1/p' "$WORK/server.log" | tail -n 1)
+        echo "$MODE $BACKEND ${CALLS:-0} $SECONDS_RUN $BYTES ${CPU:-0} ${RATE:-0}" | awk '{
+            gb = ($5 + $6) / 1000000000
+            printf "%-8s %-8s %12d %10.0f %14.3f %14s %12.3f\n", $1, $2, $3, $3 / $4, gb, $8, (gb > 0 ? $7 / gb : 0)
+        }'
+    done
+done
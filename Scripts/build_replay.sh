@@ -0,0 +1,4 @@
+#!/bin/sh
+# builds the trace replay tool into bin/FHUB_replay
+cd "$(dirname "$0")/.."
+make replay